@@ -0,0 +1,92 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace StreamLine{
+    /**
+     * @brief A bump allocator handing out aligned memory from large blocks, everything is released at once.
+     *
+     * Allocation is a pointer increment, for buffers built and dropped together (batch columns, scratch space).
+     * Not thread-safe: give every producer its own arena.
+     */
+    class Arena{
+    private:
+        struct Block{
+            std::unique_ptr<std::byte[], void(*)(std::byte*)> memory;
+            std::size_t size;
+        };
+
+        static constexpr std::size_t BlockAlignment = 64;
+
+        std::vector<Block> blocks;
+        std::size_t blockSize;
+        std::size_t current = 0;
+        std::size_t used = 0;
+
+        static void Free(std::byte* p) {
+            ::operator delete[](p, std::align_val_t(BlockAlignment));
+        }
+
+        void Grow(std::size_t minimum) {
+            //Blocks emptied by Reset are reused before new ones are made.
+            while (current + 1 < blocks.size()) {
+                current++;
+                used = 0;
+                if (blocks[current].size >= minimum) {
+                    return;
+                }
+            }
+            const std::size_t size = std::max(blockSize, minimum);
+            std::byte* memory = static_cast<std::byte*>(::operator new[](size, std::align_val_t(BlockAlignment)));
+            blocks.push_back(Block{ { memory, &Free }, size });
+            current = blocks.size() - 1;
+            used = 0;
+        }
+    public:
+        explicit Arena(std::size_t defaultBlockSize = 1 << 20) : blockSize(std::max<std::size_t>(BlockAlignment, defaultBlockSize)) {}
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+        Arena(Arena&&) = default;
+        Arena& operator=(Arena&&) = default;
+
+        /// @param alignment Power of two, at most 64.
+        void* Allocate(std::size_t bytes, std::size_t alignment = 64) {
+            bytes = std::max<std::size_t>(1, bytes);
+            if (!blocks.empty()) {
+                const std::size_t offset = (used + alignment - 1) & ~(alignment - 1);
+                if (offset + bytes <= blocks[current].size) {
+                    used = offset + bytes;
+                    return blocks[current].memory.get() + offset;
+                }
+            }
+            Grow(bytes);
+            used = bytes;
+            return blocks[current].memory.get();
+        }
+
+        template<class T>
+        T* Allocate(std::size_t count) {
+            return static_cast<T*>(Allocate(count * sizeof(T), std::max<std::size_t>(alignof(T), 64)));
+        }
+
+        /// @brief Makes every block available again, memory handed out before is invalidated.
+        void Reset() noexcept {
+            current = 0;
+            used = 0;
+        }
+
+        /// @brief Bytes reserved from the system.
+        std::size_t Capacity() const noexcept {
+            std::size_t total = 0;
+            for (const Block& block : blocks) {
+                total += block.size;
+            }
+            return total;
+        }
+    };
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+namespace StreamLine{
+    /**
+     * @brief Base of the units of work whose completion can be awaited.
+     */
+    class Awaitable{
+    public:
+        virtual ~Awaitable() = default;
+    };
+}
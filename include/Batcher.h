@@ -0,0 +1,163 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "ThreadPool.h"
+#include "Reactor.h"
+
+namespace StreamLine{
+    /** \addtogroup Stream
+     *  @{
+     */
+
+    struct BatcherOptions{
+        /// @brief Items that flush a buffer right away.
+        std::size_t MaxItems = 256;
+        /// @brief Longest an item waits in a buffer, zero to only flush on MaxItems and Flush.
+        std::chrono::microseconds MaxDelay{ 1000 };
+    };
+
+    /**
+     * @brief Accumulates items from many producers and hands them downstream in batches.
+     *
+     * Every worker fills its own buffer (threads outside the pool share one), so producers don't contend.
+     * A buffer is flushed to the sink, as a ThreadPool task, when it holds MaxItems or its oldest item waited MaxDelay.
+     *
+     * The delay is timed with Reactor::Timeout, armed when a buffer gets its first item.
+     * Without an initialized reactor, a buffer's age is only checked when an item is added to it, call Flush at the end of a stream.
+     *
+     * Example usage:
+     * @code
+     * Batcher<Event> batcher([](std::vector<Event> batch) { Store(batch); }, { 512, std::chrono::microseconds(200) });
+     * batcher.Add(event); //From any thread.
+     * @endcode
+     */
+    template<class T>
+    class Batcher{
+    public:
+        using Sink = std::function<void(std::vector<T>)>;
+    private:
+        struct alignas(64) Buffer{
+            std::mutex mtx;
+            std::vector<T> items;
+            std::chrono::steady_clock::time_point first;
+            //Bumped by every flush, so a timer armed for earlier items doesn't flush newer ones early.
+            std::uint64_t generation = 0;
+        };
+
+        struct State{
+            Sink sink;
+            BatcherOptions options;
+            std::unique_ptr<Buffer[]> buffers;
+            std::size_t count = 0;
+
+            void Dispatch(std::shared_ptr<State> self, std::vector<T>&& items) {
+                auto batch = std::make_shared<std::vector<T>>(std::move(items));
+                ThreadPool::Submit([self, batch]() {
+                    self->sink(std::move(*batch));
+                });
+            }
+
+            /// @brief Takes the buffer's items if there are any (and generation still matches when given).
+            bool Take(Buffer& buffer, std::vector<T>& out, const std::uint64_t* generation = nullptr) {
+                std::lock_guard<std::mutex> lock(buffer.mtx);
+                if (buffer.items.empty() || (generation != nullptr && *generation != buffer.generation)) {
+                    return false;
+                }
+                out.swap(buffer.items);
+                buffer.items.reserve(options.MaxItems);
+                buffer.generation++;
+                return true;
+            }
+        };
+
+        std::shared_ptr<State> state;
+
+        static bool HasTimer() noexcept {
+            return IO::Reactor::GetBackend() != IO::ReactorBackend::None;
+        }
+
+        void ArmTimer(std::size_t index, std::uint64_t generation) {
+            std::weak_ptr<State> weak = state;
+            IO::Reactor::Timeout(state->options.MaxDelay, [weak, index, generation](int) {
+                //The batcher may be gone by the time the timer fires.
+                if (std::shared_ptr<State> self = weak.lock()) {
+                    std::vector<T> batch;
+                    if (self->Take(self->buffers[index], batch, &generation)) {
+                        self->Dispatch(self, std::move(batch));
+                    }
+                }
+            });
+        }
+    public:
+        explicit Batcher(Sink sink, const BatcherOptions& options = BatcherOptions()) : state(std::make_shared<State>()) {
+            state->sink = std::move(sink);
+            state->options = options;
+            state->options.MaxItems = std::max<std::size_t>(1, options.MaxItems);
+            state->count = ThreadPool::GetThreadCount() + 1;
+            state->buffers = std::make_unique<Buffer[]>(state->count);
+            for (std::size_t i = 0; i < state->count; i++) {
+                state->buffers[i].items.reserve(state->options.MaxItems);
+            }
+        }
+
+        /// @brief Flushes what is left.
+        ~Batcher() {
+            Flush();
+        }
+
+        Batcher(const Batcher&) = delete;
+        Batcher& operator=(const Batcher&) = delete;
+
+        void Add(T item) {
+            const int worker = ThreadPool::GetWorkerIndex();
+            //Workers beyond the count seen at construction share the outsiders' buffer.
+            const std::size_t index = worker >= 0 && static_cast<std::size_t>(worker) + 1 < state->count
+                ? static_cast<std::size_t>(worker) : state->count - 1;
+            Buffer& buffer = state->buffers[index];
+            const BatcherOptions& options = state->options;
+            std::vector<T> batch;
+            bool arm = false;
+            std::uint64_t generation;
+            {
+                std::lock_guard<std::mutex> lock(buffer.mtx);
+                buffer.items.push_back(std::move(item));
+                const bool timed = options.MaxDelay.count() > 0;
+                if (buffer.items.size() == 1 && timed) {
+                    buffer.first = std::chrono::steady_clock::now();
+                    arm = HasTimer();
+                }
+                if (buffer.items.size() >= options.MaxItems
+                    || (timed && !arm && std::chrono::steady_clock::now() - buffer.first >= options.MaxDelay)) {
+                    batch.swap(buffer.items);
+                    buffer.items.reserve(options.MaxItems);
+                    buffer.generation++;
+                    arm = false;
+                }
+                generation = buffer.generation;
+            }
+            if (!batch.empty()) {
+                state->Dispatch(state, std::move(batch));
+            }
+            else if (arm) {
+                ArmTimer(index, generation);
+            }
+        }
+
+        /// @brief Hands every non-empty buffer downstream now.
+        void Flush() {
+            for (std::size_t i = 0; i < state->count; i++) {
+                std::vector<T> batch;
+                if (state->Take(state->buffers[i], batch)) {
+                    state->Dispatch(state, std::move(batch));
+                }
+            }
+        }
+    };
+    ///@}
+}
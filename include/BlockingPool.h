@@ -0,0 +1,287 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <variant>
+#include "ThreadPool.h"
+#include "Fiber.h"
+
+namespace StreamLine{
+    /**
+     * @brief An elastic pool for work that blocks (synchronous file I/O, local RPC...), kept apart from the compute workers.
+     *
+     * Threads are started on demand when no idle one is available, up to MaxThreads, and exit after
+     * sitting idle for KeepAlive. Work submitted past the cap waits for a thread to free up.
+     */
+    class BlockingPool final{
+    private:
+        static inline std::mutex mtx;
+        static inline std::condition_variable workCv;
+        static inline std::condition_variable exitCv;
+        static inline std::deque<std::function<void()>> queue;
+        static inline unsigned int threads = 0;
+        static inline unsigned int idle = 0;
+        static inline unsigned int maxThreads = 512;
+        static inline std::chrono::milliseconds keepAlive{ 10000 };
+        static inline bool stopping = false;
+
+        static void Worker() {
+            std::unique_lock<std::mutex> lock(mtx);
+            while (true) {
+                while (queue.empty()) {
+                    if (stopping) {
+                        threads--;
+                        exitCv.notify_all();
+                        return;
+                    }
+                    idle++;
+                    const bool woken = workCv.wait_for(lock, keepAlive, []() noexcept { return !queue.empty() || stopping; });
+                    idle--;
+                    if (!woken) {
+                        //Idle for KeepAlive, shrink back.
+                        threads--;
+                        exitCv.notify_all();
+                        return;
+                    }
+                }
+                {
+                    std::function<void()> task = std::move(queue.front());
+                    queue.pop_front();
+                    lock.unlock();
+                    task();
+                }
+                lock.lock();
+            }
+        }
+    public:
+        /**
+         * @brief Runs f on a blocking thread.
+         * The function must not throw, an escaping exception terminates the process.
+         * @throws std::system_error if no thread could be started to run it, f is dropped then.
+         */
+        static void Submit(std::function<void()> f) {
+            std::unique_lock<std::mutex> lock(mtx);
+            queue.push_back(std::move(f));
+            if (idle > queue.size() - 1) {
+                lock.unlock();
+                workCv.notify_one();
+                return;
+            }
+            if (threads >= maxThreads || stopping) {
+                return;
+            }
+            static bool exitHookRegistered = false;
+            if (!exitHookRegistered) {
+                //Detached threads must be gone before the statics they wait on are destroyed.
+                std::atexit(Shutdown);
+                exitHookRegistered = true;
+            }
+            threads++;
+            try {
+                std::thread(Worker).detach();
+            }
+            catch (...) {
+                threads--;
+                if (threads > 0) {
+                    //A running thread gets to it once it frees up, as past the cap.
+                    return;
+                }
+                //Nothing would ever run it, take it back so the caller knows.
+                queue.pop_back();
+                throw;
+            }
+        }
+
+        static void SetMaxThreads(unsigned int count) noexcept {
+            std::lock_guard<std::mutex> lock(mtx);
+            maxThreads = std::max(1u, count);
+        }
+
+        static void SetKeepAlive(std::chrono::milliseconds duration) noexcept {
+            std::lock_guard<std::mutex> lock(mtx);
+            keepAlive = duration;
+        }
+
+        /// @brief Threads currently alive, busy or idle. Informational only.
+        static unsigned int GetThreadCount() noexcept {
+            std::lock_guard<std::mutex> lock(mtx);
+            return threads;
+        }
+
+        /**
+         * @brief Lets the threads drain the queue and waits for them to exit.
+         */
+        static void Shutdown() {
+            std::unique_lock<std::mutex> lock(mtx);
+            stopping = true;
+            workCv.notify_all();
+            exitCv.wait(lock, []() noexcept { return threads == 0; });
+            stopping = false;
+        }
+    };
+
+    namespace Internal{
+        /// @brief Holds either the value of a blocking call or the exception it threw.
+        template<class R>
+        struct BlockingResult{
+            std::conditional_t<std::is_void_v<R>, std::monostate, std::optional<R>> value;
+            std::exception_ptr error;
+
+            template<class F>
+            void Run(F& f) noexcept {
+                try {
+                    if constexpr (std::is_void_v<R>) {
+                        f();
+                    }
+                    else {
+                        value.emplace(f());
+                    }
+                }
+                catch (...) {
+                    error = std::current_exception();
+                }
+            }
+
+            R Get() {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+                if constexpr (!std::is_void_v<R>) {
+                    return std::move(*value);
+                }
+            }
+        };
+    }
+
+    /**
+     * @brief Runs f on the BlockingPool, then then(result) on the ThreadPool.
+     *
+     * result is a ready std::future, get() returns f's value or rethrows its exception.
+     */
+    template<class F, class Then>
+    void RunBlocking(F&& f, Then&& then) {
+        using R = std::invoke_result_t<std::decay_t<F>&>;
+        struct Call{
+            std::decay_t<F> f;
+            std::decay_t<Then> then;
+            std::promise<R> promise;
+        };
+        //std::function wants copyable callables, the call is shared between both hops instead.
+        auto call = std::make_shared<Call>(Call{ std::forward<F>(f), std::forward<Then>(then), {} });
+        BlockingPool::Submit([call]() {
+            Internal::BlockingResult<R> result;
+            result.Run(call->f);
+            if (result.error) {
+                call->promise.set_exception(result.error);
+            }
+            else if constexpr (std::is_void_v<R>) {
+                call->promise.set_value();
+            }
+            else {
+                call->promise.set_value(std::move(*result.value));
+            }
+            ThreadPool::Submit([call]() {
+                call->then(call->promise.get_future());
+            });
+        });
+    }
+
+    /**
+     * @brief Runs f on the BlockingPool and returns its result.
+     *
+     * A fiber parks meanwhile and resumes on the ThreadPool, leaving its worker to other work.
+     * A compute worker outside a fiber can't be parked: f still runs on the BlockingPool, and the worker runs queued
+     * pool work until it returns. Other threads would block either way, so f simply runs inline.
+     */
+    template<class F>
+    auto RunBlocking(F&& f) -> std::invoke_result_t<F&> {
+        using R = std::invoke_result_t<F&>;
+        if (Fiber::Current() == nullptr) {
+            if (ThreadPool::GetWorkerIndex() < 0) {
+                return f();
+            }
+            struct Wait{
+                Internal::BlockingResult<R> result;
+                std::atomic<bool> done{ false };
+            };
+            //Shared, the blocking thread may still be storing when the wait returns.
+            auto wait = std::make_shared<Wait>();
+            BlockingPool::Submit([wait, fn = &f]() {
+                wait->result.Run(*fn);
+                wait->done.store(true, std::memory_order_release);
+            });
+            while (!wait->done.load(std::memory_order_acquire)) {
+                if (ThreadPool::RunPending(1) == 0) {
+                    std::this_thread::yield();
+                }
+            }
+            return wait->result.Get();
+        }
+        struct Call{
+            F* f;
+            Fiber* fiber;
+            Internal::BlockingResult<R> result;
+        };
+        Call call{ &f, Fiber::Current(), {} };
+        //Handed to the pool once the fiber is off its stack, so the blocking thread can't unpark it too early.
+        Fiber::Park([](void* p) {
+            Call* c = static_cast<Call*>(p);
+            try {
+                BlockingPool::Submit([c]() {
+                    c->result.Run(*c->f);
+                    c->fiber->Unpark();
+                });
+            }
+            catch (...) {
+                //Off the fiber's stack nothing can catch it, the fiber rethrows it instead.
+                c->result.error = std::current_exception();
+                c->fiber->Unpark();
+            }
+        }, &call);
+        return call.result.Get();
+    }
+
+    /**
+     * @brief co_await-able RunBlocking, the coroutine resumes on the ThreadPool.
+     */
+    template<class F>
+    class [[nodiscard]] BlockingAwaiter{
+    private:
+        using R = std::invoke_result_t<F&>;
+        F f;
+        Internal::BlockingResult<R> result;
+    public:
+        explicit BlockingAwaiter(F function) : f(std::move(function)) {}
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            BlockingPool::Submit([this, handle]() {
+                result.Run(f);
+                ThreadPool::Submit([handle]() { handle.resume(); });
+            });
+        }
+
+        R await_resume() {
+            return result.Get();
+        }
+    };
+
+    template<class F>
+    BlockingAwaiter<std::decay_t<F>> RunBlockingAsync(F&& f) {
+        return BlockingAwaiter<std::decay_t<F>>(std::forward<F>(f));
+    }
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <concepts>
+#include <type_traits>
+
+namespace StreamLine{
+    /**
+     * @brief Anything invocable with Args whose result converts to R.
+     */
+    template<class F, class R, class... Args>
+    concept Callable = std::invocable<F, Args...> && std::convertible_to<std::invoke_result_t<F, Args...>, R>;
+}
@@ -0,0 +1,376 @@
+#pragma once
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include "ThreadPool.h"
+
+namespace StreamLine{
+    /** \addtogroup Parallel
+     *  @{
+     */
+
+    template<class T = void>
+    class CoTask;
+    class SpawnScope;
+
+    namespace Internal{
+        //Small and trivially copyable, so std::function stores it inline.
+        struct ResumeThunk{
+            void* address;
+
+            void operator()() const {
+                std::coroutine_handle<>::from_address(address).resume();
+            }
+
+            bool operator==(const ResumeThunk&) const = default;
+        };
+
+        struct CoPromiseBase{
+            //Awaiting coroutine, for a plain co_await.
+            std::coroutine_handle<> continuation;
+            //Set by SyncWait.
+            std::atomic<bool>* done = nullptr;
+            //Set by SpawnScope::Spawn.
+            SpawnScope* scope = nullptr;
+            std::coroutine_handle<> parent;
+            bool parentQueued = false;
+            std::exception_ptr error;
+
+            std::suspend_always initial_suspend() noexcept {
+                return {};
+            }
+
+            void unhandled_exception() noexcept {
+                error = std::current_exception();
+            }
+        };
+
+        template<class T>
+        struct CoPromise : CoPromiseBase{
+            std::optional<T> value;
+            T* out = nullptr;
+
+            void return_value(T v) {
+                value.emplace(std::move(v));
+            }
+
+            void Deliver() {
+                *out = std::move(*value);
+            }
+
+            T Take() {
+                return std::move(*value);
+            }
+        };
+
+        template<>
+        struct CoPromise<void> : CoPromiseBase{
+            void return_void() noexcept {}
+
+            void Deliver() noexcept {}
+
+            void Take() noexcept {}
+        };
+
+        template<class Promise>
+        struct CoFinalAwaiter{
+            bool await_ready() const noexcept {
+                return false;
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept;
+
+            void await_resume() const noexcept {}
+        };
+
+        template<class T>
+        class SpawnAwaiter;
+    }
+
+    /**
+     * @brief Fork-join scope for CoTasks with continuation stealing, in the manner of Cilk's spawn and sync.
+     *
+     * Spawn runs the child right away on the current thread, and queues the rest of the parent (its continuation)
+     * on the worker's mailbox. An idle worker may steal and resume the parent meanwhile. When the child returns and
+     * nobody did, the parent is taken back and simply goes on, as a call would. Queued work thus stays at one
+     * continuation per level of the recursion being executed on each worker, where child stealing queues every
+     * spawned child up front. Sync suspends the parent until every child spawned in the scope returned.
+     *
+     * Example usage:
+     * @code
+     * CoTask<long> Fib(int n) {
+     *     if (n < 2) co_return n;
+     *     SpawnScope scope;
+     *     long a = 0;
+     *     co_await scope.Spawn(Fib(n - 1), a);
+     *     long b = co_await Fib(n - 2);
+     *     co_await scope.Sync();
+     *     co_return a + b;
+     * }
+     * long result = SyncWait(Fib(30));
+     * @endcode
+     *
+     * @note A child's result must not be read before Sync, the parent may be running beside the child.
+     * The scope must be synced before it goes out of scope. Sync rethrows the first exception of a child.
+     * Control passes between coroutines by symmetric transfer, which needs the compiler's tail calls:
+     * sanitizer builds lose them and deep recursions can overflow the stack there.
+     */
+    class SpawnScope{
+    private:
+        template<class Promise>
+        friend struct Internal::CoFinalAwaiter;
+        template<class T>
+        friend class Internal::SpawnAwaiter;
+
+        //Children not done yet, plus one until the parent syncs.
+        std::atomic<std::size_t> pending{ 1 };
+        std::coroutine_handle<> waiter;
+        std::atomic<bool> failed{ false };
+        std::exception_ptr error;
+
+        void Fail(std::exception_ptr e) noexcept {
+            if (!failed.exchange(true)) {
+                error = std::move(e);
+            }
+        }
+
+        /// @brief What the thread finishing a child runs next.
+        std::coroutine_handle<> ChildDone(std::coroutine_handle<> parent, bool parentQueued) noexcept {
+            //The parent was not queued, or nobody stole it: it can't have synced, so it isn't the last one.
+            if (!parentQueued || ThreadPool::Retract(Internal::ResumeThunk{ parent.address() })) {
+                pending.fetch_sub(1, std::memory_order_acq_rel);
+                return parent;
+            }
+            //Stolen: whoever runs it owns it now, unless it already waits on this child in Sync.
+            if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                return waiter;
+            }
+            return std::noop_coroutine();
+        }
+
+        class SyncAwaiter{
+        private:
+            SpawnScope* scope;
+        public:
+            explicit SyncAwaiter(SpawnScope* s) noexcept : scope(s) {}
+
+            bool await_ready() const noexcept {
+                return scope->pending.load(std::memory_order_acquire) == 1;
+            }
+
+            bool await_suspend(std::coroutine_handle<> handle) noexcept {
+                scope->waiter = handle;
+                //Resumed by the last child, unless that already happened.
+                return scope->pending.fetch_sub(1, std::memory_order_acq_rel) != 1;
+            }
+
+            void await_resume() {
+                scope->pending.store(1, std::memory_order_relaxed);
+                scope->failed.store(false, std::memory_order_relaxed);
+                if (std::exception_ptr e = std::exchange(scope->error, nullptr)) {
+                    std::rethrow_exception(e);
+                }
+            }
+        };
+    public:
+        SpawnScope() noexcept = default;
+        SpawnScope(const SpawnScope&) = delete;
+        SpawnScope& operator=(const SpawnScope&) = delete;
+
+        /// @brief Runs task now, its result goes to result by the time Sync returns.
+        template<class T>
+        Internal::SpawnAwaiter<T> Spawn(CoTask<T> task, T& result);
+
+        Internal::SpawnAwaiter<void> Spawn(CoTask<void> task);
+
+        /// @brief Waits for every child spawned so far.
+        [[nodiscard]] SyncAwaiter Sync() noexcept {
+            return SyncAwaiter(this);
+        }
+    };
+
+    /**
+     * @brief Lazily started coroutine returning T, run by co_await (like a call), SpawnScope::Spawn or SyncWait.
+     */
+    template<class T>
+    class [[nodiscard]] CoTask{
+    public:
+        struct promise_type : Internal::CoPromise<T>{
+            CoTask get_return_object() noexcept {
+                return CoTask(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+
+            Internal::CoFinalAwaiter<promise_type> final_suspend() noexcept {
+                return {};
+            }
+        };
+    private:
+        template<class U>
+        friend class Internal::SpawnAwaiter;
+        template<class U>
+        friend U SyncWait(CoTask<U> task);
+
+        std::coroutine_handle<promise_type> handle;
+
+        explicit CoTask(std::coroutine_handle<promise_type> h) noexcept : handle(h) {}
+
+        class Awaiter{
+        private:
+            std::coroutine_handle<promise_type> handle;
+        public:
+            explicit Awaiter(std::coroutine_handle<promise_type> h) noexcept : handle(h) {}
+
+            bool await_ready() const noexcept {
+                return false;
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+
+            T await_resume() {
+                if (handle.promise().error) {
+                    std::rethrow_exception(handle.promise().error);
+                }
+                return handle.promise().Take();
+            }
+        };
+    public:
+        CoTask(CoTask&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+        CoTask& operator=(CoTask&& other) noexcept {
+            std::swap(handle, other.handle);
+            return *this;
+        }
+
+        ~CoTask() {
+            if (handle) {
+                handle.destroy();
+            }
+        }
+
+        Awaiter operator co_await() && noexcept {
+            return Awaiter(handle);
+        }
+    };
+
+    namespace Internal{
+        template<class Promise>
+        std::coroutine_handle<> CoFinalAwaiter<Promise>::await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            Promise& promise = handle.promise();
+            if (promise.scope != nullptr) {
+                //Spawned: the frame is ours to free.
+                SpawnScope* scope = promise.scope;
+                const std::coroutine_handle<> parent = promise.parent;
+                const bool parentQueued = promise.parentQueued;
+                if (promise.error) {
+                    scope->Fail(promise.error);
+                }
+                else {
+                    try {
+                        promise.Deliver();
+                    }
+                    catch (...) {
+                        scope->Fail(std::current_exception());
+                    }
+                }
+                handle.destroy();
+                return scope->ChildDone(parent, parentQueued);
+            }
+            if (promise.done != nullptr) {
+                //The waiting thread may free the frame as soon as this is stored.
+                promise.done->store(true, std::memory_order_release);
+                return std::noop_coroutine();
+            }
+            return promise.continuation ? promise.continuation : std::noop_coroutine();
+        }
+
+        template<class T>
+        class [[nodiscard]] SpawnAwaiter{
+        private:
+            using Handle = std::coroutine_handle<typename CoTask<T>::promise_type>;
+
+            SpawnScope* scope;
+            Handle child;
+            std::add_pointer_t<T> out;
+        public:
+            SpawnAwaiter(SpawnScope* s, CoTask<T>&& task, std::add_pointer_t<T> result) noexcept
+                : scope(s), child(std::exchange(task.handle, nullptr)), out(result) {}
+
+            SpawnAwaiter(const SpawnAwaiter&) = delete;
+            SpawnAwaiter& operator=(const SpawnAwaiter&) = delete;
+
+            ~SpawnAwaiter() {
+                //Never awaited.
+                if (child) {
+                    child.destroy();
+                }
+            }
+
+            bool await_ready() const noexcept {
+                return false;
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> parent) {
+                const Handle next = std::exchange(child, nullptr);
+                auto& promise = next.promise();
+                promise.scope = scope;
+                promise.parent = parent;
+                if constexpr (!std::is_void_v<T>) {
+                    promise.out = out;
+                }
+                scope->pending.fetch_add(1, std::memory_order_relaxed);
+                //Nobody would steal it: the child returns straight into the parent, like a call.
+                promise.parentQueued = ThreadPool::IsHungry();
+                if (promise.parentQueued) {
+                    //The parent may resume elsewhere from here on, this awaiter lives in its frame.
+                    const int self = ThreadPool::GetWorkerIndex();
+                    if (self >= 0) {
+                        ThreadPool::SubmitTo(static_cast<unsigned int>(self), ResumeThunk{ parent.address() });
+                    }
+                    else {
+                        ThreadPool::Submit(ResumeThunk{ parent.address() });
+                    }
+                }
+                return next;
+            }
+
+            void await_resume() const noexcept {}
+        };
+    }
+
+    template<class T>
+    Internal::SpawnAwaiter<T> SpawnScope::Spawn(CoTask<T> task, T& result) {
+        return Internal::SpawnAwaiter<T>(this, std::move(task), &result);
+    }
+
+    inline Internal::SpawnAwaiter<void> SpawnScope::Spawn(CoTask<void> task) {
+        return Internal::SpawnAwaiter<void>(this, std::move(task), nullptr);
+    }
+
+    /**
+     * @brief Runs task from outside any coroutine and returns its result, running other queued work while it is stolen.
+     */
+    template<class T>
+    T SyncWait(CoTask<T> task) {
+        std::atomic<bool> done{ false };
+        task.handle.promise().done = &done;
+        task.handle.resume();
+        while (!done.load(std::memory_order_acquire)) {
+            if (ThreadPool::RunPending(1) == 0) {
+                std::this_thread::yield();
+            }
+        }
+        if (task.handle.promise().error) {
+            std::rethrow_exception(task.handle.promise().error);
+        }
+        return task.handle.promise().Take();
+    }
+    ///@}
+}
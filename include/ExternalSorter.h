@@ -0,0 +1,502 @@
+#pragma once
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "Fiber.h"
+#include "BlockingPool.h"
+#include "Parallel.h"
+#include "SpillFile.h"
+
+namespace StreamLine::IO{
+    /** \addtogroup IO
+     *  @{
+     */
+
+    struct ExternalSorterOptions{
+        /// @brief Hard cap on the bytes of records and I/O blocks the sorter holds, at least 5 blocks.
+        std::size_t MemoryBudget = std::size_t(256) << 20;
+        /// @brief Size of the spill writes and of every read-ahead block of the merge.
+        std::size_t BlockSize = std::size_t(4) << 20;
+        /// @brief Where run files go, empty for $TMPDIR or /tmp. The files are unlinked as soon as they are created.
+        std::string TempDirectory;
+    };
+
+    namespace Internal{
+        /**
+         * @brief Tournament tree over k sorted sources, finding the next smallest head in log2(k) comparisons.
+         * A null head is an exhausted source, ties go to the lower source index.
+         */
+        template<class T, class Compare>
+        class LoserTree{
+        private:
+            std::vector<const T*> heads;
+            std::vector<std::size_t> losers;
+            Compare* comp = nullptr;
+
+            bool Beats(std::size_t a, std::size_t b) const {
+                if (heads[b] == nullptr) {
+                    return heads[a] != nullptr || a < b;
+                }
+                if (heads[a] == nullptr) {
+                    return false;
+                }
+                if ((*comp)(*heads[a], *heads[b])) {
+                    return true;
+                }
+                return !(*comp)(*heads[b], *heads[a]) && a < b;
+            }
+
+            std::size_t Build(std::size_t node) {
+                const std::size_t k = heads.size();
+                if (node >= k) {
+                    return node - k;
+                }
+                const std::size_t left = Build(2 * node);
+                const std::size_t right = Build(2 * node + 1);
+                if (Beats(left, right)) {
+                    losers[node] = right;
+                    return left;
+                }
+                losers[node] = left;
+                return right;
+            }
+        public:
+            /// @brief Starts a tournament over heads.
+            void Reset(std::vector<const T*> sourceHeads, Compare& compare) {
+                heads = std::move(sourceHeads);
+                comp = &compare;
+                losers.assign(std::max<std::size_t>(1, heads.size()), 0);
+                if (heads.size() > 1) {
+                    losers[0] = Build(1);
+                }
+            }
+
+            /// @brief Source holding the smallest head, its head is null once every source ran out.
+            inline std::size_t Winner() const noexcept {
+                return losers[0];
+            }
+
+            inline const T* Head(std::size_t source) const noexcept {
+                return heads[source];
+            }
+
+            /// @brief Moves the winner to its new head and replays its path to the root.
+            void Replace(const T* head) {
+                std::size_t winner = losers[0];
+                heads[winner] = head;
+                for (std::size_t node = (winner + heads.size()) / 2; node > 0; node /= 2) {
+                    if (Beats(losers[node], winner)) {
+                        std::swap(losers[node], winner);
+                    }
+                }
+                losers[0] = winner;
+            }
+        };
+    }
+
+    /**
+     * @brief Sorts more records than fit in memory, spilling sorted runs to temporary files.
+     *
+     * Pushed records fill one of two run buffers. A full buffer is spilled on the BlockingPool while the other fills:
+     * its chunks are sorted in parallel on the ThreadPool, then merged with a loser tree into large sequential writes.
+     * Finish merges the runs (in several passes if there are too many for the budget), Next and ForEach then pull
+     * the records in order. Every run reads ahead one block on the BlockingPool while the merge consumes the other.
+     * Streams that fit in one run buffer never touch the disk.
+     *
+     * Memory stays within MemoryBudget: two run buffers and a write block while pushing,
+     * two blocks per merged run afterwards.
+     *
+     * Example usage:
+     * @code
+     * IO::ExternalSorter<Record, ByKey> sorter;
+     * auto parsed = Stream::From(lines) | Stream::Parallel(4096) | Stream::Map(Parse);
+     * parsed.ForEach([&](const Record& r) { sorter.Push(r); });
+     * sorter.Finish();
+     * sorter.ForEach([&](const Record& r) { Write(r); });
+     * @endcode
+     *
+     * @tparam T Trivially copyable record, spilled as raw bytes.
+     * @note Push may be called from several threads at once and blocks (or parks a fiber) while both buffers are full.
+     * The sort is not stable.
+     */
+    template<class T, class Compare = std::less<>>
+    class ExternalSorter{
+    private:
+        static_assert(std::is_trivially_copyable_v<T> && std::is_default_constructible_v<T>, "ExternalSorter records must be trivially copyable");
+
+        struct Run{
+            Internal::SpillFile file;
+            std::uint64_t count;
+        };
+
+        /// @brief A sorted sequence being merged: a chunk in memory, or a run file read a block ahead.
+        struct Source{
+            const T* cursor = nullptr;
+            const T* end = nullptr;
+            //Null for chunks in memory.
+            const Internal::SpillFile* file = nullptr;
+            std::uint64_t offset = 0;
+            std::uint64_t left = 0;
+            std::unique_ptr<T[]> blocks[2];
+            std::size_t current = 1;
+            std::size_t filled = 0;
+            bool reading = false;
+            int error = 0;
+        };
+
+        /// @brief The sources and their tournament, owned by one thread at a time.
+        struct Merger{
+            std::deque<Source> sources;
+            Internal::LoserTree<T, Compare> tree;
+        };
+
+        ExternalSorterOptions options;
+        Compare comp;
+        std::size_t blockRecords;
+        std::size_t runRecords;
+        std::size_t fanIn;
+
+        std::mutex mtx;
+        std::condition_variable cv;
+        FiberWaitList fiberWaiters;
+        std::unique_ptr<T[]> buffers[2];
+        std::size_t fill = 0;
+        std::size_t filled = 0;
+        bool spilling = false;
+        bool finished = false;
+        std::size_t inFlight = 0;
+        std::exception_ptr error;
+        std::deque<Run> runs;
+        Merger output;
+
+        void WakeAll() {
+            fiberWaiters.WakeAll();
+            cv.notify_all();
+        }
+
+        template<class Predicate>
+        void WaitUntil(std::unique_lock<std::mutex>& lock, Predicate predicate) {
+            if (Fiber::Current() != nullptr) {
+                while (!predicate()) {
+                    fiberWaiters.Park(lock);
+                }
+                return;
+            }
+            cv.wait(lock, predicate);
+        }
+
+        void ThrowIfFailed() {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+
+        /// @brief Reads the next block of source into its idle block on the BlockingPool, lock held.
+        void StartRead(Source& source) {
+            const std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(source.left, blockRecords));
+            T* block = source.blocks[source.current ^ 1].get();
+            const std::uint64_t offset = source.offset;
+            source.offset += count * sizeof(T);
+            source.left -= count;
+            source.reading = true;
+            inFlight++;
+            BlockingPool::Submit([this, &source, block, count, offset]() {
+                const int result = source.file->ReadAt(block, count * sizeof(T), offset);
+                std::lock_guard<std::mutex> lock(mtx);
+                source.error = result;
+                source.filled = count;
+                source.reading = false;
+                inFlight--;
+                WakeAll();
+            });
+        }
+
+        /// @brief Moves an exhausted source to its read-ahead block and starts reading the next one.
+        void Advance(Source& source) {
+            if (source.file == nullptr) {
+                source.cursor = source.end = nullptr;
+                return;
+            }
+            std::unique_lock<std::mutex> lock(mtx);
+            WaitUntil(lock, [&]() { return !source.reading; });
+            if (source.error != 0) {
+                throw std::system_error(source.error, std::generic_category(), "ExternalSorter read");
+            }
+            if (source.filled == 0) {
+                source.cursor = source.end = nullptr;
+                return;
+            }
+            source.current ^= 1;
+            source.cursor = source.blocks[source.current].get();
+            source.end = source.cursor + source.filled;
+            source.filled = 0;
+            if (source.left > 0) {
+                StartRead(source);
+            }
+        }
+
+        void Start(Merger& merger) {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                for (Source& source : merger.sources) {
+                    if (source.file != nullptr && source.left > 0) {
+                        StartRead(source);
+                    }
+                }
+            }
+            std::vector<const T*> heads;
+            for (Source& source : merger.sources) {
+                if (source.cursor == source.end) {
+                    Advance(source);
+                }
+                heads.push_back(source.cursor);
+            }
+            merger.tree.Reset(std::move(heads), comp);
+        }
+
+        /// @brief Merges every source into out(block, count) calls of at most blockRecords records.
+        template<class Out>
+        void Drain(Merger& merger, T* block, Out&& out) {
+            std::size_t count = 0;
+            while (true) {
+                const std::size_t winner = merger.tree.Winner();
+                Source& source = merger.sources[winner];
+                if (merger.tree.Head(winner) == nullptr) {
+                    break;
+                }
+                block[count++] = *source.cursor++;
+                if (source.cursor == source.end) {
+                    Advance(source);
+                }
+                merger.tree.Replace(source.cursor);
+                if (count == blockRecords) {
+                    out(block, count);
+                    count = 0;
+                }
+            }
+            if (count > 0) {
+                out(block, count);
+            }
+        }
+
+        /// @brief Sorts [data, data + count) as chunks in parallel, the chunks become the sources of merger.
+        void SortChunks(T* data, std::size_t count, Merger& merger) {
+            const std::size_t workers = ThreadPool::IsRunning() ? ThreadPool::GetThreadCount() : 0;
+            const std::size_t chunk = std::max<std::size_t>(std::size_t(1) << 14, (count + workers) / (workers + 1));
+            ParallelFor(0, count, chunk, [&](std::size_t first, std::size_t last) {
+                std::sort(data + first, data + last, comp);
+            });
+            for (std::size_t first = 0; first < count; first += chunk) {
+                Source& source = merger.sources.emplace_back();
+                source.cursor = data + first;
+                source.end = data + std::min(count, first + chunk);
+            }
+        }
+
+        void OpenRun(Merger& merger, const Run& run) {
+            Source& source = merger.sources.emplace_back();
+            source.file = &run.file;
+            source.left = run.count;
+            source.blocks[0] = std::make_unique_for_overwrite<T[]>(blockRecords);
+            source.blocks[1] = std::make_unique_for_overwrite<T[]>(blockRecords);
+        }
+
+        /// @brief Writes the sources of merger to a new run file.
+        Run WriteRun(Merger& merger, std::uint64_t count) {
+            Run run{ Internal::SpillFile(options.TempDirectory), count };
+            auto block = std::make_unique_for_overwrite<T[]>(blockRecords);
+            Start(merger);
+            Drain(merger, block.get(), [&](const T* data, std::size_t n) { run.file.Append(data, n * sizeof(T)); });
+            return run;
+        }
+
+        /// @brief Turns a run buffer into a run file, on a blocking thread.
+        void Spill(T* data, std::size_t count) {
+            std::exception_ptr failure;
+            try {
+                Merger merger;
+                SortChunks(data, count, merger);
+                Run run = WriteRun(merger, count);
+                std::lock_guard<std::mutex> lock(mtx);
+                runs.push_back(std::move(run));
+            }
+            catch (...) {
+                failure = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(mtx);
+            if (failure && !error) {
+                error = failure;
+            }
+            spilling = false;
+            WakeAll();
+        }
+
+        /// @brief Merges the oldest runs together until the rest can be merged at once.
+        void ReduceRuns() {
+            while (runs.size() > fanIn) {
+                Merger merger;
+                std::uint64_t count = 0;
+                for (std::size_t i = 0; i < fanIn; i++) {
+                    OpenRun(merger, runs[i]);
+                    count += runs[i].count;
+                }
+                Run merged = WriteRun(merger, count);
+                std::lock_guard<std::mutex> lock(mtx);
+                for (std::size_t i = 0; i < fanIn; i++) {
+                    runs.pop_front();
+                }
+                runs.push_back(std::move(merged));
+            }
+        }
+    public:
+        /// @throws std::invalid_argument if the budget holds fewer than 5 blocks.
+        explicit ExternalSorter(const ExternalSorterOptions& sorterOptions = ExternalSorterOptions(), Compare compare = Compare())
+            : options(sorterOptions), comp(std::move(compare)) {
+            blockRecords = std::max<std::size_t>(1, options.BlockSize / sizeof(T));
+            const std::size_t blockBytes = blockRecords * sizeof(T);
+            if (options.MemoryBudget < 5 * blockBytes) {
+                throw std::invalid_argument("ExternalSorter memory budget below 5 blocks");
+            }
+            runRecords = (options.MemoryBudget - blockBytes) / 2 / sizeof(T);
+            fanIn = (options.MemoryBudget / blockBytes - 1) / 2;
+        }
+
+        ~ExternalSorter() {
+            std::unique_lock<std::mutex> lock(mtx);
+            WaitUntil(lock, [&]() { return !spilling && inFlight == 0; });
+        }
+
+        ExternalSorter(const ExternalSorter&) = delete;
+        ExternalSorter& operator=(const ExternalSorter&) = delete;
+
+        /**
+         * @brief Adds count records, copied.
+         * @throws std::system_error if a spill failed, std::logic_error after Finish.
+         */
+        void Push(const T* values, std::size_t count) {
+            std::unique_lock<std::mutex> lock(mtx);
+            while (count > 0) {
+                ThrowIfFailed();
+                if (finished) {
+                    throw std::logic_error("ExternalSorter pushed to after Finish");
+                }
+                if (!buffers[fill]) {
+                    buffers[fill] = std::make_unique_for_overwrite<T[]>(runRecords);
+                }
+                if (filled == runRecords) {
+                    //The other buffer is free once its spill is done.
+                    WaitUntil(lock, [&]() { return !spilling; });
+                    ThrowIfFailed();
+                    spilling = true;
+                    BlockingPool::Submit([this, data = buffers[fill].get(), full = filled]() {
+                        Spill(data, full);
+                    });
+                    fill ^= 1;
+                    filled = 0;
+                    continue;
+                }
+                const std::size_t n = std::min(count, runRecords - filled);
+                std::copy(values, values + n, buffers[fill].get() + filled);
+                filled += n;
+                values += n;
+                count -= n;
+            }
+        }
+
+        inline void Push(const T& value) {
+            Push(&value, 1);
+        }
+
+        /**
+         * @brief Ends the input and prepares the merge, call it once every Push returned.
+         * @throws std::system_error on spill errors, std::logic_error if called twice.
+         */
+        void Finish() {
+            std::unique_lock<std::mutex> lock(mtx);
+            WaitUntil(lock, [&]() { return !spilling; });
+            ThrowIfFailed();
+            if (finished) {
+                throw std::logic_error("ExternalSorter finished twice");
+            }
+            finished = true;
+            T* data = buffers[fill].get();
+            const std::size_t count = filled;
+            if (runs.empty()) {
+                //Everything fit in one buffer, the merge reads the sorted chunks in memory.
+                buffers[fill ^ 1].reset();
+                lock.unlock();
+                SortChunks(data, count, output);
+                Start(output);
+                return;
+            }
+            lock.unlock();
+            RunBlocking([&]() {
+                if (count > 0) {
+                    //Locked here rather than through Finish's lock, this may run on another thread.
+                    {
+                        std::lock_guard<std::mutex> guard(mtx);
+                        spilling = true;
+                    }
+                    Spill(data, count);
+                    std::lock_guard<std::mutex> guard(mtx);
+                    ThrowIfFailed();
+                }
+                buffers[0].reset();
+                buffers[1].reset();
+                ReduceRuns();
+            });
+            for (const Run& run : runs) {
+                OpenRun(output, run);
+            }
+            Start(output);
+        }
+
+        /// @brief Takes the next record in order, false once all were taken. Single consumer, after Finish.
+        bool Next(T& out) {
+            if (!finished || output.sources.empty()) {
+                return false;
+            }
+            const std::size_t winner = output.tree.Winner();
+            Source& source = output.sources[winner];
+            if (output.tree.Head(winner) == nullptr) {
+                return false;
+            }
+            out = *source.cursor++;
+            if (source.cursor == source.end) {
+                Advance(source);
+            }
+            output.tree.Replace(source.cursor);
+            return true;
+        }
+
+        /// @brief Calls f on every record left, in order.
+        template<class F>
+        void ForEach(F&& f) {
+            T value;
+            while (Next(value)) {
+                f(static_cast<const T&>(value));
+            }
+        }
+
+        /// @brief Runs spilled so far. Informational only.
+        std::size_t GetRunCount() {
+            std::lock_guard<std::mutex> lock(mtx);
+            return runs.size();
+        }
+    };
+    ///@}
+}
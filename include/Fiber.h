@@ -0,0 +1,161 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "ThreadPool.h"
+#include "Exception.h"
+
+//The context switch is hand written for the System V x86-64 and AArch64 calling conventions.
+#if !defined(_WIN32) && (defined(__x86_64__) || defined(__aarch64__))
+#define STREAMLINE_FIBERS_SUPPORTED 1
+#else
+#define STREAMLINE_FIBERS_SUPPORTED 0
+#endif
+
+namespace StreamLine{
+    /** \addtogroup Fibers
+     *  @{
+     */
+
+    /**
+     * @brief Configures the stack a fiber is spawned with.
+     */
+    struct FiberOptions{
+        /// @brief Usable stack size in bytes, rounded up to the page size.
+        std::size_t StackSize = 64 * 1024;
+        /**
+         * @brief Hand the touched pages back to the OS when the stack is recycled, and reserve it without swap.
+         * Stacks are always committed on first touch, a recycled stack otherwise keeps the pages its last fiber used.
+         * Meant for the few fibers that need huge stacks.
+         */
+        bool LazyCommit = false;
+        /**
+         * @brief Map a guard page below the stack, so that an overflow faults instead of corrupting memory.
+         * Spawning fails with std::bad_alloc once the guarded stack budget is spent, see FiberStackPool::SetMaxGuarded.
+         */
+        bool GuardPage = true;
+    };
+
+    /// @brief A stack mapping, Base points at the guard page when there is one.
+    struct FiberStack{
+        void* Base = nullptr;
+        /// @brief Size of the whole mapping, guard page included.
+        std::size_t Size = 0;
+        bool Lazy = false;
+        /// @brief False for stacks acquired without a guard page, the lowest page is then plain memory.
+        bool Guarded = false;
+
+        inline void* Top() const noexcept {
+            return static_cast<char*>(Base) + Size;
+        }
+    };
+
+    /**
+     * @brief Recycles fiber stacks so spawning does not pay for mmap/mprotect/munmap on every fiber.
+     */
+    class FiberStackPool final{
+    public:
+        /// @throws std::bad_alloc if the mapping fails, or a guard page is asked for past the SetMaxGuarded budget.
+        static FiberStack Acquire(std::size_t size, bool lazy, bool guarded = true);
+        static void Release(const FiberStack& stack) noexcept;
+        /// @brief Caps the number of idle stacks kept around, extra stacks are unmapped on release.
+        static void SetMaxCached(std::size_t count) noexcept;
+        /**
+         * @brief Caps the number of live guard-paged stacks.
+         * Every guard page splits a kernel memory mapping and the per process mapping count is limited
+         * (vm.max_map_count, 65530 by default). Past the cap acquiring a guarded stack fails: raise both for more
+         * live fibers, or spawn them with FiberOptions::GuardPage off.
+         */
+        static void SetMaxGuarded(std::size_t count) noexcept;
+        /// @brief Unmaps every idle stack.
+        static void Trim() noexcept;
+    };
+
+    /**
+     * @brief A stackful coroutine scheduled on the ThreadPool.
+     *
+     * A fiber runs on whichever worker picks it up. When it blocks on a WaitGroup, Latch or Barrier it parks
+     * instead of the worker, which goes on to run other work, and it is requeued on the pool once signaled.
+     * A parked fiber may resume on a different worker.
+     *
+     * @note Do not park while an exception is being handled (inside a catch block),
+     * the C++ runtime keeps that state per thread.
+     */
+    class Fiber final{
+    private:
+        void* sp = nullptr;        // Saved stack pointer while switched out.
+        void* callerSp = nullptr;  // Context of whoever resumed the fiber, switched back to on park or exit.
+        FiberStack stack;
+        std::function<void()> body;
+        void (*afterSwitch)(void*) = nullptr;
+        void* afterSwitchArg = nullptr;
+        bool finished = false;
+
+        Fiber(std::function<void()>&& f, const FiberStack& s);
+        static void Entry(void* self) noexcept;
+        void Resume();
+    public:
+        Fiber(const Fiber&) = delete;
+        Fiber& operator=(const Fiber&) = delete;
+
+        /**
+         * @brief Runs f as a fiber on the ThreadPool.
+         *
+         * @throws InvalidOperation if the pool isn't running or fibers aren't supported on this platform.
+         * An exception escaping f terminates the process, like it would a std::thread.
+         */
+        static void Spawn(std::function<void()> f, const FiberOptions& options = FiberOptions());
+
+        /// @brief The fiber running on this thread, nullptr outside of fibers.
+        static Fiber* Current() noexcept;
+
+        /**
+         * @brief Identifies the running fiber, or the thread outside of fibers.
+         * Ownership checks use it since a fiber can move between threads.
+         */
+        static const void* ExecutionId() noexcept;
+
+        /// @brief Requeues the current fiber behind the pending work, or yields the thread outside of fibers.
+        static void Yield();
+
+        /**
+         * @brief Switches the current fiber out until Unpark is called.
+         *
+         * afterSwitch(arg) runs on the same thread once the fiber is off its stack,
+         * that is where a lock guarding the wait list gets released so no one can Unpark a fiber that is still running.
+         */
+        static void Park(void (*afterSwitch)(void*), void* arg);
+
+        /// @brief Queues a parked fiber on the ThreadPool.
+        void Unpark();
+    };
+
+    /**
+     * @brief Fibers parked on a blocking primitive, guarded by the primitive's own lock.
+     */
+    class FiberWaitList{
+    private:
+        std::vector<Fiber*> waiters;
+    public:
+        /**
+         * @brief Parks the calling fiber until WakeAll, returns with the lock held again.
+         * Spurious returns are possible, callers re-check their condition in a loop.
+         */
+        template<class Lock>
+        void Park(Lock& lock){
+            waiters.push_back(Fiber::Current());
+            Fiber::Park([](void* l) noexcept { static_cast<Lock*>(l)->unlock(); }, &lock);
+            lock.lock();
+        }
+
+        /// @brief Requeues every parked fiber, must be called with the guarding lock held.
+        void WakeAll(){
+            for (Fiber* fiber : waiters) {
+                fiber->Unpark();
+            }
+            waiters.clear();
+        }
+    };
+    ///@}
+}
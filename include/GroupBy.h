@@ -0,0 +1,213 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "ThreadPool.h"
+#include "Parallel.h"
+#include "WorkerLocal.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+namespace StreamLine{
+    /** \addtogroup Stream
+     *  @{
+     */
+
+    struct GroupByOptions{
+        /// @brief Size a worker's pre-aggregation table may reach before it is flushed to the partitions, 0 for the L2 size.
+        std::size_t LocalTableBytes = 0;
+        /// @brief log2 of the partition count.
+        unsigned int RadixBits = 8;
+    };
+
+    namespace Internal{
+        inline std::size_t L2CacheSize() noexcept {
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+            const long size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+            if (size > 0) {
+                return static_cast<std::size_t>(size);
+            }
+#endif
+            return std::size_t(1) << 20;
+        }
+    }
+
+    /**
+     * @brief Hash aggregation of a keyed stream, pre-aggregated per worker and merged in parallel.
+     *
+     * Each thread folds its values into its own hash table (a WorkerLocal), no locks or shared cache lines on the way.
+     * When a table outgrows LocalTableBytes its groups are moved out to radix partitions (by hash), so the table
+     * stays cache-resident. A worker whose flushes show keys hardly repeat stops pre-aggregating and sends
+     * groups straight to the partitions. Finish then merges every partition on its own task,
+     * each partition being a cache-sized slice of the key space.
+     *
+     * fold(acc, value) adds a value to a group's accumulator, which starts as a copy of initial.
+     * merge(acc, other) combines the partial accumulators of a key.
+     *
+     * Example usage:
+     * @code
+     * GroupBy<std::uint64_t, double, double> totals(0.0,
+     *     [](double& sum, const double& v) { sum += v; },
+     *     [](double& sum, const double& other) { sum += other; });
+     * ParallelFor(0, n, 0, [&](std::size_t first, std::size_t last) { totals.Push(users + first, amounts + first, last - first); });
+     * totals.Finish([](const std::uint64_t& user, double&& sum) { Publish(user, sum); });
+     * @endcode
+     *
+     * @note Push may run on several threads at once, but not concurrently with Finish.
+     */
+    template<class Key, class Value, class Acc, class Hash = std::hash<Key>>
+    class GroupBy{
+    public:
+        using Fold = std::function<void(Acc&, const Value&)>;
+        using Merge = std::function<void(Acc&, const Acc&)>;
+    private:
+        using Table = std::unordered_map<Key, Acc, Hash>;
+        using Group = std::pair<Key, Acc>;
+
+        //Node, bucket slot and allocator overhead of an unordered_map entry, roughly.
+        static constexpr std::size_t EntryBytes = sizeof(std::pair<const Key, Acc>) + 4 * sizeof(void*);
+
+        struct Local{
+            Table table;
+            std::vector<std::vector<Group>> partitions;
+            std::size_t folded = 0;
+            bool partitioned = false;
+        };
+
+        Acc initial;
+        Fold fold;
+        Merge merge;
+        Hash hash;
+        std::size_t maxEntries;
+        unsigned int radixBits;
+        WorkerLocal<Local> locals;
+
+        std::size_t PartitionOf(const Key& key) const {
+            //Spread poor hashes (identity for integers), the top bits pick the partition.
+            const std::uint64_t h = static_cast<std::uint64_t>(hash(key)) * 0x9E3779B97F4A7C15ull;
+            return radixBits == 0 ? 0 : static_cast<std::size_t>(h >> (64 - radixBits));
+        }
+
+        void Flush(Local& local) {
+            if (local.partitions.empty()) {
+                local.partitions.resize(std::size_t(1) << radixBits);
+            }
+            //Hardly any repeated key among the values folded since the last flush: the table isn't paying for itself.
+            if (local.table.size() * 4 > local.folded * 3) {
+                local.partitioned = true;
+            }
+            for (auto& [key, acc] : local.table) {
+                local.partitions[PartitionOf(key)].emplace_back(key, std::move(acc));
+            }
+            local.table.clear();
+            local.folded = 0;
+        }
+
+        void Add(Local& local, const Key& key, const Value& value) {
+            if (local.partitioned) {
+                Group group(key, initial);
+                fold(group.second, value);
+                local.partitions[PartitionOf(key)].push_back(std::move(group));
+                return;
+            }
+            auto it = local.table.find(key);
+            if (it == local.table.end()) {
+                if (local.table.size() >= maxEntries) {
+                    Flush(local);
+                }
+                it = local.table.emplace(key, initial).first;
+            }
+            fold(it->second, value);
+            local.folded++;
+        }
+
+        /// @brief Flushes every worker, then merges each partition on its own task and hands it to body(partition, table).
+        template<class Body>
+        void MergePartitions(Body&& body) {
+            std::vector<Local*> all;
+            locals.ForEach([&](Local& local) {
+                Flush(local);
+                local.partitioned = false;
+                all.push_back(&local);
+            });
+            ParallelFor(0, std::size_t(1) << radixBits, 1, [&](std::size_t partition, std::size_t) {
+                std::size_t size = 0;
+                for (Local* local : all) {
+                    size += local->partitions[partition].size();
+                }
+                Table merged;
+                merged.reserve(size);
+                for (Local* local : all) {
+                    std::vector<Group>& groups = local->partitions[partition];
+                    for (Group& group : groups) {
+                        auto [it, inserted] = merged.try_emplace(std::move(group.first), std::move(group.second));
+                        if (!inserted) {
+                            merge(it->second, group.second);
+                        }
+                    }
+                    std::vector<Group>().swap(groups);
+                }
+                body(partition, merged);
+            });
+        }
+    public:
+        GroupBy(Acc initialValue, Fold foldFunction, Merge mergeFunction, const GroupByOptions& options = GroupByOptions(), Hash keyHash = Hash())
+            : initial(std::move(initialValue)), fold(std::move(foldFunction)), merge(std::move(mergeFunction)), hash(std::move(keyHash)) {
+            const std::size_t tableBytes = options.LocalTableBytes != 0 ? options.LocalTableBytes : Internal::L2CacheSize();
+            maxEntries = std::max<std::size_t>(16, tableBytes / EntryBytes);
+            radixBits = std::min(options.RadixBits, 16u);
+        }
+
+        GroupBy(const GroupBy&) = delete;
+        GroupBy& operator=(const GroupBy&) = delete;
+
+        void Push(const Key& key, const Value& value) {
+            Add(locals.Local(), key, value);
+        }
+
+        /// @brief Pushes length key/value pairs, one worker lookup for all of them.
+        void Push(const Key* keys, const Value* values, std::size_t length) {
+            Local& local = locals.Local();
+            for (std::size_t i = 0; i < length; i++) {
+                Add(local, keys[i], values[i]);
+            }
+        }
+
+        /**
+         * @brief Merges the partitions in parallel and calls emit(key, acc) once per group, on several workers at once.
+         * The aggregator is empty afterwards and can take new values.
+         */
+        template<class Emit>
+        void Finish(Emit&& emit) {
+            MergePartitions([&](std::size_t, Table& merged) {
+                for (auto& [key, acc] : merged) {
+                    emit(key, std::move(acc));
+                }
+            });
+        }
+
+        /// @brief Finish into a vector, grouped by partition.
+        std::vector<std::pair<Key, Acc>> Collect() {
+            std::vector<std::vector<std::pair<Key, Acc>>> parts(std::size_t(1) << radixBits);
+            MergePartitions([&](std::size_t partition, Table& merged) {
+                parts[partition].reserve(merged.size());
+                for (auto& [key, acc] : merged) {
+                    parts[partition].emplace_back(key, std::move(acc));
+                }
+            });
+            std::vector<std::pair<Key, Acc>> groups;
+            for (auto& part : parts) {
+                groups.insert(groups.end(), std::make_move_iterator(part.begin()), std::make_move_iterator(part.end()));
+            }
+            return groups;
+        }
+    };
+    ///@}
+}
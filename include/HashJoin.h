@@ -0,0 +1,521 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include "Parallel.h"
+#include "RecordBatch.h"
+#include "SpillFile.h"
+
+namespace StreamLine{
+    /** \addtogroup Stream
+     *  @{
+     */
+
+    struct HashJoinOptions{
+        /// @brief log2 of the partition count, pick it so a partition's table fits in the L2 cache.
+        unsigned int RadixBits = 8;
+        /// @brief Build rows kept in memory, past it whole partitions go to disk and are joined by FinishProbe.
+        std::size_t MemoryBudget = std::size_t(1) << 30;
+        /// @brief Rows per output batch.
+        std::size_t OutputRows = 1 << 16;
+        /// @brief Rows bound for spilled partitions are staged and written in blocks of this size.
+        std::size_t SpillBlockSize = 1 << 20;
+        /// @brief Where spill files go, empty for $TMPDIR or /tmp.
+        std::string TempDirectory;
+    };
+
+    /**
+     * @brief Inner equi-join of two RecordBatch streams on an integer key column, radix-partitioned and parallel.
+     *
+     * Build rows are routed to partitions by key hash, FinishBuild then builds every partition's hash table on its own
+     * task, each table small enough to stay cache-resident. Probe batches look rows up in the partition their key hashes
+     * to and produce batches holding the build columns followed by the probe columns.
+     *
+     * When the build side outgrows MemoryBudget, the largest partitions are spilled to disk (grace hash join):
+     * later build rows and probe rows of a spilled partition are written to its files, and FinishProbe joins the
+     * spilled partitions one at a time once the probe side is done.
+     *
+     * Rows with a null key never match. Keys of different integer widths compare by value.
+     *
+     * Example usage:
+     * @code
+     * HashJoin join(users.GetSchema(), users.ColumnIndex("id"), orders.GetSchema(), orders.ColumnIndex("user"));
+     * for (const RecordBatch& batch : userBatches) {
+     *     join.Build(batch);
+     * }
+     * join.FinishBuild();
+     * auto joined = Stream::From(orderBatches)
+     *     | Stream::Parallel(1)
+     *     | Stream::FlatMap([&](const RecordBatch& batch) { return join.Probe(batch); })
+     *     | Stream::Collect();
+     * join.FinishProbe([&](RecordBatch&& batch) { joined.push_back(std::move(batch)); });
+     * @endcode
+     *
+     * @note Build may run on several threads at once, then Probe may; FinishBuild and FinishProbe run alone.
+     */
+    class HashJoin{
+    private:
+        static constexpr std::uint32_t Empty = 0xFFFFFFFF;
+        //An encoded row: the key, a bitmap of null columns, then the values.
+        static constexpr std::size_t HeaderBytes = 16;
+
+        struct Layout{
+            Schema schema;
+            std::size_t key;
+            std::vector<std::size_t> offsets;
+            std::size_t width = HeaderBytes;
+        };
+
+        struct alignas(64) Partition{
+            std::mutex mtx;
+            std::vector<std::byte> rows;
+            bool spilled = false;
+            IO::Internal::SpillFile buildFile;
+            IO::Internal::SpillFile probeFile;
+            std::vector<std::byte> buildStaging;
+            std::vector<std::byte> probeStaging;
+            //Chained table over rows, filled by FinishBuild.
+            std::vector<std::uint32_t> buckets;
+            std::vector<std::uint32_t> next;
+        };
+
+        /// @brief Output batch being filled by one probing thread.
+        template<class Sink>
+        struct Output{
+            const Schema& schema;
+            std::size_t capacity;
+            Sink& sink;
+            std::optional<RecordBatch> batch;
+            std::size_t rows = 0;
+
+            Output(const Schema& schema, std::size_t capacity, Sink& sink) : schema(schema), capacity(capacity), sink(sink) {}
+
+            RecordBatch& Current() {
+                if (!batch) {
+                    batch.emplace(schema, capacity);
+                    rows = 0;
+                }
+                return *batch;
+            }
+
+            void Commit() {
+                if (++rows == capacity) {
+                    Flush();
+                }
+            }
+
+            void Flush() {
+                if (batch && rows > 0) {
+                    batch->Resize(rows);
+                    sink(std::move(*batch));
+                }
+                batch.reset();
+            }
+        };
+
+        HashJoinOptions options;
+        Layout build;
+        Layout probe;
+        Schema output;
+        std::unique_ptr<Partition[]> partitions;
+        std::size_t partitionCount;
+        std::atomic<std::size_t> memory{ 0 };
+        std::mutex spillMtx;
+        bool built = false;
+
+        static Layout MakeLayout(Schema schema, std::size_t key) {
+            if (key >= schema.size()) {
+                throw std::out_of_range("HashJoin key column out of range");
+            }
+            const ColumnType type = schema[key].Type;
+            if (type == ColumnType::Float32 || type == ColumnType::Float64) {
+                throw std::invalid_argument("HashJoin keys must be integer columns");
+            }
+            if (schema.size() > 64) {
+                throw std::invalid_argument("HashJoin supports at most 64 columns per side");
+            }
+            Layout layout{ std::move(schema), key, {}, HeaderBytes };
+            for (const Field& field : layout.schema) {
+                layout.offsets.push_back(layout.width);
+                layout.width += ColumnTypeSize(field.Type);
+            }
+            return layout;
+        }
+
+        static void CheckSchema(const RecordBatch& batch, const Layout& layout) {
+            const Schema& schema = batch.GetSchema();
+            bool same = schema.size() == layout.schema.size();
+            for (std::size_t i = 0; same && i < schema.size(); i++) {
+                same = schema[i].Type == layout.schema[i].Type;
+            }
+            if (!same) {
+                throw std::invalid_argument("HashJoin batch schema mismatch");
+            }
+        }
+
+        static inline std::uint64_t Mix(std::uint64_t x) noexcept {
+            x ^= x >> 33;
+            x *= 0xff51afd7ed558ccdull;
+            x ^= x >> 33;
+            x *= 0xc4ceb9fe1a85ec53ull;
+            x ^= x >> 33;
+            return x;
+        }
+
+        /// @brief The key of row as a 64-bit value, false when null.
+        static bool KeyOf(const Column& column, std::size_t row, std::uint64_t& key) noexcept {
+            if (!column.IsValid(row)) {
+                return false;
+            }
+            const void* data = column.RawData();
+            switch (column.Type()) {
+            case ColumnType::Int32:
+                key = static_cast<std::uint64_t>(static_cast<std::int64_t>(static_cast<const std::int32_t*>(data)[row]));
+                break;
+            case ColumnType::UInt32:
+                key = static_cast<const std::uint32_t*>(data)[row];
+                break;
+            default:
+                key = static_cast<const std::uint64_t*>(data)[row];
+                break;
+            }
+            return true;
+        }
+
+        static inline std::uint64_t LoadKey(const std::byte* row) noexcept {
+            std::uint64_t key;
+            std::memcpy(&key, row, sizeof(key));
+            return key;
+        }
+
+        inline std::size_t PartitionOf(std::uint64_t hash) const noexcept {
+            return options.RadixBits == 0 ? 0 : static_cast<std::size_t>(hash >> (64 - options.RadixBits));
+        }
+
+        static void Encode(const RecordBatch& batch, std::size_t row, std::uint64_t key, const Layout& layout, std::byte* out) noexcept {
+            std::uint64_t nulls = 0;
+            for (std::size_t c = 0; c < layout.schema.size(); c++) {
+                const Column& column = batch.GetColumn(c);
+                const std::size_t size = ColumnTypeSize(column.Type());
+                nulls |= static_cast<std::uint64_t>(!column.IsValid(row)) << c;
+                std::memcpy(out + layout.offsets[c], static_cast<const std::byte*>(column.RawData()) + row * size, size);
+            }
+            std::memcpy(out, &key, sizeof(key));
+            std::memcpy(out + 8, &nulls, sizeof(nulls));
+        }
+
+        /// @brief Writes an encoded row to columns [first, first + layout columns) of out's row.
+        static void Decode(const std::byte* encoded, const Layout& layout, RecordBatch& out, std::size_t row, std::size_t first) {
+            std::uint64_t nulls;
+            std::memcpy(&nulls, encoded + 8, sizeof(nulls));
+            for (std::size_t c = 0; c < layout.schema.size(); c++) {
+                Column& column = out.GetColumn(first + c);
+                const std::size_t size = ColumnTypeSize(column.Type());
+                std::memcpy(static_cast<std::byte*>(column.RawData()) + row * size, encoded + layout.offsets[c], size);
+                if ((nulls >> c) & 1) {
+                    column.SetNull(row);
+                }
+            }
+        }
+
+        static void CopyRow(const RecordBatch& batch, std::size_t source, RecordBatch& out, std::size_t row, std::size_t first) {
+            for (std::size_t c = 0; c < batch.ColumnCount(); c++) {
+                const Column& from = batch.GetColumn(c);
+                Column& column = out.GetColumn(first + c);
+                const std::size_t size = ColumnTypeSize(column.Type());
+                std::memcpy(static_cast<std::byte*>(column.RawData()) + row * size, static_cast<const std::byte*>(from.RawData()) + source * size, size);
+                if (!from.IsValid(source)) {
+                    column.SetNull(row);
+                }
+            }
+        }
+
+        void Stage(IO::Internal::SpillFile& file, std::vector<std::byte>& staging, bool flush) {
+            if (!staging.empty() && (flush || staging.size() >= options.SpillBlockSize)) {
+                if (!file.IsOpen()) {
+                    file = IO::Internal::SpillFile(options.TempDirectory);
+                }
+                file.Append(staging.data(), staging.size());
+                staging.clear();
+            }
+        }
+
+        /// @brief Spills the largest partitions still in memory until the build side fits the budget again.
+        void Shrink() {
+            std::lock_guard<std::mutex> spillLock(spillMtx);
+            while (memory.load(std::memory_order_relaxed) > options.MemoryBudget) {
+                std::size_t largest = partitionCount;
+                std::size_t largestBytes = 0;
+                for (std::size_t i = 0; i < partitionCount; i++) {
+                    std::lock_guard<std::mutex> lock(partitions[i].mtx);
+                    if (!partitions[i].spilled && partitions[i].rows.size() > largestBytes) {
+                        largest = i;
+                        largestBytes = partitions[i].rows.size();
+                    }
+                }
+                if (largest == partitionCount) {
+                    return;
+                }
+                Partition& p = partitions[largest];
+                std::lock_guard<std::mutex> lock(p.mtx);
+                p.spilled = true;
+                p.buildStaging = std::move(p.rows);
+                p.rows = {};
+                memory.fetch_sub(p.buildStaging.size(), std::memory_order_relaxed);
+                Stage(p.buildFile, p.buildStaging, true);
+                //Clearing keeps the rows' whole capacity, staging only ever needs a block.
+                std::vector<std::byte>().swap(p.buildStaging);
+            }
+        }
+
+        /// @brief Gathers the selected non-null rows of batch ordered by partition, returns the partition offsets.
+        std::vector<std::size_t> Route(const RecordBatch& batch, std::size_t keyColumn, std::vector<std::uint32_t>& rows, std::vector<std::uint64_t>& keys) const {
+            const Column& column = batch.GetColumn(keyColumn);
+            std::vector<std::uint32_t> found;
+            std::vector<std::uint64_t> foundKeys;
+            std::vector<std::size_t> offsets(partitionCount + 1, 0);
+            found.reserve(batch.ActiveRows());
+            foundKeys.reserve(batch.ActiveRows());
+            batch.ForEachRow([&](std::size_t row) {
+                std::uint64_t key;
+                if (KeyOf(column, row, key)) {
+                    found.push_back(static_cast<std::uint32_t>(row));
+                    foundKeys.push_back(key);
+                    offsets[PartitionOf(Mix(key)) + 1]++;
+                }
+            });
+            for (std::size_t i = 0; i < partitionCount; i++) {
+                offsets[i + 1] += offsets[i];
+            }
+            rows.resize(found.size());
+            keys.resize(found.size());
+            std::vector<std::size_t> next(offsets.begin(), offsets.end() - 1);
+            for (std::size_t i = 0; i < found.size(); i++) {
+                const std::size_t slot = next[PartitionOf(Mix(foundKeys[i]))]++;
+                rows[slot] = found[i];
+                keys[slot] = foundKeys[i];
+            }
+            return offsets;
+        }
+
+        static void BuildTable(Partition& p, std::size_t width) {
+            const std::size_t count = p.rows.size() / width;
+            if (count >= Empty) {
+                throw std::length_error("HashJoin partition too large, raise RadixBits");
+            }
+            const std::size_t size = std::bit_ceil(std::max<std::size_t>(1, count));
+            p.buckets.assign(size, Empty);
+            p.next.resize(count);
+            for (std::size_t i = 0; i < count; i++) {
+                const std::size_t bucket = Mix(LoadKey(p.rows.data() + i * width)) & (size - 1);
+                p.next[i] = p.buckets[bucket];
+                p.buckets[bucket] = static_cast<std::uint32_t>(i);
+            }
+        }
+
+        /// @brief Calls match(build row) for every build row of p holding key.
+        template<class Match>
+        void Lookup(const Partition& p, std::uint64_t key, std::uint64_t hash, Match&& match) const {
+            if (p.buckets.empty()) {
+                return;
+            }
+            for (std::uint32_t i = p.buckets[hash & (p.buckets.size() - 1)]; i != Empty; i = p.next[i]) {
+                const std::byte* row = p.rows.data() + i * build.width;
+                if (LoadKey(row) == key) {
+                    match(row);
+                }
+            }
+        }
+    public:
+        /// @throws std::invalid_argument for a non-integer key, std::out_of_range for a key index past the schema.
+        HashJoin(Schema buildSchema, std::size_t buildKey, Schema probeSchema, std::size_t probeKey, const HashJoinOptions& joinOptions = HashJoinOptions())
+            : options(joinOptions), build(MakeLayout(std::move(buildSchema), buildKey)), probe(MakeLayout(std::move(probeSchema), probeKey)) {
+            options.RadixBits = std::min(options.RadixBits, 16u);
+            options.OutputRows = std::max<std::size_t>(1, options.OutputRows);
+            output = build.schema;
+            output.insert(output.end(), probe.schema.begin(), probe.schema.end());
+            partitionCount = std::size_t(1) << options.RadixBits;
+            partitions = std::make_unique<Partition[]>(partitionCount);
+        }
+
+        HashJoin(const HashJoin&) = delete;
+        HashJoin& operator=(const HashJoin&) = delete;
+
+        /// @brief Build columns then probe columns.
+        inline const Schema& GetOutputSchema() const noexcept {
+            return output;
+        }
+
+        /**
+         * @brief Adds the selected rows of batch to the build side.
+         * @throws std::invalid_argument if the batch doesn't have the build schema, std::system_error if a spill fails.
+         */
+        void Build(const RecordBatch& batch) {
+            if (built) {
+                throw std::logic_error("HashJoin built to after FinishBuild");
+            }
+            CheckSchema(batch, build);
+            std::vector<std::uint32_t> rows;
+            std::vector<std::uint64_t> keys;
+            const std::vector<std::size_t> offsets = Route(batch, build.key, rows, keys);
+            for (std::size_t i = 0; i < partitionCount; i++) {
+                const std::size_t count = offsets[i + 1] - offsets[i];
+                if (count == 0) {
+                    continue;
+                }
+                Partition& p = partitions[i];
+                std::lock_guard<std::mutex> lock(p.mtx);
+                std::vector<std::byte>& target = p.spilled ? p.buildStaging : p.rows;
+                const std::size_t at = target.size();
+                target.resize(at + count * build.width);
+                for (std::size_t r = 0; r < count; r++) {
+                    Encode(batch, rows[offsets[i] + r], keys[offsets[i] + r], build, target.data() + at + r * build.width);
+                }
+                if (p.spilled) {
+                    Stage(p.buildFile, p.buildStaging, false);
+                }
+                else {
+                    memory.fetch_add(count * build.width, std::memory_order_relaxed);
+                }
+            }
+            if (memory.load(std::memory_order_relaxed) > options.MemoryBudget) {
+                Shrink();
+            }
+        }
+
+        /// @brief Ends the build side and builds the in-memory partitions' tables in parallel.
+        void FinishBuild() {
+            ParallelFor(0, partitionCount, 1, [&](std::size_t i, std::size_t) {
+                Partition& p = partitions[i];
+                if (p.spilled) {
+                    Stage(p.buildFile, p.buildStaging, true);
+                    std::vector<std::byte>().swap(p.buildStaging);
+                }
+                else {
+                    BuildTable(p, build.width);
+                }
+            });
+            built = true;
+        }
+
+        /**
+         * @brief Joins the selected rows of batch, handing full output batches to sink(RecordBatch&&) on this thread.
+         * Rows bound for spilled partitions are set aside for FinishProbe.
+         */
+        template<class Sink>
+        void Probe(const RecordBatch& batch, Sink&& sink) {
+            if (!built) {
+                throw std::logic_error("HashJoin probed before FinishBuild");
+            }
+            CheckSchema(batch, probe);
+            std::vector<std::uint32_t> rows;
+            std::vector<std::uint64_t> keys;
+            const std::vector<std::size_t> offsets = Route(batch, probe.key, rows, keys);
+            Output<Sink> out{ output, options.OutputRows, sink };
+            for (std::size_t i = 0; i < partitionCount; i++) {
+                const std::size_t count = offsets[i + 1] - offsets[i];
+                if (count == 0) {
+                    continue;
+                }
+                Partition& p = partitions[i];
+                if (p.spilled) {
+                    std::lock_guard<std::mutex> lock(p.mtx);
+                    const std::size_t at = p.probeStaging.size();
+                    p.probeStaging.resize(at + count * probe.width);
+                    for (std::size_t r = 0; r < count; r++) {
+                        Encode(batch, rows[offsets[i] + r], keys[offsets[i] + r], probe, p.probeStaging.data() + at + r * probe.width);
+                    }
+                    Stage(p.probeFile, p.probeStaging, false);
+                    continue;
+                }
+                for (std::size_t r = offsets[i]; r < offsets[i + 1]; r++) {
+                    Lookup(p, keys[r], Mix(keys[r]), [&](const std::byte* match) {
+                        RecordBatch& current = out.Current();
+                        Decode(match, build, current, out.rows, 0);
+                        CopyRow(batch, rows[r], current, out.rows, build.schema.size());
+                        out.Commit();
+                    });
+                }
+            }
+            out.Flush();
+        }
+
+        /// @brief Probe into a vector of batches, for Stream::FlatMap.
+        std::vector<RecordBatch> Probe(const RecordBatch& batch) {
+            std::vector<RecordBatch> batches;
+            Probe(batch, [&](RecordBatch&& joined) { batches.push_back(std::move(joined)); });
+            return batches;
+        }
+
+        /**
+         * @brief Joins the spilled partitions once every Probe returned. A partition at a time is loaded and its
+         * probe rows are joined in parallel, sink may run on several workers at once.
+         * @throws std::system_error if reading a spill file fails.
+         */
+        template<class Sink>
+        void FinishProbe(Sink&& sink) {
+            for (std::size_t i = 0; i < partitionCount; i++) {
+                Partition& p = partitions[i];
+                if (!p.spilled) {
+                    continue;
+                }
+                Stage(p.probeFile, p.probeStaging, true);
+                std::vector<std::byte>().swap(p.probeStaging);
+                if (!p.probeFile.IsOpen() || !p.buildFile.IsOpen()) {
+                    continue;
+                }
+                p.rows.resize(static_cast<std::size_t>(p.buildFile.Size()));
+                if (const int error = p.buildFile.ReadAt(p.rows.data(), p.rows.size(), 0); error != 0) {
+                    throw std::system_error(error, std::generic_category(), "HashJoin read");
+                }
+                BuildTable(p, build.width);
+                const std::size_t blockRows = std::max<std::size_t>(1, options.SpillBlockSize / probe.width);
+                const std::size_t probeRows = static_cast<std::size_t>(p.probeFile.Size() / probe.width);
+                ParallelFor(0, probeRows, blockRows, [&](std::size_t first, std::size_t last) {
+                    std::vector<std::byte> block((last - first) * probe.width);
+                    if (const int error = p.probeFile.ReadAt(block.data(), block.size(), first * probe.width); error != 0) {
+                        throw std::system_error(error, std::generic_category(), "HashJoin read");
+                    }
+                    Output<Sink> out{ output, options.OutputRows, sink };
+                    for (std::size_t r = 0; r < last - first; r++) {
+                        const std::byte* row = block.data() + r * probe.width;
+                        const std::uint64_t key = LoadKey(row);
+                        Lookup(p, key, Mix(key), [&](const std::byte* match) {
+                            RecordBatch& current = out.Current();
+                            Decode(match, build, current, out.rows, 0);
+                            Decode(row, probe, current, out.rows, build.schema.size());
+                            out.Commit();
+                        });
+                    }
+                    out.Flush();
+                });
+                std::vector<std::byte>().swap(p.rows);
+                std::vector<std::uint32_t>().swap(p.buckets);
+                std::vector<std::uint32_t>().swap(p.next);
+            }
+        }
+
+        /// @brief Partitions spilled to disk. Informational only.
+        std::size_t GetSpilledPartitions() {
+            std::size_t spilled = 0;
+            for (std::size_t i = 0; i < partitionCount; i++) {
+                std::lock_guard<std::mutex> lock(partitions[i].mtx);
+                spilled += partitions[i].spilled;
+            }
+            return spilled;
+        }
+    };
+    ///@}
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include "RecordBatch.h"
+
+namespace StreamLine::Kernels{
+    /** \addtogroup Stream
+     *  @{
+     */
+
+    enum class CompareOp : unsigned int{
+        Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual
+    };
+
+    enum class SimdLevel : unsigned int{
+        Scalar, SSE42, AVX2, AVX512
+    };
+
+    /**
+     * @brief Instruction set the kernels run with.
+     *
+     * Picked once at startup from cpuid, the environment variable STREAMLINE_SIMD (scalar, sse4.2, avx2, avx512)
+     * can lower it. Kernels called during static initialization may still run the scalar versions.
+     */
+    SimdLevel GetSimdLevel() noexcept;
+
+    template<class T>
+    using SumType = std::conditional_t<std::is_integral_v<T>, std::conditional_t<std::is_signed_v<T>, std::int64_t, std::uint64_t>, double>;
+
+    /*
+     * The kernels work on int32, int64, uint32, uint64, float and double columns and are plain functions over [values, values + count),
+     * so a ParallelFor body can run them over its chunk:
+     *
+     *     ParallelFor(0, n, 1 << 16, [&](std::size_t first, std::size_t last) {
+     *         counts[first >> 16] = Kernels::Select(column + first, last - first, Kernels::CompareOp::Less, limit, out + first, first);
+     *     });
+     *
+     * NaN compares unequal to everything; Min and Max of columns holding NaN are unspecified.
+     */
+
+    /**
+     * @brief Writes base + i for every i where values[i] op value holds, returns how many.
+     * @param out Room for count indices.
+     */
+    template<class T>
+    std::size_t Select(const T* values, std::size_t count, CompareOp op, T value, std::uint32_t* out, std::uint32_t base = 0) noexcept;
+
+    /**
+     * @brief Keeps the indices of selection whose value satisfies op, returns how many. out may be selection itself.
+     */
+    template<class T>
+    std::size_t Refine(const T* values, const std::uint32_t* selection, std::size_t count, CompareOp op, T value, std::uint32_t* out) noexcept;
+
+    /// @brief out[i] = values[selection[i]].
+    template<class T>
+    void Gather(const T* values, const std::uint32_t* selection, std::size_t count, T* out) noexcept;
+
+    /// @brief Integers are summed in 64 bits (unsigned ones wrapping like uint64) and floats in double, the rounding of float sums depends on the SIMD level.
+    template<class T>
+    SumType<T> Sum(const T* values, std::size_t count) noexcept;
+
+    /// @brief The largest T for an empty column.
+    template<class T>
+    T Min(const T* values, std::size_t count) noexcept;
+
+    /// @brief The lowest T for an empty column.
+    template<class T>
+    T Max(const T* values, std::size_t count) noexcept;
+
+    /// @brief 64-bit hash of every value's bits, equal values hash equally on every SIMD level.
+    template<class T>
+    void Hash(const T* values, std::size_t count, std::uint64_t* out) noexcept;
+
+#define STREAMLINE_KERNELS_EXTERN(T) \
+    extern template std::size_t Select<T>(const T*, std::size_t, CompareOp, T, std::uint32_t*, std::uint32_t) noexcept; \
+    extern template std::size_t Refine<T>(const T*, const std::uint32_t*, std::size_t, CompareOp, T, std::uint32_t*) noexcept; \
+    extern template void Gather<T>(const T*, const std::uint32_t*, std::size_t, T*) noexcept; \
+    extern template SumType<T> Sum<T>(const T*, std::size_t) noexcept; \
+    extern template T Min<T>(const T*, std::size_t) noexcept; \
+    extern template T Max<T>(const T*, std::size_t) noexcept; \
+    extern template void Hash<T>(const T*, std::size_t, std::uint64_t*) noexcept;
+    STREAMLINE_KERNELS_EXTERN(std::int32_t)
+    STREAMLINE_KERNELS_EXTERN(std::int64_t)
+    STREAMLINE_KERNELS_EXTERN(std::uint32_t)
+    STREAMLINE_KERNELS_EXTERN(std::uint64_t)
+    STREAMLINE_KERNELS_EXTERN(float)
+    STREAMLINE_KERNELS_EXTERN(double)
+#undef STREAMLINE_KERNELS_EXTERN
+
+    /**
+     * @brief Narrows batch's selection to the valid rows where column op value holds.
+     */
+    template<class T>
+    void SelectWhere(RecordBatch& batch, std::size_t column, CompareOp op, T value) {
+        const Column& source = batch.GetColumn(column);
+        const T* values = source.Data<T>();
+        std::uint32_t* out = batch.SelectionBuffer();
+        std::size_t count = batch.HasSelection()
+            ? Refine(values, batch.Selection(), batch.ActiveRows(), op, value, out)
+            : Select(values, batch.Size(), op, value, out);
+        if (source.Validity() != nullptr) {
+            std::size_t kept = 0;
+            for (std::size_t i = 0; i < count; i++) {
+                out[kept] = out[i];
+                kept += source.IsValid(out[i]);
+            }
+            count = kept;
+        }
+        batch.SetSelection(out, count);
+    }
+    ///@}
+}
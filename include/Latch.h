@@ -4,6 +4,7 @@
 #include <condition_variable>
 #include <mutex>
 #include <thread>
+#include "Fiber.h"
 
 namespace StreamLine::Locks
 {
@@ -17,6 +18,7 @@ namespace StreamLine::Locks
         std::atomic<bool> ready{false};
         std::mutex mtx;
         std::condition_variable cv;
+        FiberWaitList fiberWaiters; // Parked fibers, guarded by mtx
         std::atomic<unsigned int> spinCount{100}; // Default value
     public:
         inline HybridLatch& SetSpinCount(unsigned int count) noexcept {
@@ -29,11 +31,18 @@ namespace StreamLine::Locks
             // Spin phase
             for (unsigned int i = 0; i < currentSpinCount; ++i) {
                 if (ready.load(std::memory_order_acquire)) return;
-                std::this_thread::yield(); // Give CPU to other threads
+                Fiber::Yield(); // Give CPU to other threads (or fibers)
             }
 
             // Fallback to CV
             std::unique_lock<std::mutex> lock(mtx);
+            if (Fiber::Current() != nullptr) {
+                // Park the fiber instead of the worker running it.
+                while (!ready.load(std::memory_order_acquire)) {
+                    fiberWaiters.Park(lock);
+                }
+                return;
+            }
             cv.wait(lock, [&]()noexcept { return ready.load(std::memory_order_acquire); });
         }
 
@@ -41,6 +50,7 @@ namespace StreamLine::Locks
             std::lock_guard<std::mutex> lock(mtx);
             ready.store(true, std::memory_order_release);
             cv.notify_all(); // Only wakes if someone already in the cv wait
+            fiberWaiters.WakeAll();
         }
 
         inline bool PeekReady() const noexcept {
@@ -54,7 +64,7 @@ namespace StreamLine::Locks
     public:
         void Wait() noexcept {
             while (!ready.load(std::memory_order_acquire)) {
-                std::this_thread::yield(); // Let scheduler threads run
+                Fiber::Yield(); // Let scheduler threads (or fibers) run
             }
         }
 
@@ -72,11 +82,19 @@ namespace StreamLine::Locks
     private:
         std::mutex mtx;
         std::condition_variable cv;
+        FiberWaitList fiberWaiters; // Parked fibers, guarded by mtx
         std::atomic<bool> ready = false;
 
     public:
         void Wait() noexcept {
             std::unique_lock<std::mutex> lock(mtx);
+            if (Fiber::Current() != nullptr) {
+                // Park the fiber instead of the worker running it.
+                while (!ready.load(std::memory_order_acquire)) {
+                    fiberWaiters.Park(lock);
+                }
+                return;
+            }
             cv.wait(lock, [&] { return ready.load(std::memory_order_acquire); });
         }
 
@@ -84,6 +102,7 @@ namespace StreamLine::Locks
             std::lock_guard<std::mutex> lock(mtx);
             ready.store(true, std::memory_order_release);
             cv.notify_all();
+            fiberWaiters.WakeAll();
         }
 
         inline bool PeekReady() const noexcept {
@@ -0,0 +1,175 @@
+#pragma once
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include "Parallel.h"
+#include "Exception.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define STREAMLINE_MMAP_SUPPORTED 1
+#else
+#define STREAMLINE_MMAP_SUPPORTED 0
+#endif
+
+namespace StreamLine::IO{
+    /** \addtogroup IO
+     *  @{
+     */
+
+    struct MappedFileOptions{
+        /// @brief Hint sequential access (MADV_SEQUENTIAL), the kernel reads ahead aggressively and drops pages behind.
+        bool Sequential = true;
+        /// @brief Fault the whole file in up front (MAP_POPULATE where available), trading startup time for no page faults while parsing.
+        bool Populate = false;
+    };
+
+    /**
+     * @brief A read-only memory mapping of a whole file.
+     */
+    class MappedFile{
+    private:
+        const char* data = nullptr;
+        std::size_t size = 0;
+    public:
+        /// @throws std::system_error if the file can't be opened or mapped.
+        explicit MappedFile(const std::string& path, const MappedFileOptions& options = MappedFileOptions()) {
+#if STREAMLINE_MMAP_SUPPORTED
+            const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                throw std::system_error(errno, std::generic_category(), "open " + path);
+            }
+            struct stat info{};
+            if (fstat(fd, &info) != 0) {
+                const int error = errno;
+                close(fd);
+                throw std::system_error(error, std::generic_category(), "stat " + path);
+            }
+            size = static_cast<std::size_t>(info.st_size);
+            if (size == 0) {
+                //mmap rejects empty mappings.
+                close(fd);
+                return;
+            }
+            int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+            if (options.Populate) {
+                flags |= MAP_POPULATE;
+            }
+#endif
+            void* mapping = mmap(nullptr, size, PROT_READ, flags, fd, 0);
+            const int error = errno;
+            //The mapping keeps the file referenced.
+            close(fd);
+            if (mapping == MAP_FAILED) {
+                throw std::system_error(error, std::generic_category(), "mmap " + path);
+            }
+            if (options.Sequential) {
+                madvise(mapping, size, MADV_SEQUENTIAL);
+            }
+            data = static_cast<const char*>(mapping);
+#else
+            (void)path;
+            (void)options;
+            throw InvalidOperation();
+#endif
+        }
+
+        ~MappedFile() {
+#if STREAMLINE_MMAP_SUPPORTED
+            if (data != nullptr) {
+                munmap(const_cast<char*>(data), size);
+            }
+#endif
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile(MappedFile&& other) noexcept
+            : data(std::exchange(other.data, nullptr)), size(std::exchange(other.size, 0)) {}
+        MappedFile& operator=(MappedFile&& other) noexcept {
+            std::swap(data, other.data);
+            std::swap(size, other.size);
+            return *this;
+        }
+
+        inline std::string_view View() const noexcept {
+            return std::string_view(data, size);
+        }
+
+        inline std::size_t Size() const noexcept {
+            return size;
+        }
+    };
+
+    /**
+     * @brief First pipeline stage for large inputs: maps a file and hands record-aligned chunks of it to the ThreadPool.
+     *
+     * Chunks are views into the mapping, nothing is copied before the user's parser.
+     * Every chunk but the last ends right after a delimiter, so no record straddles two chunks.
+     *
+     * Example usage:
+     * @code
+     * IO::MappedFileSource source("events.log");
+     * source.ForEachChunk([&](std::string_view chunk, std::size_t index) {
+     *     //Parse the lines of chunk.
+     * });
+     * @endcode
+     */
+    class MappedFileSource{
+    private:
+        MappedFile file;
+    public:
+        explicit MappedFileSource(const std::string& path, const MappedFileOptions& options = MappedFileOptions())
+            : file(path, options) {}
+
+        inline std::string_view View() const noexcept {
+            return file.View();
+        }
+
+        /**
+         * @brief Splits the file in chunks of about chunkSize bytes, each extended to the end of its last record.
+         */
+        std::vector<std::string_view> Split(std::size_t chunkSize, std::string_view delimiter = "\n") const {
+            std::vector<std::string_view> chunks;
+            const std::string_view view = file.View();
+            chunkSize = std::max<std::size_t>(1, chunkSize);
+            std::size_t start = 0;
+            while (start < view.size()) {
+                std::size_t end = view.size();
+                if (view.size() - start > chunkSize && !delimiter.empty()) {
+                    const std::size_t found = view.find(delimiter, start + chunkSize - 1);
+                    if (found != std::string_view::npos) {
+                        end = found + delimiter.size();
+                    }
+                }
+                chunks.push_back(view.substr(start, end - start));
+                start = end;
+            }
+            return chunks;
+        }
+
+        /**
+         * @brief Runs parser(chunk, index) over every chunk in parallel, returns once all of them were parsed.
+         *
+         * The first exception thrown by parser is rethrown once the chunks in flight are done.
+         */
+        template<class Parser>
+        void ForEachChunk(Parser&& parser, std::size_t chunkSize = 4 * 1024 * 1024, std::string_view delimiter = "\n") const {
+            const std::vector<std::string_view> chunks = Split(chunkSize, delimiter);
+            ParallelFor(0, chunks.size(), 1, [&](std::size_t first, std::size_t last) {
+                for (std::size_t i = first; i < last; i++) {
+                    parser(chunks[i], i);
+                }
+            });
+        }
+    };
+    ///@}
+}
@@ -0,0 +1,334 @@
+#pragma once
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "Fiber.h"
+#include "BlockingPool.h"
+#include "Exception.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define STREAMLINE_ORDERED_SINK_SUPPORTED 1
+#else
+#define STREAMLINE_ORDERED_SINK_SUPPORTED 0
+#endif
+
+namespace StreamLine::IO{
+    /** \addtogroup IO
+     *  @{
+     */
+
+    struct OrderedSinkOptions{
+        /// @brief Sequence numbers accepted ahead of the next one to be written, Push blocks past it.
+        std::size_t Window = 1024;
+        /// @brief Buffers gathered into a single writev.
+        std::size_t MaxBatch = 64;
+        /// @brief Open with O_DIRECT (where available), output is staged through an aligned buffer of StagingSize bytes.
+        bool Direct = false;
+        std::size_t StagingSize = 1 << 20;
+        /// @brief Drain on the BlockingPool instead of on the pushing worker, worth it for slow (O_DIRECT, network) files.
+        bool OffloadWrites = false;
+        bool Truncate = true;
+    };
+
+    /**
+     * @brief Writes buffers in sequence order whichever worker produced them.
+     *
+     * Buffers pushed out of order wait in a bounded reorder window. The push that completes the head of the window
+     * drains every contiguous buffer with batched writevs, outside the lock, while other workers keep pushing.
+     *
+     * @note Push blocks (or parks a fiber) while its sequence number is Window or more ahead of the next one to be written.
+     * Keep the window larger than the sequence numbers in flight so the producer of the next buffer is never stuck behind it.
+     */
+    class OrderedSink{
+    private:
+        static constexpr std::size_t DirectAlignment = 4096;
+
+        OrderedSinkOptions options;
+        int fd = -1;
+        std::mutex mtx;
+        std::condition_variable cv;
+        FiberWaitList fiberWaiters;
+        std::vector<std::optional<std::string>> slots;
+        std::uint64_t next = 0;
+        std::size_t parked = 0;
+        bool writing = false;
+        int error = 0;
+
+        //Only touched by the drain, which runs one at a time.
+        char* staging = nullptr;
+        std::size_t staged = 0;
+        std::uint64_t offset = 0;
+
+        void WakeAll() {
+            fiberWaiters.WakeAll();
+            cv.notify_all();
+        }
+
+        template<class Predicate>
+        void WaitUntil(std::unique_lock<std::mutex>& lock, Predicate predicate) {
+            if (Fiber::Current() != nullptr) {
+                while (!predicate()) {
+                    fiberWaiters.Park(lock);
+                }
+                return;
+            }
+            cv.wait(lock, predicate);
+        }
+
+        void ThrowIfFailed() const {
+            if (error != 0) {
+                throw std::system_error(error, std::generic_category(), "OrderedSink write");
+            }
+        }
+
+#if STREAMLINE_ORDERED_SINK_SUPPORTED
+        /// @brief Writes every byte of iov, returns 0 or errno.
+        static int WriteAll(int file, iovec* iov, int count) noexcept {
+            while (count > 0) {
+                const ssize_t written = writev(file, iov, count);
+                if (written < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return errno;
+                }
+                std::size_t left = static_cast<std::size_t>(written);
+                while (count > 0 && left >= iov->iov_len) {
+                    left -= iov->iov_len;
+                    iov++;
+                    count--;
+                }
+                if (count > 0) {
+                    iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+                    iov->iov_len -= left;
+                }
+            }
+            return 0;
+        }
+
+        int WriteStaging(std::size_t length) noexcept {
+            std::size_t done = 0;
+            while (done < length) {
+                const ssize_t written = pwrite(fd, staging + done, length - done, static_cast<off_t>(offset + done));
+                if (written < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return errno;
+                }
+                done += static_cast<std::size_t>(written);
+            }
+            offset += length;
+            return 0;
+        }
+
+        int WriteBatch(std::vector<std::string>& batch) noexcept {
+            if (staging == nullptr) {
+                std::vector<iovec> iov;
+                iov.reserve(batch.size());
+                for (std::string& buffer : batch) {
+                    if (!buffer.empty()) {
+                        iov.push_back(iovec{ buffer.data(), buffer.size() });
+                    }
+                }
+                return WriteAll(fd, iov.data(), static_cast<int>(iov.size()));
+            }
+            //O_DIRECT wants aligned memory, sizes and offsets: copy through staging, keep the unaligned tail for later.
+            for (const std::string& buffer : batch) {
+                std::size_t consumed = 0;
+                while (consumed < buffer.size()) {
+                    const std::size_t take = std::min(buffer.size() - consumed, options.StagingSize - staged);
+                    std::memcpy(staging + staged, buffer.data() + consumed, take);
+                    staged += take;
+                    consumed += take;
+                    if (staged == options.StagingSize) {
+                        if (int result = WriteStaging(staged)) {
+                            return result;
+                        }
+                        staged = 0;
+                    }
+                }
+            }
+            const std::size_t aligned = staged - staged % DirectAlignment;
+            if (aligned != 0) {
+                if (int result = WriteStaging(aligned)) {
+                    return result;
+                }
+                std::memmove(staging, staging + aligned, staged - aligned);
+                staged -= aligned;
+            }
+            return 0;
+        }
+
+        /// @brief Writes the unaligned O_DIRECT tail with O_DIRECT cleared.
+        int FlushStaging() noexcept {
+            if (staging == nullptr || staged == 0) {
+                return 0;
+            }
+            const int flags = fcntl(fd, F_GETFL);
+#ifdef O_DIRECT
+            fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+#endif
+            const int result = WriteStaging(staged);
+            fcntl(fd, F_SETFL, flags);
+            staged = 0;
+            return result;
+        }
+#endif
+
+        /// @brief Writes out the head of the window for as long as it is contiguous, lock held on entry and exit.
+        void Drain(std::unique_lock<std::mutex>& lock) {
+#if STREAMLINE_ORDERED_SINK_SUPPORTED
+            std::vector<std::string> batch;
+            while (error == 0 && slots[next % slots.size()].has_value()) {
+                batch.clear();
+                while (batch.size() < options.MaxBatch && slots[next % slots.size()].has_value()) {
+                    auto& slot = slots[next % slots.size()];
+                    batch.push_back(std::move(*slot));
+                    slot.reset();
+                    next++;
+                    parked--;
+                }
+                //The window moved, blocked producers may go on while this batch is written.
+                WakeAll();
+                lock.unlock();
+                const int result = WriteBatch(batch);
+                lock.lock();
+                if (result != 0) {
+                    error = result;
+                }
+            }
+#endif
+            writing = false;
+            WakeAll();
+        }
+    public:
+        /// @throws std::system_error if the file can't be opened.
+        explicit OrderedSink(const std::string& path, const OrderedSinkOptions& sinkOptions = OrderedSinkOptions())
+            : options(sinkOptions), slots(std::max<std::size_t>(1, sinkOptions.Window)) {
+#if STREAMLINE_ORDERED_SINK_SUPPORTED
+            options.MaxBatch = std::clamp<std::size_t>(options.MaxBatch, 1, 1024);
+            int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (options.Truncate ? O_TRUNC : O_APPEND);
+#ifdef O_DIRECT
+            if (options.Direct) {
+                flags |= O_DIRECT;
+            }
+#endif
+            fd = open(path.c_str(), flags, 0644);
+            if (fd < 0) {
+                throw std::system_error(errno, std::generic_category(), "open " + path);
+            }
+            if (options.Direct) {
+                options.StagingSize = std::max(DirectAlignment, options.StagingSize - options.StagingSize % DirectAlignment);
+                staging = static_cast<char*>(std::aligned_alloc(DirectAlignment, options.StagingSize));
+                if (staging == nullptr) {
+                    close(fd);
+                    throw std::bad_alloc();
+                }
+                offset = options.Truncate ? 0 : static_cast<std::uint64_t>(lseek(fd, 0, SEEK_END));
+            }
+#else
+            (void)path;
+            throw InvalidOperation();
+#endif
+        }
+
+        ~OrderedSink() {
+            try {
+                Close();
+            }
+            catch (...) {
+                //Destructors don't throw, call Close to see write errors.
+            }
+        }
+
+        OrderedSink(const OrderedSink&) = delete;
+        OrderedSink& operator=(const OrderedSink&) = delete;
+
+        /**
+         * @brief Hands over the buffer for sequence number sequence, numbering starts at 0.
+         *
+         * @throws std::invalid_argument if the sequence number was already pushed.
+         * @throws std::system_error if an earlier write failed.
+         * @throws InvalidOperation once the sink is closed, including while waiting for room in the window.
+         */
+        void Push(std::uint64_t sequence, std::string buffer) {
+            std::unique_lock<std::mutex> lock(mtx);
+            WaitUntil(lock, [&]() { return error != 0 || fd < 0 || sequence < next + slots.size(); });
+            if (fd < 0) {
+                throw InvalidOperation();
+            }
+            ThrowIfFailed();
+            auto& slot = slots[sequence % slots.size()];
+            if (sequence < next || slot.has_value()) {
+                throw std::invalid_argument("OrderedSink sequence number pushed twice");
+            }
+            slot.emplace(std::move(buffer));
+            parked++;
+            if (writing || sequence != next) {
+                return;
+            }
+            //This push completed the head of the window, so it drains it.
+            writing = true;
+            if (options.OffloadWrites) {
+                BlockingPool::Submit([this]() {
+                    std::unique_lock<std::mutex> drainLock(mtx);
+                    Drain(drainLock);
+                });
+                return;
+            }
+            Drain(lock);
+            ThrowIfFailed();
+        }
+
+        /**
+         * @brief Waits for the pending writes and closes the file.
+         *
+         * @throws std::runtime_error if buffers are stuck behind a sequence number that was never pushed.
+         * @throws std::system_error if a write failed.
+         */
+        void Close() {
+            std::unique_lock<std::mutex> lock(mtx);
+            WaitUntil(lock, [&]() { return !writing; });
+            if (fd < 0) {
+                return;
+            }
+#if STREAMLINE_ORDERED_SINK_SUPPORTED
+            if (error == 0) {
+                error = FlushStaging();
+            }
+            close(fd);
+#endif
+            fd = -1;
+            std::free(staging);
+            staging = nullptr;
+            const bool gap = parked != 0;
+            WakeAll();
+            ThrowIfFailed();
+            if (gap) {
+                throw std::runtime_error("OrderedSink closed with a gap in the sequence numbers");
+            }
+        }
+
+        /// @brief Sequence number the sink is waiting for. Informational only.
+        std::uint64_t GetNextSequence() {
+            std::lock_guard<std::mutex> lock(mtx);
+            return next;
+        }
+    };
+    ///@}
+}
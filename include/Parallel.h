@@ -0,0 +1,479 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <source_location>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "ThreadPool.h"
+#include "Latch.h"
+
+namespace StreamLine{
+    /** \addtogroup Parallel
+     *  @{
+     */
+
+    /**
+     * @brief Runs body(first, last) over [begin, end) split in chunks of at most grain, on the ThreadPool.
+     *
+     * The calling thread takes chunks too, and returns once every chunk ran.
+     * Helpers that start after the chunks ran out just exit, so the caller never waits on queued work.
+     * The first exception thrown by body is rethrown, chunks not started yet are skipped.
+     *
+     * @param grain Chunk size, 0 picks one giving each worker a few chunks.
+     */
+    template<class Body>
+    void ParallelFor(std::size_t begin, std::size_t end, std::size_t grain, Body&& body) {
+        if (end <= begin) {
+            return;
+        }
+        const std::size_t count = end - begin;
+        const std::size_t workers = ThreadPool::IsRunning() ? ThreadPool::GetThreadCount() : 0;
+        if (grain == 0) {
+            grain = std::max<std::size_t>(1, count / (8 * (workers + 1)));
+        }
+        const std::size_t chunks = (count + grain - 1) / grain;
+        if (chunks == 1 || workers == 0) {
+            body(begin, end);
+            return;
+        }
+
+        struct State{
+            std::atomic<std::size_t> next{ 0 };
+            std::atomic<std::size_t> completed{ 0 };
+            std::atomic<bool> failed{ false };
+            std::exception_ptr error;
+            Locks::HybridLatch done;
+        };
+        //Shared with the helpers, a helper may only get to run after the call returned.
+        auto state = std::make_shared<State>();
+        auto* bodyPtr = &body;
+        //Only ever touched while a chunk is held, the caller is still waiting then.
+        auto work = [state, bodyPtr, begin, end, grain, chunks]() {
+            std::size_t chunk;
+            while ((chunk = state->next.fetch_add(1, std::memory_order_relaxed)) < chunks) {
+                if (!state->failed.load(std::memory_order_relaxed)) {
+                    const std::size_t first = begin + chunk * grain;
+                    try {
+                        (*bodyPtr)(first, std::min(end, first + grain));
+                    }
+                    catch (...) {
+                        if (!state->failed.exchange(true)) {
+                            state->error = std::current_exception();
+                        }
+                    }
+                }
+                if (state->completed.fetch_add(1, std::memory_order_acq_rel) + 1 == chunks) {
+                    state->done.Signal();
+                }
+            }
+        };
+        const std::size_t helpers = std::min(workers, chunks - 1);
+        for (std::size_t i = 0; i < helpers; i++) {
+            ThreadPool::Submit(work);
+        }
+        work();
+        state->done.Wait();
+        if (state->error) {
+            std::rethrow_exception(state->error);
+        }
+    }
+    /**
+     * @brief Remembers which worker ran each chunk of a ParallelFor, so that the next ParallelFor over the same range
+     * and grain hands every chunk back to that worker, whose cache may still hold its data.
+     *
+     * Keep one per loop, alive across the iterations of the algorithm. Chunks are posted to their worker's mailbox.
+     * A worker done with its own chunks takes the others', and the record follows whoever ran them. A caller outside
+     * the pool runs the unowned chunks, and a worker's only if that worker hasn't got to them within a millisecond,
+     * without taking them over.
+     *
+     * Example usage:
+     * @code
+     * AffinityPartitioner affinity;
+     * for (int step = 0; step < steps; step++) {
+     *     ParallelFor(1, n - 1, 4096, [&](std::size_t first, std::size_t last) { Relax(grid, first, last); }, affinity);
+     * }
+     * @endcode
+     */
+    class AffinityPartitioner{
+    private:
+        template<class Body>
+        friend void ParallelFor(std::size_t begin, std::size_t end, std::size_t grain, Body&& body, AffinityPartitioner& partitioner);
+
+        std::size_t begin = 0;
+        std::size_t end = 0;
+        std::size_t grain = 0;
+        //Worker that last ran each chunk, -1 for the caller or unknown.
+        std::vector<int> owners;
+    public:
+        /// @brief Forgets the recorded assignment.
+        void Reset() noexcept {
+            owners.clear();
+        }
+    };
+
+    /**
+     * @brief ParallelFor replaying the chunk to worker assignment recorded by partitioner, and recording the new one.
+     */
+    template<class Body>
+    void ParallelFor(std::size_t begin, std::size_t end, std::size_t grain, Body&& body, AffinityPartitioner& partitioner) {
+        if (end <= begin) {
+            return;
+        }
+        const std::size_t count = end - begin;
+        const std::size_t workers = ThreadPool::IsRunning() ? ThreadPool::GetThreadCount() : 0;
+        if (grain == 0) {
+            grain = std::max<std::size_t>(1, count / (8 * (workers + 1)));
+        }
+        const std::size_t chunks = (count + grain - 1) / grain;
+        if (chunks == 1 || workers == 0) {
+            body(begin, end);
+            return;
+        }
+        if (partitioner.owners.size() != chunks || partitioner.begin != begin || partitioner.end != end || partitioner.grain != grain) {
+            partitioner.owners.assign(chunks, -1);
+            partitioner.begin = begin;
+            partitioner.end = end;
+            partitioner.grain = grain;
+        }
+
+        struct alignas(64) List{
+            std::vector<std::size_t> chunks;
+            std::atomic<std::size_t> next{ 0 };
+            //Set once the owner got to its list.
+            std::atomic<bool> started{ false };
+        };
+        struct State{
+            //One list per worker, the last one for chunks without an owner.
+            std::unique_ptr<List[]> lists;
+            std::atomic<std::size_t> completed{ 0 };
+            std::atomic<bool> failed{ false };
+            std::exception_ptr error;
+            Locks::HybridLatch done;
+        };
+        auto state = std::make_shared<State>();
+        state->lists = std::make_unique<List[]>(workers + 1);
+        for (std::size_t chunk = 0; chunk < chunks; chunk++) {
+            const int owner = partitioner.owners[chunk];
+            const std::size_t list = owner >= 0 && static_cast<std::size_t>(owner) < workers ? static_cast<std::size_t>(owner) : workers;
+            state->lists[list].chunks.push_back(chunk);
+        }
+        auto* bodyPtr = &body;
+        int* owners = partitioner.owners.data();
+        //Only ever touches body and owners while a chunk is held, the caller is still waiting then.
+        auto drain = [state, bodyPtr, owners, begin, end, grain, chunks](List& list, int self) {
+            std::size_t slot;
+            while ((slot = list.next.fetch_add(1, std::memory_order_relaxed)) < list.chunks.size()) {
+                const std::size_t chunk = list.chunks[slot];
+                if (!state->failed.load(std::memory_order_relaxed)) {
+                    const std::size_t first = begin + chunk * grain;
+                    try {
+                        (*bodyPtr)(first, std::min(end, first + grain));
+                    }
+                    catch (...) {
+                        if (!state->failed.exchange(true)) {
+                            state->error = std::current_exception();
+                        }
+                    }
+                }
+                //The caller outside the pool only stands in, the chunk stays with its last worker.
+                if (self >= 0) {
+                    owners[chunk] = self;
+                }
+                if (state->completed.fetch_add(1, std::memory_order_acq_rel) + 1 == chunks) {
+                    state->done.Signal();
+                }
+            }
+        };
+        auto work = [state, drain, workers]() {
+            const int self = ThreadPool::GetWorkerIndex();
+            const std::size_t own = self >= 0 && static_cast<std::size_t>(self) < workers ? static_cast<std::size_t>(self) : workers;
+            state->lists[own].started.store(true, std::memory_order_relaxed);
+            //Own chunks first, then the others'.
+            for (std::size_t i = 0; i <= workers; i++) {
+                drain(state->lists[(own + i) % (workers + 1)], self);
+            }
+        };
+        std::size_t posted = 0;
+        for (std::size_t w = 0; w < workers; w++) {
+            if (!state->lists[w].chunks.empty()) {
+                ThreadPool::SubmitTo(static_cast<unsigned int>(w), work);
+                posted++;
+            }
+        }
+        //Unowned chunks (all of them on the first run) are shared like a plain ParallelFor's.
+        const std::size_t unowned = state->lists[workers].chunks.size();
+        const std::size_t helpers = std::min(workers - posted, unowned > 0 ? unowned - 1 : 0);
+        for (std::size_t i = 0; i < helpers; i++) {
+            ThreadPool::Submit(work);
+        }
+        if (ThreadPool::IsWorkerThread()) {
+            work();
+        }
+        else {
+            //Outside the pool, the workers' lists are left to them unless one doesn't get to its list in time.
+            drain(state->lists[workers], -1);
+            constexpr std::chrono::milliseconds StealAfter{ 1 };
+            const auto stealAt = std::chrono::steady_clock::now() + StealAfter;
+            auto unstarted = [&]() {
+                for (std::size_t w = 0; w < workers; w++) {
+                    if (!state->lists[w].started.load(std::memory_order_relaxed) && state->lists[w].next.load(std::memory_order_relaxed) < state->lists[w].chunks.size()) {
+                        return true;
+                    }
+                }
+                return false;
+            };
+            while (!state->done.PeekReady() && unstarted() && std::chrono::steady_clock::now() < stealAt) {
+                std::this_thread::yield();
+            }
+            for (std::size_t w = 0; w < workers; w++) {
+                if (!state->lists[w].started.load(std::memory_order_relaxed)) {
+                    drain(state->lists[w], -1);
+                }
+            }
+        }
+        state->done.Wait();
+        if (state->error) {
+            std::rethrow_exception(state->error);
+        }
+    }
+    /**
+     * @brief Picks ParallelFor grain sizes from the measured cost of an iteration, so that scheduling a chunk
+     * costs at most a target fraction of running it.
+     *
+     * The first call times a few growing chunks on the caller before going parallel. Every call times its chunks and
+     * folds the per-iteration cost into a moving average, so later calls follow a body whose cost drifts.
+     * Ranges cheaper than one chunk run inline. Keep one per loop, or let the call site overload keep one per call site.
+     *
+     * Example usage:
+     * @code
+     * ParallelFor(0, rows, [&](std::size_t first, std::size_t last) { Score(table, first, last); });
+     * @endcode
+     */
+    class AutoPartitioner{
+    private:
+        template<class Body>
+        friend void ParallelFor(std::size_t begin, std::size_t end, Body&& body, AutoPartitioner& partitioner);
+
+        //Nanoseconds per iteration, 0 until measured.
+        std::atomic<double> cost{ 0.0 };
+        double chunkNanos;
+
+        std::size_t Grain(std::size_t count, std::size_t workers) const noexcept {
+            const double perIteration = cost.load(std::memory_order_relaxed);
+            std::size_t grain = static_cast<std::size_t>(chunkNanos / perIteration);
+            //Never fewer chunks than it takes to keep every thread busy and even out.
+            grain = std::min(grain, count / (4 * (workers + 1)));
+            return std::max<std::size_t>(1, grain);
+        }
+
+        void Record(double nanos, std::size_t iterations) noexcept {
+            const double sample = nanos / static_cast<double>(iterations);
+            const double previous = cost.load(std::memory_order_relaxed);
+            cost.store(previous == 0.0 ? sample : previous * 0.75 + sample * 0.25, std::memory_order_relaxed);
+        }
+    public:
+        /**
+         * @param targetOverhead Scheduling cost allowed per chunk, as a fraction of the chunk's run time.
+         * @param taskOverhead What scheduling a chunk costs.
+         */
+        explicit AutoPartitioner(double targetOverhead = 0.01, std::chrono::nanoseconds taskOverhead = std::chrono::microseconds(2))
+            : chunkNanos(static_cast<double>(taskOverhead.count()) / std::max(targetOverhead, 1e-6)) {}
+
+        AutoPartitioner(const AutoPartitioner&) = delete;
+        AutoPartitioner& operator=(const AutoPartitioner&) = delete;
+
+        /// @brief Measured nanoseconds per iteration, 0 before the first call.
+        double GetIterationCost() const noexcept {
+            return cost.load(std::memory_order_relaxed);
+        }
+
+        /// @brief Forgets the measured cost.
+        void Reset() noexcept {
+            cost.store(0.0, std::memory_order_relaxed);
+        }
+    };
+
+    /**
+     * @brief ParallelFor with grain sizes picked by partitioner from the measured iteration cost.
+     */
+    template<class Body>
+    void ParallelFor(std::size_t begin, std::size_t end, Body&& body, AutoPartitioner& partitioner) {
+        using Clock = std::chrono::steady_clock;
+        //Shorter samples mostly measure the clock.
+        constexpr double MinSampleNanos = 20000.0;
+        if (end <= begin) {
+            return;
+        }
+        if (partitioner.GetIterationCost() == 0.0) {
+            //Time doubling chunks on the caller until one is long enough to measure.
+            std::size_t size = 1;
+            while (begin < end) {
+                const std::size_t last = std::min(end, begin + size);
+                const auto start = Clock::now();
+                body(begin, last);
+                const double nanos = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+                begin = last;
+                if (nanos >= MinSampleNanos || begin == end) {
+                    partitioner.Record(std::max(nanos, 1.0), size);
+                    break;
+                }
+                size *= 2;
+            }
+            if (begin == end) {
+                return;
+            }
+        }
+        const std::size_t count = end - begin;
+        const std::size_t workers = ThreadPool::IsRunning() ? ThreadPool::GetThreadCount() : 0;
+        if (workers == 0 || static_cast<double>(count) * partitioner.GetIterationCost() < partitioner.chunkNanos) {
+            body(begin, end);
+            return;
+        }
+        std::atomic<std::uint64_t> nanos{ 0 };
+        ParallelFor(begin, end, partitioner.Grain(count, workers), [&](std::size_t first, std::size_t last) {
+            const auto start = Clock::now();
+            body(first, last);
+            nanos.fetch_add(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()), std::memory_order_relaxed);
+        });
+        partitioner.Record(std::max<double>(static_cast<double>(nanos.load(std::memory_order_relaxed)), 1.0), count);
+    }
+
+    namespace Internal{
+        inline AutoPartitioner& CallSitePartitioner(const std::source_location& site) {
+            static std::mutex mtx;
+            static std::map<std::tuple<const char*, std::uint_least32_t, std::uint_least32_t>, std::unique_ptr<AutoPartitioner>> partitioners;
+            std::lock_guard<std::mutex> lock(mtx);
+            std::unique_ptr<AutoPartitioner>& partitioner = partitioners[{ site.file_name(), site.line(), site.column() }];
+            if (!partitioner) {
+                partitioner = std::make_unique<AutoPartitioner>();
+            }
+            return *partitioner;
+        }
+    }
+
+    /**
+     * @brief ParallelFor with grain sizes learned per call site, see AutoPartitioner.
+     */
+    template<class Body>
+    void ParallelFor(std::size_t begin, std::size_t end, Body&& body, const std::source_location& site = std::source_location::current()) {
+        ParallelFor(begin, end, std::forward<Body>(body), Internal::CallSitePartitioner(site));
+    }
+    namespace Internal{
+        /// @brief A function of a ParallelInvoke, on the caller's stack.
+        struct InvokeFrame{
+            void (*call)(void*) = nullptr;
+            void* function = nullptr;
+            std::exception_ptr error;
+            std::atomic<bool> done{ false };
+
+            void Run() noexcept {
+                try {
+                    call(function);
+                }
+                catch (...) {
+                    error = std::current_exception();
+                }
+            }
+        };
+
+        //Small and trivially copyable, so std::function stores it inline.
+        struct InvokeThunk{
+            InvokeFrame* frame;
+
+            void operator()() const noexcept {
+                frame->Run();
+                //The frame may be gone right after this store.
+                frame->done.store(true, std::memory_order_release);
+            }
+
+            bool operator==(const InvokeThunk&) const = default;
+        };
+    }
+
+    /**
+     * @brief Runs every function, in parallel when workers are hungry, and returns once all of them returned.
+     *
+     * All but the last are queued (on the caller's mailbox when it is a worker) while the last runs inline.
+     * The caller then takes back those nobody started and runs them itself, and runs other queued work while waiting
+     * on the ones that were stolen. Nothing is allocated: the frames live on the caller's stack and the queued
+     * function objects fit std::function's inline storage. When the pool is saturated everything simply runs inline.
+     * The first exception, in argument order, is rethrown once all of them are done.
+     *
+     * Example usage:
+     * @code
+     * void Sum(const Node* node, long& total) {
+     *     long left = 0, right = 0;
+     *     if (node->left) ParallelInvoke([&] { Sum(node->left, left); }, [&] { Sum(node->right, right); });
+     *     total = node->value + left + right;
+     * }
+     * @endcode
+     */
+    template<class... F>
+    void ParallelInvoke(F&&... functions) {
+        constexpr std::size_t Count = sizeof...(F);
+        if constexpr (Count <= 1) {
+            (functions(), ...);
+        }
+        else {
+            if (!ThreadPool::IsHungry()) {
+                (functions(), ...);
+                return;
+            }
+            std::tuple<F&...> refs(functions...);
+            Internal::InvokeFrame frames[Count - 1];
+            [&]<std::size_t... I>(std::index_sequence<I...>) {
+                ((frames[I].function = const_cast<void*>(static_cast<const void*>(std::addressof(std::get<I>(refs))))), ...);
+                ((frames[I].call = [](void* f) { (*static_cast<std::remove_reference_t<std::tuple_element_t<I, std::tuple<F...>>>*>(f))(); }), ...);
+            }(std::make_index_sequence<Count - 1>());
+
+            const int self = ThreadPool::GetWorkerIndex();
+            for (auto& frame : frames) {
+                if (self >= 0) {
+                    ThreadPool::SubmitTo(static_cast<unsigned int>(self), Internal::InvokeThunk{ &frame });
+                }
+                else {
+                    ThreadPool::Submit(Internal::InvokeThunk{ &frame });
+                }
+            }
+            std::exception_ptr lastError;
+            try {
+                std::get<Count - 1>(refs)();
+            }
+            catch (...) {
+                lastError = std::current_exception();
+            }
+            //Most recently queued first, it is the likeliest to still be there.
+            for (std::size_t i = Count - 1; i-- > 0;) {
+                Internal::InvokeFrame& frame = frames[i];
+                if (ThreadPool::Retract(Internal::InvokeThunk{ &frame })) {
+                    frame.Run();
+                    continue;
+                }
+                while (!frame.done.load(std::memory_order_acquire)) {
+                    if (ThreadPool::RunPending(1) == 0) {
+                        std::this_thread::yield();
+                    }
+                }
+            }
+            for (auto& frame : frames) {
+                if (frame.error) {
+                    std::rethrow_exception(frame.error);
+                }
+            }
+            if (lastError) {
+                std::rethrow_exception(lastError);
+            }
+        }
+    }
+    ///@}
+}
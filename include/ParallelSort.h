@@ -0,0 +1,451 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "Parallel.h"
+#include "ThreadPool.h"
+
+namespace StreamLine{
+    /** \addtogroup Parallel
+     *  @{
+     */
+
+    /**
+     * @brief Scratch memory reused by the parallel sorts, one per calling thread.
+     *
+     * Sorts of trivially copyable elements take their scratch from the calling thread's buffer, which is kept
+     * between calls up to MaxRetained bytes. Bigger requests, and sorts nested on a thread already sorting (a fiber
+     * parked mid-sort), get a temporary buffer. Other element types use a temporary array of default-constructed T.
+     */
+    class SortScratch{
+    private:
+        static constexpr std::size_t Alignment = 64;
+
+        struct Free{
+            void operator()(std::byte* p) const noexcept {
+                ::operator delete[](p, std::align_val_t(Alignment));
+            }
+        };
+
+        std::unique_ptr<std::byte[], Free> memory;
+        std::size_t capacity = 0;
+        //Only the owning thread sets it, but a fiber that moved threads mid-sort clears it from wherever it finished.
+        std::atomic<bool> inUse{ false };
+
+        static std::unique_ptr<std::byte[], Free> Allocate(std::size_t bytes) {
+            return std::unique_ptr<std::byte[], Free>(static_cast<std::byte*>(::operator new[](bytes, std::align_val_t(Alignment))));
+        }
+
+        template<class T>
+        friend class SortBuffer;
+    public:
+        /// @brief Bytes a thread keeps between sorts, 256 MiB.
+        static constexpr std::size_t MaxRetained = std::size_t(256) << 20;
+
+        static SortScratch& Local() noexcept {
+            thread_local SortScratch scratch;
+            return scratch;
+        }
+
+        std::size_t Capacity() const noexcept {
+            return capacity;
+        }
+
+        /// @brief Frees the buffer, unless a sort is using it.
+        void Release() noexcept {
+            if (!inUse.load(std::memory_order_acquire)) {
+                memory.reset();
+                capacity = 0;
+            }
+        }
+    };
+
+    /**
+     * @brief count elements of scratch for one sort, see SortScratch.
+     */
+    template<class T>
+    class SortBuffer{
+    private:
+        std::unique_ptr<std::byte[], SortScratch::Free> temporary;
+        std::unique_ptr<T[]> objects;
+        SortScratch* borrowed = nullptr;
+        T* data = nullptr;
+    public:
+        explicit SortBuffer(std::size_t count) {
+            if constexpr (std::is_trivially_copyable_v<T>) {
+                const std::size_t bytes = std::max<std::size_t>(1, count * sizeof(T));
+                SortScratch& scratch = SortScratch::Local();
+                if (bytes <= SortScratch::MaxRetained && !scratch.inUse.exchange(true, std::memory_order_acquire)) {
+                    if (scratch.capacity < bytes) {
+                        scratch.memory.reset();
+                        try {
+                            scratch.memory = SortScratch::Allocate(bytes);
+                        }
+                        catch (...) {
+                            scratch.capacity = 0;
+                            scratch.inUse.store(false, std::memory_order_release);
+                            throw;
+                        }
+                        scratch.capacity = bytes;
+                    }
+                    borrowed = &scratch;
+                    data = reinterpret_cast<T*>(scratch.memory.get());
+                }
+                else {
+                    temporary = SortScratch::Allocate(bytes);
+                    data = reinterpret_cast<T*>(temporary.get());
+                }
+            }
+            else {
+                static_assert(std::is_default_constructible_v<T>, "Sorted types must be trivially copyable or default constructible");
+                objects = std::make_unique<T[]>(count);
+                data = objects.get();
+            }
+        }
+
+        ~SortBuffer() {
+            if (borrowed != nullptr) {
+                borrowed->inUse.store(false, std::memory_order_release);
+            }
+        }
+
+        SortBuffer(const SortBuffer&) = delete;
+        SortBuffer& operator=(const SortBuffer&) = delete;
+
+        inline T* Data() const noexcept {
+            return data;
+        }
+    };
+
+    namespace Internal{
+        /// @brief Below this many elements the sorts run on the calling thread.
+        constexpr std::size_t ParallelSortCutoff = 1 << 16;
+
+        inline std::size_t SortWorkers() noexcept {
+            return ThreadPool::IsRunning() ? ThreadPool::GetThreadCount() : 0;
+        }
+
+        template<class T>
+        void ParallelMove(T* from, T* to, std::size_t count) {
+            ParallelFor(0, count, 1 << 16, [&](std::size_t first, std::size_t last) {
+                std::move(from + first, from + last, to + first);
+            });
+        }
+
+        /// @brief Left elements that come first among the first k outputs of a stable merge of left and right.
+        template<class T, class Compare>
+        std::size_t MergePath(const T* left, std::size_t leftCount, const T* right, std::size_t rightCount, std::size_t k, Compare& comp) {
+            std::size_t low = k > rightCount ? k - rightCount : 0;
+            std::size_t high = std::min(k, leftCount);
+            while (low < high) {
+                const std::size_t mid = low + (high - low) / 2;
+                //Ties go to the left, left[mid] comes before right[k - mid - 1] unless strictly greater.
+                if (!comp(right[k - mid - 1], left[mid])) {
+                    low = mid + 1;
+                }
+                else {
+                    high = mid;
+                }
+            }
+            return low;
+        }
+
+        /// @brief Stable merge moving out of both ranges, comp sees lvalues as with std::sort.
+        template<class T, class Compare>
+        T* MoveMerge(T* left, T* leftEnd, T* right, T* rightEnd, T* out, Compare& comp) {
+            while (left != leftEnd && right != rightEnd) {
+                if (comp(*right, *left)) {
+                    *out++ = std::move(*right++);
+                }
+                else {
+                    *out++ = std::move(*left++);
+                }
+            }
+            out = std::move(left, leftEnd, out);
+            return std::move(right, rightEnd, out);
+        }
+
+        /// @brief Stable sort of data using scratch, the result ends up in data.
+        template<class T, class Compare>
+        void SerialMergeSort(T* data, T* scratch, std::size_t count, Compare& comp) {
+            constexpr std::size_t Run = 32;
+            for (std::size_t first = 0; first < count; first += Run) {
+                T* begin = data + first;
+                T* end = data + std::min(count, first + Run);
+                for (T* i = begin + 1; i < end; ++i) {
+                    T value = std::move(*i);
+                    T* j = i;
+                    for (; j > begin && comp(value, *(j - 1)); --j) {
+                        *j = std::move(*(j - 1));
+                    }
+                    *j = std::move(value);
+                }
+            }
+            T* from = data;
+            T* to = scratch;
+            for (std::size_t width = Run; width < count; width *= 2) {
+                for (std::size_t first = 0; first < count; first += 2 * width) {
+                    const std::size_t mid = std::min(count, first + width);
+                    const std::size_t last = std::min(count, first + 2 * width);
+                    MoveMerge(from + first, from + mid, from + mid, from + last, to + first, comp);
+                }
+                std::swap(from, to);
+            }
+            if (from != data) {
+                std::move(from, from + count, data);
+            }
+        }
+
+        template<class It>
+        using SortValue = typename std::iterator_traits<It>::value_type;
+    }
+
+    /**
+     * @brief Unstable parallel sort (sample sort) of [first, last).
+     *
+     * A sample picks splitters, workers scatter the elements to their buckets in scratch,
+     * then sort the buckets independently. Keys equal to a splitter get a bucket of their own that needs
+     * no sorting, so heavy duplicates don't serialize the sort.
+     */
+    template<std::contiguous_iterator It, class Compare = std::less<>>
+    void ParallelSort(It first, It last, Compare comp = Compare()) {
+        using T = Internal::SortValue<It>;
+        const std::size_t count = static_cast<std::size_t>(last - first);
+        const std::size_t workers = Internal::SortWorkers();
+        if (count < Internal::ParallelSortCutoff || workers == 0) {
+            std::sort(first, last, comp);
+            return;
+        }
+        T* data = std::to_address(first);
+
+        //Splitters from an evenly spread sample.
+        const std::size_t bucketTarget = std::min<std::size_t>(1024, 4 * (workers + 1));
+        constexpr std::size_t Oversampling = 16;
+        std::vector<T> splitters;
+        {
+            std::vector<T> sample;
+            const std::size_t sampleSize = bucketTarget * Oversampling;
+            sample.reserve(sampleSize);
+            std::uint64_t state = 0x9E3779B97F4A7C15ull ^ count;
+            for (std::size_t i = 0; i < sampleSize; i++) {
+                state = state * 6364136223846793005ull + 1442695040888963407ull;
+                sample.push_back(data[(state >> 17) % count]);
+            }
+            std::sort(sample.begin(), sample.end(), comp);
+            for (std::size_t i = Oversampling; i < sampleSize; i += Oversampling) {
+                if (splitters.empty() || comp(splitters.back(), sample[i])) {
+                    splitters.push_back(sample[i]);
+                }
+            }
+        }
+        //Bucket 2i holds keys below splitter i (and above splitter i - 1), bucket 2i + 1 keys equal to splitter i.
+        const std::size_t buckets = 2 * splitters.size() + 1;
+        auto bucketOf = [&](const T& value) {
+            const std::size_t i = static_cast<std::size_t>(std::lower_bound(splitters.begin(), splitters.end(), value, comp) - splitters.begin());
+            return 2 * i + static_cast<std::size_t>(i < splitters.size() && !comp(value, splitters[i]));
+        };
+
+        const std::size_t blocks = std::min<std::size_t>(4 * (workers + 1), count / 4096);
+        const std::size_t blockSize = (count + blocks - 1) / blocks;
+        std::vector<std::size_t> offsets(blocks * buckets, 0);
+        ParallelFor(0, blocks, 1, [&](std::size_t block, std::size_t) {
+            std::size_t* counts = offsets.data() + block * buckets;
+            const std::size_t end = std::min(count, (block + 1) * blockSize);
+            for (std::size_t i = block * blockSize; i < end; i++) {
+                counts[bucketOf(data[i])]++;
+            }
+        });
+        std::vector<std::size_t> bucketStart(buckets + 1, 0);
+        std::size_t running = 0;
+        for (std::size_t b = 0; b < buckets; b++) {
+            bucketStart[b] = running;
+            for (std::size_t block = 0; block < blocks; block++) {
+                const std::size_t n = offsets[block * buckets + b];
+                offsets[block * buckets + b] = running;
+                running += n;
+            }
+        }
+        bucketStart[buckets] = count;
+
+        SortBuffer<T> buffer(count);
+        T* scratch = buffer.Data();
+        ParallelFor(0, blocks, 1, [&](std::size_t block, std::size_t) {
+            std::size_t* next = offsets.data() + block * buckets;
+            const std::size_t end = std::min(count, (block + 1) * blockSize);
+            for (std::size_t i = block * blockSize; i < end; i++) {
+                scratch[next[bucketOf(data[i])]++] = std::move(data[i]);
+            }
+        });
+        ParallelFor(0, buckets, 1, [&](std::size_t b, std::size_t) {
+            T* begin = scratch + bucketStart[b];
+            T* end = scratch + bucketStart[b + 1];
+            if (b % 2 == 0) {
+                std::sort(begin, end, comp);
+            }
+            std::move(begin, end, data + bucketStart[b]);
+        });
+    }
+
+    /**
+     * @brief Stable parallel sort (merge sort) of [first, last).
+     *
+     * Chunks are sorted in parallel, then merged pairwise level by level. Every merge is split along its merge path
+     * so the last levels, with fewer merges than workers, still use all of them.
+     */
+    template<std::contiguous_iterator It, class Compare = std::less<>>
+    void ParallelStableSort(It first, It last, Compare comp = Compare()) {
+        using T = Internal::SortValue<It>;
+        const std::size_t count = static_cast<std::size_t>(last - first);
+        const std::size_t workers = Internal::SortWorkers();
+        T* data = std::to_address(first);
+        SortBuffer<T> buffer(count);
+        T* scratch = buffer.Data();
+        if (count < Internal::ParallelSortCutoff || workers == 0) {
+            Internal::SerialMergeSort(data, scratch, count, comp);
+            return;
+        }
+
+        std::size_t chunks = 1;
+        while (chunks < 2 * (workers + 1) && count / (chunks * 2) >= 4096) {
+            chunks *= 2;
+        }
+        const std::size_t chunkSize = (count + chunks - 1) / chunks;
+        ParallelFor(0, chunks, 1, [&](std::size_t chunk, std::size_t) {
+            const std::size_t begin = std::min(count, chunk * chunkSize);
+            const std::size_t end = std::min(count, begin + chunkSize);
+            Internal::SerialMergeSort(data + begin, scratch + begin, end - begin, comp);
+        });
+
+        T* from = data;
+        T* to = scratch;
+        std::vector<std::size_t> splits;
+        for (std::size_t width = chunkSize; width < count; width *= 2) {
+            const std::size_t pairs = (count + 2 * width - 1) / (2 * width);
+            const std::size_t segments = std::max<std::size_t>(1, (4 * (workers + 1) + pairs - 1) / pairs);
+            auto bounds = [&](std::size_t pair) {
+                const std::size_t begin = pair * 2 * width;
+                const std::size_t mid = std::min(count, begin + width);
+                return std::pair<std::size_t, std::size_t>(mid - begin, std::min(count, begin + 2 * width) - mid);
+            };
+            //Every split is found before any segment moves elements out from under the others' binary searches.
+            splits.assign(pairs * (segments + 1), 0);
+            ParallelFor(0, pairs * (segments + 1), 64, [&](std::size_t firstSplit, std::size_t lastSplit) {
+                for (std::size_t index = firstSplit; index < lastSplit; index++) {
+                    const std::size_t pair = index / (segments + 1);
+                    const auto [leftCount, rightCount] = bounds(pair);
+                    const T* left = from + pair * 2 * width;
+                    const std::size_t outIndex = (leftCount + rightCount) * (index % (segments + 1)) / segments;
+                    splits[index] = Internal::MergePath(left, leftCount, left + leftCount, rightCount, outIndex, comp);
+                }
+            });
+            ParallelFor(0, pairs * segments, 1, [&](std::size_t task, std::size_t) {
+                const std::size_t pair = task / segments;
+                const std::size_t segment = task % segments;
+                const std::size_t begin = pair * 2 * width;
+                const auto [leftCount, rightCount] = bounds(pair);
+                T* left = from + begin;
+                T* right = left + leftCount;
+                const std::size_t total = leftCount + rightCount;
+                const std::size_t outFirst = total * segment / segments;
+                const std::size_t outLast = total * (segment + 1) / segments;
+                const std::size_t i0 = splits[pair * (segments + 1) + segment];
+                const std::size_t i1 = splits[pair * (segments + 1) + segment + 1];
+                Internal::MoveMerge(left + i0, left + i1, right + (outFirst - i0), right + (outLast - i1), to + begin + outFirst, comp);
+            });
+            std::swap(from, to);
+        }
+        if (from != data) {
+            Internal::ParallelMove(from, data, count);
+        }
+    }
+
+    /**
+     * @brief Stable parallel LSD radix sort of [first, last) by the integer key(element), 8 bits per pass.
+     *
+     * Workers histogram and scatter their own block of the input every pass.
+     * Passes over a digit all keys share are skipped.
+     */
+    template<std::contiguous_iterator It, class Key>
+    void ParallelRadixSort(It first, It last, Key key) {
+        using T = Internal::SortValue<It>;
+        using K = std::remove_cvref_t<std::invoke_result_t<Key&, const T&>>;
+        static_assert(std::is_integral_v<K>, "Radix sort keys must be integers");
+        using U = std::make_unsigned_t<K>;
+        constexpr unsigned Bits = sizeof(K) * 8;
+        constexpr std::size_t Radix = 256;
+
+        const std::size_t count = static_cast<std::size_t>(last - first);
+        if (count < 2) {
+            return;
+        }
+        const std::size_t workers = Internal::SortWorkers();
+        const std::size_t blocks = count < Internal::ParallelSortCutoff || workers == 0
+            ? 1 : std::min<std::size_t>(4 * (workers + 1), count / 4096);
+        const std::size_t blockSize = (count + blocks - 1) / blocks;
+
+        auto digit = [&](const T& value, unsigned shift) -> std::size_t {
+            U bits = static_cast<U>(key(value));
+            if constexpr (std::is_signed_v<K>) {
+                //Flipping the sign bit orders negative keys first.
+                bits ^= U(1) << (Bits - 1);
+            }
+            return static_cast<std::size_t>((bits >> shift) & (Radix - 1));
+        };
+
+        SortBuffer<T> buffer(count);
+        T* from = std::to_address(first);
+        T* to = buffer.Data();
+        std::vector<std::size_t> offsets(blocks * Radix);
+        for (unsigned shift = 0; shift < Bits; shift += 8) {
+            std::fill(offsets.begin(), offsets.end(), 0);
+            ParallelFor(0, blocks, 1, [&](std::size_t block, std::size_t) {
+                std::size_t* counts = offsets.data() + block * Radix;
+                const std::size_t end = std::min(count, (block + 1) * blockSize);
+                for (std::size_t i = block * blockSize; i < end; i++) {
+                    counts[digit(from[i], shift)]++;
+                }
+            });
+            std::size_t running = 0;
+            bool skip = false;
+            for (std::size_t d = 0; d < Radix; d++) {
+                std::size_t total = 0;
+                for (std::size_t block = 0; block < blocks; block++) {
+                    const std::size_t n = offsets[block * Radix + d];
+                    offsets[block * Radix + d] = running;
+                    running += n;
+                    total += n;
+                }
+                skip |= total == count;
+            }
+            if (skip) {
+                continue;
+            }
+            ParallelFor(0, blocks, 1, [&](std::size_t block, std::size_t) {
+                std::size_t* next = offsets.data() + block * Radix;
+                const std::size_t end = std::min(count, (block + 1) * blockSize);
+                for (std::size_t i = block * blockSize; i < end; i++) {
+                    to[next[digit(from[i], shift)]++] = std::move(from[i]);
+                }
+            });
+            std::swap(from, to);
+        }
+        if (from != std::to_address(first)) {
+            Internal::ParallelMove(from, std::to_address(first), count);
+        }
+    }
+
+    /// @brief ParallelRadixSort of integers by their own value.
+    template<std::contiguous_iterator It>
+    void ParallelRadixSort(It first, It last) {
+        ParallelRadixSort(first, last, [](const auto& value) { return value; });
+    }
+    ///@}
+}
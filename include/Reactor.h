@@ -0,0 +1,117 @@
+#pragma once
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include "ThreadPool.h"
+#include "Exception.h"
+
+namespace StreamLine::IO{
+    /** \addtogroup IO
+     *  @{
+     */
+
+    /// @brief Receives the operation's result: bytes transferred, the accepted fd, or -errno (-ETIME for an expired Timeout).
+    using Completion = std::function<void(int)>;
+
+    enum class ReactorBackend : unsigned int{
+        None, IoUring, Epoll
+    };
+
+    /**
+     * @brief Completes I/O without blocking workers, on io_uring where the kernel supports it and epoll otherwise.
+     *
+     * Once initialized the reactor is driven by the ThreadPool: one idle worker blocks in the reactor while the
+     * others sleep on the queue, and every worker reaps ready completions between tasks.
+     * Submissions are batched, io_uring entries queued by tasks are handed to the kernel together
+     * once the batch fills up or a worker runs out of work.
+     *
+     * Completions run on the thread that reaps them, usually a pool worker, keep them short or Submit the rest.
+     * Offsets below zero read or write at the current file position (required for pipes and sockets).
+     *
+     * @note The epoll backend waits for readiness, so its fds should be non-blocking.
+     * Regular files are always ready for epoll and are read or written inline.
+     */
+    class Reactor final{
+    public:
+        /**
+         * @brief Sets up the backend and hooks it into the ThreadPool's idle loop.
+         * Falls back to epoll when io_uring is unavailable or lacks the needed operations.
+         *
+         * @param entries Submission queue size, rounded up to a power of two by the kernel.
+         */
+        static ReactorBackend Initialize(ReactorBackend preferred = ReactorBackend::IoUring, unsigned int entries = 256);
+
+        /**
+         * @brief Detaches from the ThreadPool and closes the backend, operations still in flight are released without completing.
+         * Waits for calls already inside Read, Write, Accept, Timeout, Flush or Poll to return (waking a blocked Poll), later ones throw InvalidOperation.
+         * Must not be called from a completion.
+         */
+        static void Shutdown() noexcept;
+
+        static ReactorBackend GetBackend() noexcept;
+
+        static void Read(int fd, void* buffer, std::size_t length, std::int64_t offset, Completion then);
+        static void Write(int fd, const void* buffer, std::size_t length, std::int64_t offset, Completion then);
+        static void Accept(int fd, Completion then);
+        static void Timeout(std::chrono::nanoseconds delay, Completion then);
+
+        /// @brief Queued io_uring entries handed to the kernel in one go, defaults to 32.
+        static void SetBatchSize(unsigned int count) noexcept;
+
+        /// @brief Hands the queued submissions to the kernel now.
+        static void Flush();
+
+        /**
+         * @brief Reaps completions for threads outside the pool, waiting up to timeout for one.
+         * @return Whether any completion ran.
+         */
+        static bool Poll(std::chrono::milliseconds timeout);
+    };
+
+    /**
+     * @brief co_await-able reactor operation, the coroutine is resumed on the thread reaping the completion.
+     */
+    class [[nodiscard]] OperationAwaiter{
+    private:
+        std::function<void(Completion)> start;
+        int result = 0;
+    public:
+        explicit OperationAwaiter(std::function<void(Completion)> s) : start(std::move(s)) {}
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            //The operation may complete (and resume the coroutine) before start returns, don't touch this afterwards.
+            start([this, handle](int r) {
+                result = r;
+                handle.resume();
+            });
+        }
+
+        int await_resume() const noexcept {
+            return result;
+        }
+    };
+
+    inline OperationAwaiter ReadAsync(int fd, void* buffer, std::size_t length, std::int64_t offset = -1) {
+        return OperationAwaiter([=](Completion then) { Reactor::Read(fd, buffer, length, offset, std::move(then)); });
+    }
+
+    inline OperationAwaiter WriteAsync(int fd, const void* buffer, std::size_t length, std::int64_t offset = -1) {
+        return OperationAwaiter([=](Completion then) { Reactor::Write(fd, buffer, length, offset, std::move(then)); });
+    }
+
+    inline OperationAwaiter AcceptAsync(int fd) {
+        return OperationAwaiter([=](Completion then) { Reactor::Accept(fd, std::move(then)); });
+    }
+
+    inline OperationAwaiter SleepAsync(std::chrono::nanoseconds delay) {
+        return OperationAwaiter([=](Completion then) { Reactor::Timeout(delay, std::move(then)); });
+    }
+    ///@}
+}
@@ -0,0 +1,319 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "Arena.h"
+
+namespace StreamLine{
+    /** \addtogroup Stream
+     *  @{
+     */
+
+    enum class ColumnType : unsigned int{
+        Int32, Int64, UInt32, UInt64, Float32, Float64
+    };
+
+    namespace Internal{
+        template<class T>
+        constexpr ColumnType ColumnTypeOf() {
+            if constexpr (std::is_same_v<T, std::int32_t>) return ColumnType::Int32;
+            else if constexpr (std::is_same_v<T, std::int64_t>) return ColumnType::Int64;
+            else if constexpr (std::is_same_v<T, std::uint32_t>) return ColumnType::UInt32;
+            else if constexpr (std::is_same_v<T, std::uint64_t>) return ColumnType::UInt64;
+            else if constexpr (std::is_same_v<T, float>) return ColumnType::Float32;
+            else {
+                static_assert(std::is_same_v<T, double>, "Unsupported column type");
+                return ColumnType::Float64;
+            }
+        }
+    }
+
+    constexpr std::size_t ColumnTypeSize(ColumnType type) noexcept {
+        switch (type) {
+        case ColumnType::Int32:
+        case ColumnType::UInt32:
+        case ColumnType::Float32:
+            return 4;
+        default:
+            return 8;
+        }
+    }
+
+    struct Field{
+        std::string Name;
+        ColumnType Type;
+    };
+
+    using Schema = std::vector<Field>;
+
+    /**
+     * @brief One fixed-width column of a RecordBatch: contiguous values and an optional validity bitmap.
+     *
+     * Bit i of the bitmap (LSB first) is set when row i holds a value. Without a bitmap every row is valid.
+     * The bitmap belongs to the column rather than the arena, so marking nulls never touches a shared arena.
+     */
+    class Column{
+    private:
+        friend class RecordBatch;
+        ColumnType type;
+        void* data;
+        std::unique_ptr<std::uint64_t[]> validity;
+        std::size_t capacity;
+
+        Column(ColumnType columnType, std::size_t rows, Arena* owner)
+            : type(columnType), data(owner->Allocate(rows * ColumnTypeSize(columnType))), capacity(rows) {}
+    public:
+        inline ColumnType Type() const noexcept {
+            return type;
+        }
+
+        /// @throws std::invalid_argument if T doesn't match the column type.
+        template<class T>
+        T* Data() {
+            if (Internal::ColumnTypeOf<T>() != type) {
+                throw std::invalid_argument("Column type mismatch");
+            }
+            return static_cast<T*>(data);
+        }
+
+        template<class T>
+        const T* Data() const {
+            return const_cast<Column*>(this)->Data<T>();
+        }
+
+        /// @brief The values as bytes, ColumnTypeSize(Type()) per row.
+        inline void* RawData() noexcept {
+            return data;
+        }
+
+        inline const void* RawData() const noexcept {
+            return data;
+        }
+
+        /// @brief nullptr when every row is valid.
+        inline const std::uint64_t* Validity() const noexcept {
+            return validity.get();
+        }
+
+        inline bool IsValid(std::size_t row) const noexcept {
+            return validity == nullptr || (validity[row / 64] >> (row % 64)) & 1;
+        }
+
+        /// @brief Marks a row null, the bitmap is made on the first null.
+        void SetNull(std::size_t row) {
+            if (validity == nullptr) {
+                const std::size_t words = (capacity + 63) / 64;
+                validity = std::make_unique<std::uint64_t[]>(words);
+                std::memset(validity.get(), 0xFF, words * sizeof(std::uint64_t));
+            }
+            validity[row / 64] &= ~(std::uint64_t(1) << (row % 64));
+        }
+
+        void SetValid(std::size_t row) noexcept {
+            if (validity != nullptr) {
+                validity[row / 64] |= std::uint64_t(1) << (row % 64);
+            }
+        }
+    };
+
+    /**
+     * @brief Rows stored column by column (struct of arrays), the unit of work of vectorized stages.
+     *
+     * Column buffers are 64-byte aligned and come from the batch's arena, so a batch is a handful of allocations
+     * whatever its width. Filters don't move data: they leave a selection vector of the rows still in, which the
+     * following stages iterate and Compact eventually materializes.
+     *
+     * In batch mode a pipeline carries whole batches, each stage being a kernel over contiguous columns:
+     * @code
+     * auto totals = Stream::From(batches)
+     *     | Stream::Parallel(1)
+     *     | Stream::Map([](RecordBatch& batch) { batch.Select<double>(1, [](double v) { return v > 0; }); return Sum(batch); })
+     *     | Stream::Collect();
+     * @endcode
+     *
+     * @note Batches sharing an arena must be built by a single thread, the arena only serves the column buffers
+     * made at construction. Selections and null bitmaps are allocated by each batch, so batches can be processed
+     * anywhere afterwards, by as many threads as there are batches.
+     */
+    class RecordBatch{
+    private:
+        std::shared_ptr<Arena> arena;
+        Schema schema;
+        std::vector<Column> columns;
+        std::size_t size = 0;
+        std::size_t capacity;
+        std::uint32_t* selection = nullptr;
+        std::size_t selected = 0;
+        //Backs SelectionBuffer, made on first use and reused by every later selection.
+        std::unique_ptr<std::uint32_t[]> selectionStorage;
+
+        template<class W>
+        void Gather(W* data) const noexcept {
+            for (std::size_t i = 0; i < selected; i++) {
+                data[i] = data[selection[i]];
+            }
+        }
+    public:
+        /**
+         * @param rowCapacity Rows the columns are sized for, Resize can't go past it.
+         * @param sharedArena Arena the buffers come from, a private one is made when empty.
+         */
+        RecordBatch(Schema batchSchema, std::size_t rowCapacity, std::shared_ptr<Arena> sharedArena = nullptr)
+            : arena(sharedArena ? std::move(sharedArena) : std::make_shared<Arena>()), schema(std::move(batchSchema)), capacity(rowCapacity) {
+            columns.reserve(schema.size());
+            for (const Field& field : schema) {
+                columns.push_back(Column(field.Type, capacity, arena.get()));
+            }
+        }
+
+        RecordBatch(RecordBatch&&) noexcept = default;
+        RecordBatch& operator=(RecordBatch&&) noexcept = default;
+        RecordBatch(const RecordBatch&) = delete;
+        RecordBatch& operator=(const RecordBatch&) = delete;
+
+        inline const Schema& GetSchema() const noexcept {
+            return schema;
+        }
+
+        inline std::size_t ColumnCount() const noexcept {
+            return columns.size();
+        }
+
+        inline Column& GetColumn(std::size_t index) {
+            return columns.at(index);
+        }
+
+        inline const Column& GetColumn(std::size_t index) const {
+            return columns.at(index);
+        }
+
+        /// @throws std::out_of_range if no column has that name.
+        std::size_t ColumnIndex(const std::string& name) const {
+            for (std::size_t i = 0; i < schema.size(); i++) {
+                if (schema[i].Name == name) {
+                    return i;
+                }
+            }
+            throw std::out_of_range("No column " + name);
+        }
+
+        inline Column& GetColumn(const std::string& name) {
+            return columns[ColumnIndex(name)];
+        }
+
+        /// @brief Rows held, ignoring the selection.
+        inline std::size_t Size() const noexcept {
+            return size;
+        }
+
+        inline std::size_t Capacity() const noexcept {
+            return capacity;
+        }
+
+        /// @brief Sets the row count after filling the columns, clears the selection.
+        void Resize(std::size_t rows) {
+            if (rows > capacity) {
+                throw std::length_error("RecordBatch capacity exceeded");
+            }
+            size = rows;
+            selection = nullptr;
+        }
+
+        inline bool HasSelection() const noexcept {
+            return selection != nullptr;
+        }
+
+        /// @brief Ascending indices of the selected rows, nullptr when every row is selected.
+        inline const std::uint32_t* Selection() const noexcept {
+            return selection;
+        }
+
+        /// @brief Rows left after the selection.
+        inline std::size_t ActiveRows() const noexcept {
+            return selection != nullptr ? selected : size;
+        }
+
+        /**
+         * @brief Room for a selection vector of every row, fill it then commit it with SetSelection.
+         * Kernels writing selections directly use this.
+         *
+         * The buffer is the batch's own and the same one every time, it may hold the current selection:
+         * narrow it in place, writing each index only after reading the ones at and before its position.
+         */
+        std::uint32_t* SelectionBuffer() {
+            if (!selectionStorage) {
+                selectionStorage = std::make_unique<std::uint32_t[]>(std::max<std::size_t>(1, capacity));
+            }
+            return selectionStorage.get();
+        }
+
+        /// @brief Installs indices (ascending, from SelectionBuffer or otherwise outliving the batch) as the selection.
+        void SetSelection(std::uint32_t* indices, std::size_t count) noexcept {
+            selection = indices;
+            selected = count;
+        }
+
+        /// @brief Calls f(row) for every selected row.
+        template<class F>
+        void ForEachRow(F&& f) const {
+            if (selection == nullptr) {
+                for (std::size_t i = 0; i < size; i++) {
+                    f(i);
+                }
+                return;
+            }
+            for (std::size_t i = 0; i < selected; i++) {
+                f(static_cast<std::size_t>(selection[i]));
+            }
+        }
+
+        /**
+         * @brief Narrows the selection to the valid rows of column whose value satisfies predicate.
+         */
+        template<class T, class Predicate>
+        void Select(std::size_t column, Predicate&& predicate) {
+            const Column& source = columns.at(column);
+            const T* values = source.Data<T>();
+            std::uint32_t* out = SelectionBuffer();
+            std::size_t count = 0;
+            //Refines in place when the selection already lives in out, the write at count trails the read.
+            ForEachRow([&](std::size_t row) {
+                //Branch-free append, the compiler keeps the loop tight.
+                out[count] = static_cast<std::uint32_t>(row);
+                count += static_cast<std::size_t>(source.IsValid(row) && predicate(values[row]));
+            });
+            SetSelection(out, count);
+        }
+
+        /// @brief Moves the selected rows to the front of every column and drops the selection.
+        void Compact() {
+            if (selection == nullptr) {
+                return;
+            }
+            //Indices are ascending, so row i never overwrites a row still to be moved.
+            for (Column& column : columns) {
+                if (ColumnTypeSize(column.type) == 4) {
+                    Gather(static_cast<std::uint32_t*>(column.data));
+                }
+                else {
+                    Gather(static_cast<std::uint64_t*>(column.data));
+                }
+                if (column.validity != nullptr) {
+                    for (std::size_t i = 0; i < selected; i++) {
+                        const std::uint64_t valid = column.IsValid(selection[i]);
+                        column.validity[i / 64] = (column.validity[i / 64] & ~(std::uint64_t(1) << (i % 64))) | (valid << (i % 64));
+                    }
+                }
+            }
+            size = selected;
+            selection = nullptr;
+        }
+    };
+    ///@}
+}
@@ -0,0 +1,194 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include "BlockingPool.h"
+#include "Exception.h"
+#include "Latch.h"
+
+namespace StreamLine{
+    /** \addtogroup Parallel
+     *  @{
+     */
+
+    /**
+     * @brief Executor confined to one thread, its owner, which pumps it.
+     *
+     * Any thread (or fiber, or coroutine) can hand work to the owner: Post queues it, Invoke also waits for its result,
+     * co_await Schedule() continues a coroutine there. Work touching a thread-affine resource (a GL context,
+     * a library that isn't thread-safe) thus runs on the one thread allowed to touch it, without locking the resource.
+     * Main() is the loop of the thread that called Bootstrap::Initialize.
+     *
+     * Example usage:
+     * @code
+     * //Worker side.
+     * RunLoop::Main().Post([texture = Decode(file)]() mutable { Upload(std::move(texture)); });
+     * //Owner side, once per frame.
+     * RunLoop::Main().RunPending();
+     * @endcode
+     *
+     * @note The pumping methods throw InvalidOperation when called from another thread than the owner.
+     */
+    class RunLoop{
+    private:
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::deque<std::function<void()>> tasks;
+        //Atomic: Attach may change it while other threads check it to post.
+        std::atomic<std::thread::id> owner;
+        bool stopped = false;
+
+        void CheckOwner() const {
+            if (!IsCurrent()) {
+                throw InvalidOperation();
+            }
+        }
+
+        class ScheduleAwaiter{
+        private:
+            RunLoop* loop;
+        public:
+            explicit ScheduleAwaiter(RunLoop* l) noexcept : loop(l) {}
+
+            bool await_ready() const noexcept {
+                return loop->IsCurrent();
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                loop->Post([handle]() { handle.resume(); });
+            }
+
+            void await_resume() const noexcept {}
+        };
+    public:
+        /// @brief A loop owned by the calling thread.
+        RunLoop() : owner(std::this_thread::get_id()) {}
+
+        RunLoop(const RunLoop&) = delete;
+        RunLoop& operator=(const RunLoop&) = delete;
+
+        /// @brief The loop of the thread that called Bootstrap::Initialize (or first called Main).
+        static RunLoop& Main() {
+            static RunLoop loop;
+            return loop;
+        }
+
+        /// @brief Makes the calling thread the owner, while nobody pumps the loop.
+        void Attach() {
+            owner.store(std::this_thread::get_id(), std::memory_order_release);
+        }
+
+        bool IsCurrent() const noexcept {
+            return std::this_thread::get_id() == owner.load(std::memory_order_acquire);
+        }
+
+        /// @brief Queues f to run on the owner thread, callable from any thread.
+        void Post(std::function<void()> f) {
+            std::lock_guard<std::mutex> lock(mtx);
+            tasks.push_back(std::move(f));
+            //Under the lock: once woken, the owner may return and destroy the loop.
+            cv.notify_one();
+        }
+
+        /**
+         * @brief Runs f on the owner thread and returns its result, or rethrows its exception.
+         * The owner runs it inline. A fiber parks meanwhile, leaving its worker to other work.
+         */
+        template<class F>
+        auto Invoke(F&& f) -> std::invoke_result_t<F&> {
+            using R = std::invoke_result_t<F&>;
+            if (IsCurrent()) {
+                return f();
+            }
+            struct Call{
+                F* f;
+                Internal::BlockingResult<R> result;
+                Locks::HybridLatch done;
+            };
+            //Shared: the owner may still be inside Signal when the waiter returns.
+            auto call = std::make_shared<Call>();
+            call->f = &f;
+            Post([call]() {
+                call->result.Run(*call->f);
+                call->done.Signal();
+            });
+            call->done.Wait();
+            return call->result.Get();
+        }
+
+        /// @brief co_await-able, continues the coroutine on the owner thread.
+        [[nodiscard]] ScheduleAwaiter Schedule() noexcept {
+            return ScheduleAwaiter(this);
+        }
+
+        /**
+         * @brief Runs up to maxTasks of the queued work, without waiting for more. For owners with a loop of their own.
+         * @return The number of tasks run.
+         */
+        std::size_t RunPending(std::size_t maxTasks = std::numeric_limits<std::size_t>::max()) {
+            CheckOwner();
+            std::size_t ran = 0;
+            std::unique_lock<std::mutex> lock(mtx);
+            while (ran < maxTasks && !tasks.empty()) {
+                std::function<void()> task = std::move(tasks.front());
+                tasks.pop_front();
+                lock.unlock();
+                task();
+                ran++;
+                lock.lock();
+            }
+            return ran;
+        }
+
+        /**
+         * @brief Waits up to timeout for work, then runs what is queued.
+         * @return The number of tasks run, 0 on timeout or Stop.
+         */
+        std::size_t RunFor(std::chrono::milliseconds timeout) {
+            CheckOwner();
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                if (!cv.wait_for(lock, timeout, [this]() noexcept { return !tasks.empty() || stopped; }) || tasks.empty()) {
+                    return 0;
+                }
+            }
+            return RunPending();
+        }
+
+        /// @brief Pumps the loop until Stop is called, then returns with the remaining work run.
+        void Run() {
+            CheckOwner();
+            std::unique_lock<std::mutex> lock(mtx);
+            while (true) {
+                cv.wait(lock, [this]() noexcept { return !tasks.empty() || stopped; });
+                if (tasks.empty()) {
+                    stopped = false;
+                    return;
+                }
+                std::function<void()> task = std::move(tasks.front());
+                tasks.pop_front();
+                lock.unlock();
+                task();
+                task = nullptr;
+                lock.lock();
+            }
+        }
+
+        /// @brief Makes Run return once the queue is drained, callable from any thread.
+        void Stop() {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopped = true;
+            cv.notify_all();
+        }
+    };
+    ///@}
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <system_error>
+#include <utility>
+#include "Exception.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#define STREAMLINE_SPILL_SUPPORTED 1
+#else
+#define STREAMLINE_SPILL_SUPPORTED 0
+#endif
+
+namespace StreamLine::IO::Internal{
+    /**
+     * @brief Temporary file for data spilled out of memory, appended sequentially and read back at offsets.
+     * It is unlinked as soon as it is created, so it disappears with its descriptor whatever happens to the process.
+     */
+    class SpillFile{
+    private:
+        int fd = -1;
+        std::uint64_t size = 0;
+    public:
+        SpillFile() noexcept = default;
+
+        /**
+         * @param directory Where the file goes, empty for $TMPDIR or /tmp.
+         * @throws std::system_error if the file can't be created.
+         */
+        explicit SpillFile(std::string directory) {
+#if STREAMLINE_SPILL_SUPPORTED
+            if (directory.empty()) {
+                const char* tmp = std::getenv("TMPDIR");
+                directory = tmp != nullptr && *tmp != '\0' ? tmp : "/tmp";
+            }
+            std::string path = directory + "/streamline-spill-XXXXXX";
+            fd = mkstemp(path.data());
+            if (fd < 0) {
+                throw std::system_error(errno, std::generic_category(), "mkstemp " + path);
+            }
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+            unlink(path.c_str());
+#else
+            (void)directory;
+            throw InvalidOperation();
+#endif
+        }
+
+        ~SpillFile() {
+#if STREAMLINE_SPILL_SUPPORTED
+            if (fd >= 0) {
+                close(fd);
+            }
+#endif
+        }
+
+        SpillFile(SpillFile&& other) noexcept : fd(std::exchange(other.fd, -1)), size(std::exchange(other.size, 0)) {}
+
+        SpillFile& operator=(SpillFile&& other) noexcept {
+            std::swap(fd, other.fd);
+            std::swap(size, other.size);
+            return *this;
+        }
+
+        inline bool IsOpen() const noexcept {
+            return fd >= 0;
+        }
+
+        /// @brief Bytes appended so far.
+        inline std::uint64_t Size() const noexcept {
+            return size;
+        }
+
+        /// @throws std::system_error if the write fails.
+        void Append(const void* data, std::size_t bytes) {
+#if STREAMLINE_SPILL_SUPPORTED
+            const char* p = static_cast<const char*>(data);
+            std::size_t left = bytes;
+            while (left > 0) {
+                const ssize_t written = pwrite(fd, p, left, static_cast<off_t>(size + (bytes - left)));
+                if (written < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw std::system_error(errno, std::generic_category(), "SpillFile write");
+                }
+                p += written;
+                left -= static_cast<std::size_t>(written);
+            }
+            size += bytes;
+#else
+            (void)data;
+            (void)bytes;
+            throw InvalidOperation();
+#endif
+        }
+
+        /// @brief Reads bytes at offset, returns 0 or errno. Reads at distinct offsets may run concurrently.
+        int ReadAt(void* data, std::size_t bytes, std::uint64_t offset) const noexcept {
+#if STREAMLINE_SPILL_SUPPORTED
+            char* p = static_cast<char*>(data);
+            while (bytes > 0) {
+                const ssize_t got = pread(fd, p, bytes, static_cast<off_t>(offset));
+                if (got < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return errno;
+                }
+                if (got == 0) {
+                    return EIO;
+                }
+                p += got;
+                offset += static_cast<std::uint64_t>(got);
+                bytes -= static_cast<std::size_t>(got);
+            }
+            return 0;
+#else
+            (void)data;
+            (void)bytes;
+            (void)offset;
+            return ENOSYS;
+#endif
+        }
+    };
+}
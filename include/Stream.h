@@ -0,0 +1,457 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "ThreadPool.h"
+
+namespace StreamLine::Stream{
+    /** \addtogroup Stream
+     *  @{
+     */
+
+    /**
+     * @brief Base of the stream operators.
+     *
+     * An operator binds to the stage after it and returns a callable taking one element and returning whether
+     * more elements are wanted. Binding a whole chain nests the callables, so the compiler sees one loop body
+     * it can inline and vectorize: no queue and no type erasure between fused operators.
+     */
+    struct Operator{
+        /// @brief Called before every run, resets per-run state.
+        void Prepare() {}
+    };
+
+    template<class T>
+    concept StreamOperator = std::derived_from<std::remove_cvref_t<T>, Operator>;
+
+    template<class F>
+    struct MapOperator : Operator{
+        F f;
+        template<class In>
+        using Output = std::invoke_result_t<F&, In>;
+
+        template<class Next>
+        auto Bind(Next next) const {
+            return [f = f, next = std::move(next)](auto&& value) mutable -> bool {
+                return next(std::invoke(f, std::forward<decltype(value)>(value)));
+            };
+        }
+    };
+
+    template<class F>
+    struct FilterOperator : Operator{
+        F f;
+        template<class In>
+        using Output = In;
+
+        template<class Next>
+        auto Bind(Next next) const {
+            return [f = f, next = std::move(next)](auto&& value) mutable -> bool {
+                if (!std::invoke(f, std::as_const(value))) {
+                    return true;
+                }
+                return next(std::forward<decltype(value)>(value));
+            };
+        }
+    };
+
+    template<class F>
+    struct FlatMapOperator : Operator{
+        F f;
+        //Elements of a range returned by value are passed on as values, they don't outlive the range.
+        template<class In>
+        using Output = std::conditional_t<std::is_lvalue_reference_v<std::invoke_result_t<F&, In>>,
+            decltype(*std::begin(std::declval<std::invoke_result_t<F&, In>&>())),
+            std::remove_cvref_t<decltype(*std::begin(std::declval<std::invoke_result_t<F&, In>&>()))>>;
+
+        template<class Next>
+        auto Bind(Next next) const {
+            return [f = f, next = std::move(next)](auto&& value) mutable -> bool {
+                decltype(auto) range = std::invoke(f, std::forward<decltype(value)>(value));
+                for (auto&& element : range) {
+                    bool more;
+                    if constexpr (std::is_lvalue_reference_v<decltype(range)>) {
+                        more = next(std::forward<decltype(element)>(element));
+                    }
+                    else {
+                        more = next(std::move(element));
+                    }
+                    if (!more) {
+                        return false;
+                    }
+                }
+                return true;
+            };
+        }
+    };
+
+    struct TakeOperator : Operator{
+        std::size_t count = 0;
+        //Shared by every copy of the bound stage, so the limit holds across a Parallel point too.
+        std::shared_ptr<std::atomic<std::size_t>> taken;
+        template<class In>
+        using Output = In;
+
+        void Prepare() {
+            taken = std::make_shared<std::atomic<std::size_t>>(0);
+        }
+
+        template<class Next>
+        auto Bind(Next next) const {
+            return [limit = count, taken = taken, next = std::move(next)](auto&& value) mutable -> bool {
+                const std::size_t index = taken->fetch_add(1, std::memory_order_relaxed);
+                if (index >= limit) {
+                    return false;
+                }
+                return next(std::forward<decltype(value)>(value)) && index + 1 < limit;
+            };
+        }
+    };
+
+    /**
+     * @brief Explicit parallelism point: elements reaching it are gathered in batches of grain and the rest of the
+     * chain runs over each batch as a ThreadPool task. Only the first one in a chain counts, later ones fuse away.
+     */
+    struct ParallelOperator : Operator{
+        std::size_t grain = 1024;
+        template<class In>
+        using Output = In;
+
+        template<class Next>
+        Next Bind(Next next) const {
+            return next;
+        }
+    };
+
+    template<class F>
+    MapOperator<std::decay_t<F>> Map(F&& f) {
+        return { {}, std::forward<F>(f) };
+    }
+
+    template<class F>
+    FilterOperator<std::decay_t<F>> Filter(F&& f) {
+        return { {}, std::forward<F>(f) };
+    }
+
+    /// @brief f returns a range per element, its elements are passed on one by one.
+    template<class F>
+    FlatMapOperator<std::decay_t<F>> FlatMap(F&& f) {
+        return { {}, std::forward<F>(f) };
+    }
+
+    /// @brief Passes the first count elements on and stops the stream. After a Parallel point, any count elements.
+    inline TakeOperator Take(std::size_t count) {
+        return { {}, count, {} };
+    }
+
+    inline ParallelOperator Parallel(std::size_t grain = 1024) {
+        return { {}, std::max<std::size_t>(1, grain) };
+    }
+
+    /// @brief Operators composed ahead of a source, a Chain fuses like the operators it holds.
+    template<class... Ops>
+    struct Chain{
+        std::tuple<Ops...> ops;
+    };
+
+    template<StreamOperator A, StreamOperator B>
+    Chain<std::decay_t<A>, std::decay_t<B>> operator|(A&& a, B&& b) {
+        return { { std::forward<A>(a), std::forward<B>(b) } };
+    }
+
+    template<class... Ops, StreamOperator B>
+    Chain<Ops..., std::decay_t<B>> operator|(Chain<Ops...> chain, B&& b) {
+        return { std::tuple_cat(std::move(chain.ops), std::make_tuple(std::forward<B>(b))) };
+    }
+
+    namespace Internal{
+        template<class In, class... Ops>
+        struct ChainOutput{
+            using Type = In;
+        };
+        template<class In, class Op, class... Ops>
+        struct ChainOutput<In, Op, Ops...>{
+            using Type = typename ChainOutput<typename Op::template Output<In>, Ops...>::Type;
+        };
+
+        /// @brief Element type after the first N operators.
+        template<std::size_t N, class In, class... Ops>
+        struct PrefixOutput{
+            using Type = In;
+        };
+        template<std::size_t N, class In, class Op, class... Ops> requires (N > 0)
+        struct PrefixOutput<N, In, Op, Ops...>{
+            using Type = typename PrefixOutput<N - 1, typename Op::template Output<In>, Ops...>::Type;
+        };
+
+        template<class Op>
+        constexpr bool IsParallel = std::is_same_v<Op, ParallelOperator>;
+
+        template<class... Ops>
+        constexpr std::size_t FirstParallel() {
+            constexpr bool flags[] = { IsParallel<Ops>..., false };
+            for (std::size_t i = 0; i < sizeof...(Ops); i++) {
+                if (flags[i]) {
+                    return i;
+                }
+            }
+            return sizeof...(Ops);
+        }
+
+        template<class T>
+        struct CollectSink{
+            std::vector<T> items;
+
+            template<class U>
+            bool operator()(U&& value) {
+                items.emplace_back(std::forward<U>(value));
+                return true;
+            }
+        };
+
+        /// @brief Binds ops [I, End) in front of sink.
+        template<std::size_t I, std::size_t End, class Tuple, class Sink>
+        auto BindRange(const Tuple& ops, Sink sink) {
+            if constexpr (I == End) {
+                return sink;
+            }
+            else {
+                return std::get<I>(ops).Bind(BindRange<I + 1, End>(ops, std::move(sink)));
+            }
+        }
+    }
+
+    /**
+     * @brief A source and the operators applied to it, consumed by ForEach or Collect.
+     *
+     * Example usage:
+     * @code
+     * std::vector<int> squares = Stream::From(values)
+     *     | Stream::Filter([](int v) { return v % 2 == 0; })
+     *     | Stream::Parallel(4096)
+     *     | Stream::Map([](int v) { return v * v; })
+     *     | Stream::Collect();
+     * @endcode
+     */
+    template<class It, class... Ops>
+    class Flow{
+    private:
+        template<class, class...> friend class Flow;
+        It first;
+        It last;
+        std::tuple<Ops...> ops;
+
+        static constexpr std::size_t Split = Internal::FirstParallel<Ops...>();
+        using SourceType = std::iter_reference_t<It>;
+
+        template<class Sink>
+        void Pump(Sink& sink) {
+            for (It it = first; it != last; ++it) {
+                if (!sink(*it)) {
+                    return;
+                }
+            }
+        }
+
+        /**
+         * @brief Runs the chain, makeSink(batch) gives the terminal stage for a batch and batchDone(batch, sink) is
+         * called once the batch went through. Without a Parallel point there is a single batch 0.
+         */
+        template<class MakeSink, class BatchDone>
+        void Execute(MakeSink&& makeSink, BatchDone&& batchDone) {
+            std::apply([](auto&... op) { (op.Prepare(), ...); }, ops);
+            if constexpr (Split == sizeof...(Ops)) {
+                auto sink = makeSink(std::size_t(0));
+                auto stage = Internal::BindRange<0, Split>(ops, std::ref(sink));
+                Pump(stage);
+                batchDone(std::size_t(0), sink);
+            }
+            else {
+                RunParallel(makeSink, batchDone);
+            }
+        }
+
+        template<class MakeSink, class BatchDone>
+        void RunParallel(MakeSink& makeSink, BatchDone& batchDone) {
+            using Prefix = typename Internal::PrefixOutput<Split, SourceType, Ops...>::Type;
+            //Elements still referring to the source are batched as pointers, neither copied nor required to be copyable.
+            static constexpr bool ByReference = std::is_lvalue_reference_v<Prefix>;
+            using Middle = std::conditional_t<ByReference, std::remove_reference_t<Prefix>*, std::decay_t<Prefix>>;
+            struct Shared{
+                std::atomic<std::size_t> pending{ 0 };
+                std::atomic<bool> stop{ false };
+                std::atomic<bool> failed{ false };
+                std::exception_ptr error;
+            } shared;
+            const std::size_t grain = std::get<Split>(ops).grain;
+            std::size_t batchIndex = 0;
+            std::vector<Middle> batch;
+            batch.reserve(grain);
+
+            auto dispatch = [&]() {
+                auto items = std::make_shared<std::vector<Middle>>(std::move(batch));
+                batch = std::vector<Middle>();
+                batch.reserve(grain);
+                const std::size_t index = batchIndex++;
+                shared.pending.fetch_add(1, std::memory_order_relaxed);
+                //Waited for below, so the tasks can refer to this frame.
+                ThreadPool::Submit([this, &shared, &makeSink, &batchDone, items, index]() {
+                    try {
+                        if (!shared.stop.load(std::memory_order_relaxed)) {
+                            auto sink = makeSink(index);
+                            auto stage = Internal::BindRange<Split + 1, sizeof...(Ops)>(ops, std::ref(sink));
+                            for (Middle& item : *items) {
+                                bool more;
+                                if constexpr (ByReference) {
+                                    more = stage(*item);
+                                }
+                                else {
+                                    more = stage(std::move(item));
+                                }
+                                if (!more) {
+                                    shared.stop.store(true, std::memory_order_relaxed);
+                                    break;
+                                }
+                            }
+                            batchDone(index, sink);
+                        }
+                    }
+                    catch (...) {
+                        if (!shared.failed.exchange(true)) {
+                            shared.error = std::current_exception();
+                        }
+                        shared.stop.store(true, std::memory_order_relaxed);
+                    }
+                    shared.pending.fetch_sub(1, std::memory_order_release);
+                });
+            };
+            auto boundary = [&](auto&& value) -> bool {
+                if (shared.stop.load(std::memory_order_relaxed)) {
+                    return false;
+                }
+                if constexpr (ByReference) {
+                    batch.push_back(std::addressof(value));
+                }
+                else {
+                    batch.emplace_back(std::forward<decltype(value)>(value));
+                }
+                if (batch.size() >= grain) {
+                    dispatch();
+                }
+                return true;
+            };
+            try {
+                auto upstream = Internal::BindRange<0, Split>(ops, std::ref(boundary));
+                Pump(upstream);
+                if (!batch.empty() && !shared.stop.load(std::memory_order_relaxed)) {
+                    dispatch();
+                }
+            }
+            catch (...) {
+                shared.stop.store(true, std::memory_order_relaxed);
+                Wait(shared.pending);
+                throw;
+            }
+            Wait(shared.pending);
+            if (shared.error) {
+                std::rethrow_exception(shared.error);
+            }
+        }
+
+        static void Wait(std::atomic<std::size_t>& pending) {
+            while (pending.load(std::memory_order_acquire) != 0) {
+                if (ThreadPool::RunPending(1) == 0) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    public:
+        using Output = typename Internal::ChainOutput<SourceType, Ops...>::Type;
+
+        Flow(It begin, It end, std::tuple<Ops...> operators) : first(begin), last(end), ops(std::move(operators)) {}
+
+        template<StreamOperator B>
+        Flow<It, Ops..., std::decay_t<B>> operator|(B&& op) && {
+            return { first, last, std::tuple_cat(std::move(ops), std::make_tuple(std::forward<B>(op))) };
+        }
+
+        template<class... More>
+        Flow<It, Ops..., More...> operator|(Chain<More...> chain) && {
+            return { first, last, std::tuple_cat(std::move(ops), std::move(chain.ops)) };
+        }
+
+        /**
+         * @brief Calls f on every element leaving the chain.
+         * After a Parallel point f runs on several workers at once.
+         */
+        template<class F>
+        void ForEach(F&& f) {
+            Execute([&f](std::size_t) {
+                return [&f](auto&& value) -> bool {
+                    f(std::forward<decltype(value)>(value));
+                    return true;
+                };
+            }, [](std::size_t, auto&) {});
+        }
+
+        /// @brief Gathers the elements leaving the chain, in source order even across a Parallel point.
+        std::vector<std::decay_t<Output>> Collect() {
+            using T = std::decay_t<Output>;
+            using Sink = Internal::CollectSink<T>;
+            std::mutex mtx;
+            std::vector<std::pair<std::size_t, std::vector<T>>> parts;
+            Execute([](std::size_t) { return Sink(); }, [&](std::size_t index, Sink& sink) {
+                std::lock_guard<std::mutex> lock(mtx);
+                parts.emplace_back(index, std::move(sink.items));
+            });
+            if (parts.size() == 1) {
+                return std::move(parts.front().second);
+            }
+            std::sort(parts.begin(), parts.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+            std::vector<T> result;
+            std::size_t total = 0;
+            for (const auto& part : parts) {
+                total += part.second.size();
+            }
+            result.reserve(total);
+            for (auto& part : parts) {
+                std::move(part.second.begin(), part.second.end(), std::back_inserter(result));
+            }
+            return result;
+        }
+    };
+
+    template<class It>
+    Flow<It> From(It first, It last) {
+        return { first, last, {} };
+    }
+
+    /// @brief Streams the elements of range, which must outlive the run.
+    template<class Range>
+    auto From(Range& range) {
+        return From(std::begin(range), std::end(range));
+    }
+
+    /// @brief Terminal tag, flow | Collect() is flow.Collect().
+    struct CollectTag{};
+    inline CollectTag Collect() {
+        return {};
+    }
+
+    template<class It, class... Ops>
+    auto operator|(Flow<It, Ops...>&& flow, CollectTag) {
+        return flow.Collect();
+    }
+    ///@}
+}
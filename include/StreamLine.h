@@ -1,7 +1,26 @@
 #pragma once
 #include "ThreadPool.h"
+#include "Fiber.h"
+#include "Reactor.h"
+#include "BlockingPool.h"
+#include "Parallel.h"
+#include "MappedFile.h"
+#include "OrderedSink.h"
+#include "Batcher.h"
+#include "Window.h"
+#include "Stream.h"
+#include "Arena.h"
+#include "RecordBatch.h"
+#include "Kernels.h"
+#include "ParallelSort.h"
+#include "ExternalSorter.h"
+#include "GroupBy.h"
+#include "HashJoin.h"
+#include "WorkerLocal.h"
 #include "WaitGroup.h"
 #include "Task.h"
+#include "CoTask.h"
+#include "RunLoop.h"
 
 namespace StreamLine{
     /**
@@ -11,6 +30,9 @@ namespace StreamLine{
     struct InstanceConfiguration{
         bool InitThreadPool = false;
         unsigned int ThreadCount = std::thread::hardware_concurrency();
+        bool InitReactor = false;
+        IO::ReactorBackend ReactorBackend = IO::ReactorBackend::IoUring;
+        unsigned int MaxBlockingThreads = 512;
 
     };
     /**
@@ -20,9 +42,15 @@ namespace StreamLine{
     class Bootstrap{
     public:
         static void Initialize(const InstanceConfiguration& config = InstanceConfiguration()){
+            //Work posted to the main loop runs on this thread.
+            RunLoop::Main().Attach();
             if(config.InitThreadPool){
                 ThreadPool::InitalizePool(config.ThreadCount);
             }
+            BlockingPool::SetMaxThreads(config.MaxBlockingThreads);
+            if(config.InitReactor){
+                IO::Reactor::Initialize(config.ReactorBackend);
+            }
 
         }
     };
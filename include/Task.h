@@ -3,6 +3,7 @@
 #include "Callable.h"
 #include "Awaitable.h"
 #include "TaskScheduler.h"
+#include <chrono>
 #include <functional>
 #include <future>
 
@@ -14,20 +15,20 @@ namespace StreamLine{
     template<class T>
     class Task : public Awaitable{
         private:
-        std::function<T()> task;
+        std::function<void()> task;
         std::promise<T> result;
-        WaitGroup* wg = nullptr;
+        WaitGroup<>* wg = nullptr;
         Ticket ticket = 0;
     public:
-        Task(std::function<T()> f, WaitGroup* waitgroup){
+        Task(std::function<T()> f, WaitGroup<>* waitgroup){
             wg = waitgroup;
             task = [f = std::move(f), wg = waitgroup, result = &this->result]() -> void{
                 try{
                     T rt_val = f();
                     wg->Done();
-                    result.set_value(rt_val);
+                    result->set_value(rt_val);
                 }catch(const std::exception& e){
-                    result.set_exception(std::current_exception());
+                    result->set_exception(std::current_exception());
                 }
             };
         }
@@ -40,6 +41,7 @@ namespace StreamLine{
                 else {
                     TaskScheduler::CancelTask(ticket);
                 }
+                TaskScheduler::ReleaseTask(ticket);
             }
         }
         
@@ -47,6 +49,21 @@ namespace StreamLine{
             ticket = TaskScheduler::AddTask(task);
         }
 
+        /// @brief Executes when group's turn comes, see TaskScheduler.
+        void Execute(GroupId group){
+            ticket = TaskScheduler::AddTask(group, task);
+        }
+
+        /// @brief Executes earliest deadline first, see TaskScheduler.
+        void Execute(std::chrono::steady_clock::time_point deadline, DeadlinePolicy expired = DeadlinePolicy::Drop){
+            ticket = TaskScheduler::AddTask(deadline, task, expired);
+        }
+
+        /// @brief Executes on the given worker only, for work bound to that worker's thread.
+        void ExecuteOn(unsigned int worker){
+            ticket = TaskScheduler::AddTaskTo(worker, task);
+        }
+
         std::future<T> GetFuture() {
             return result.get_future();
         }
@@ -64,7 +81,7 @@ namespace StreamLine{
             }else if(state == TaskState::Abandonned){
                 //Since task is abandonned, WaitGroup.Done will never be called.
                 //That is handled here.
-                wg.Done();
+                wg->Done();
             }
         }
 
@@ -1,32 +1,676 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <exception>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "ThreadPool.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <time.h>
+#endif
 
 namespace StreamLine
 {
     typedef size_t Ticket;
+    /// @brief Tenant a task is accounted to, see TaskScheduler::AddTask(GroupId, f).
+    typedef std::uint32_t GroupId;
     enum class TaskState : unsigned int{
         Waiting, Executing, Complete, Abandonned, Failed
     };
+    /// @brief What becomes of a deadline task still queued when its deadline passes.
+    enum class DeadlinePolicy : unsigned int{
+        /// @brief Never started, it ends Abandonned.
+        Drop,
+        /// @brief Requeued as an ordinary task, behind the work already queued.
+        Demote,
+        /// @brief Run anyway, still earliest deadline first.
+        Run
+    };
+    /// @brief Outcome of a submission under admission control, see AdmissionOptions.
+    enum class AdmissionStatus : unsigned int{
+        Accepted,
+        /// @brief The task's scheduling class already has its maximum of queued tasks.
+        QueueFull,
+        /// @brief The task's group is over its rate limit.
+        RateLimited,
+        /// @brief Queued tasks have been waiting longer than the target delay, new work is shed until they catch up.
+        Overloaded
+    };
+    struct Admission{
+        AdmissionStatus Status = AdmissionStatus::Accepted;
+        /// @brief The task's ticket when accepted.
+        Ticket Id = 0;
+
+        explicit operator bool() const noexcept {
+            return Status == AdmissionStatus::Accepted;
+        }
+    };
+    /**
+     * @brief Bounds on the work TaskScheduler accepts, so that overload fails fast instead of building a backlog.
+     * Zero disables a bound. Tasks run inline (see TaskScheduler) are never queued, so never refused.
+     */
+    struct AdmissionOptions{
+        /// @brief Ordinary tasks queued at once.
+        std::size_t MaxQueuedTasks = 0;
+        /// @brief Tasks of all groups queued at once.
+        std::size_t MaxQueuedGroupTasks = 0;
+        /// @brief Deadline tasks queued at once.
+        std::size_t MaxQueuedDeadlineTasks = 0;
+        /// @brief Queueing delay above which the scheduler starts shedding a class of tasks (ordinary, grouped, deadline), once it lasted Interval.
+        std::chrono::microseconds TargetDelay{ 0 };
+        std::chrono::milliseconds Interval{ 100 };
+    };
+    class TaskRejected : public std::exception{
+    private:
+        AdmissionStatus status;
+    public:
+        explicit TaskRejected(AdmissionStatus s) noexcept : status(s) {}
+
+        AdmissionStatus GetStatus() const noexcept {
+            return status;
+        }
+
+        const char* what() const noexcept override {
+            return "Task rejected by admission control";
+        }
+    };
+    struct GroupStats{
+        /// @brief CPU time the group's tasks used so far.
+        std::chrono::nanoseconds CpuTime{ 0 };
+        std::uint64_t Completed = 0;
+        /// @brief Tasks that threw, not counted in Completed.
+        std::uint64_t Failed = 0;
+        /// @brief Tasks waiting for their turn.
+        std::size_t Queued = 0;
+        unsigned int Weight = 1;
+    };
     struct TaskPackage{
         std::thread::id executingThread;
         TaskState state;
-        std::exception_ptr exception = nullptr; 
+        std::exception_ptr exception = nullptr;
     };
+
+    /**
+     * @brief Runs tasks on the ThreadPool and tracks them by ticket.
+     *
+     * Spawning is lazy: when the pool is saturated (no idle worker, a queued task per worker already) a new task runs
+     * inline on the spawning thread, as it would have run there or on an equally busy worker later anyway.
+     * Such a task costs no allocation and no queue traffic, its ticket is one of two constants.
+     * Only when some worker is hungry does the task get a record and go to the queue.
+     *
+     * Tasks tagged with a group share the workers by weight instead, whatever each group submits: every group
+     * has its own queue and the queues take turns by deficit round robin. A group's turn lasts weight times
+     * FairQuantum of CPU time, measured on the thread running the task. Any worker runs any group's tasks,
+     * a queued task doesn't wait for a particular worker.
+     *
+     * Tasks with a deadline run earliest deadline first: each worker keeps a heap of the deadline tasks it spawned,
+     * runs its earliest one (or the earliest spawned from outside the pool) and steals the earliest of the other heaps
+     * when its own is empty. Under overload, work whose deadline has passed is dropped or demoted instead of delaying
+     * work that can still make it, see DeadlinePolicy.
+     *
+     * Admission control (SetAdmission, SetGroupRateLimit) bounds what gets queued: the queued tasks of each class,
+     * a token bucket per group, and CoDel-style shedding when the time tasks wait in the queues stays above a target
+     * for a whole interval. TrySubmit reports a refusal, AddTask throws TaskRejected.
+     *
+     * @note A task may thus run before AddTask returns, it must not wait on something its spawner does afterwards.
+     */
     class TaskScheduler{
-        static const Ticket NullTicket = 0;
+        static constexpr Ticket NullTicket = 0;
+        //Tickets of tasks that ran inline, they need no record.
+        static constexpr Ticket CompleteTicket = 1;
+        static constexpr Ticket FailedTicket = 2;
+    public:
+        /// @brief CPU time of a weight 1 group's turn.
+        static constexpr std::chrono::nanoseconds FairQuantum = std::chrono::microseconds(500);
+    private:
+
+        enum Class : unsigned int{
+            Ordinary, Grouped, Deadlined, ClassCount
+        };
+
+        struct Record{
+            std::function<void()> work;
+            Class cls = Ordinary;
+            std::int64_t enqueued = 0;
+            std::atomic<TaskState> state{ TaskState::Waiting };
+            //Pinned to a worker, nobody else may run it.
+            bool confined = false;
+        };
+
+        struct Group{
+            std::deque<std::shared_ptr<Record>> queue;
+            unsigned int weight = 1;
+            //CPU time the group may still use this round, in nanoseconds.
+            std::int64_t deficit = 0;
+            bool active = false;
+            std::uint64_t cpuTime = 0;
+            std::uint64_t completed = 0;
+            std::uint64_t failed = 0;
+            //Token bucket, rate 0 for none.
+            double rate = 0.0;
+            double burst = 0.0;
+            double tokens = 0.0;
+            std::int64_t refilled = 0;
+        };
+
+        struct DeadlineEntry{
+            std::chrono::steady_clock::time_point deadline;
+            std::shared_ptr<Record> record;
+            DeadlinePolicy policy;
+
+            //Reversed, so that the std heap functions keep the earliest on top.
+            bool operator<(const DeadlineEntry& other) const noexcept {
+                return deadline > other.deadline;
+            }
+        };
+
+        struct alignas(64) DeadlineHeap{
+            std::mutex mtx;
+            std::vector<DeadlineEntry> entries;
+            //Top deadline, readable without the lock, max when empty.
+            std::atomic<std::int64_t> earliest{ INT64_MAX };
+
+            void Push(DeadlineEntry entry) {
+                std::lock_guard<std::mutex> lock(mtx);
+                entries.push_back(std::move(entry));
+                std::push_heap(entries.begin(), entries.end());
+                earliest.store(entries.front().deadline.time_since_epoch().count(), std::memory_order_relaxed);
+            }
+
+            bool Pop(DeadlineEntry& entry) {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (entries.empty()) {
+                    return false;
+                }
+                std::pop_heap(entries.begin(), entries.end());
+                entry = std::move(entries.back());
+                entries.pop_back();
+                earliest.store(entries.empty() ? INT64_MAX : entries.front().deadline.time_since_epoch().count(), std::memory_order_relaxed);
+                return true;
+            }
+        };
+
+        static inline std::atomic<Ticket> NextTicket{ FailedTicket + 1 };
+        static inline std::mutex RecordsMutex;
+        static inline std::unordered_map<Ticket, std::shared_ptr<Record>> Records;
+
+        static inline std::mutex GroupsMutex;
+        //Never erased, so pointers to the groups stay valid.
+        static inline std::unordered_map<GroupId, Group> Groups;
+        //Groups with queued tasks, in round robin order.
+        static inline std::vector<Group*> Active;
+        static inline std::size_t Cursor = 0;
+
+        static inline std::mutex HeapsMutex;
+        //One heap per worker index seen, grown as the pool does and never shrunk, so heaps stay put and queued entries reachable.
+        static inline std::vector<std::unique_ptr<DeadlineHeap>> Heaps;
+        static inline std::atomic<std::uint64_t> Expired{ 0 };
+
+        static inline std::atomic<std::size_t> MaxQueued[ClassCount]{};
+        static inline std::atomic<std::size_t> QueuedCount[ClassCount]{};
+        static inline std::atomic<std::int64_t> TargetDelay{ 0 };
+        static inline std::atomic<std::int64_t> Interval{ 100000000 };
+        //Per class, each queue drains at its own pace. When the queueing delay first went above target, 0 while below.
+        static inline std::atomic<std::int64_t> AboveSince[ClassCount]{};
+        static inline std::atomic<bool> Shedding[ClassCount]{};
+        static inline std::atomic<std::uint64_t> Rejected{ 0 };
+
+        static std::int64_t Now() noexcept {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        /// @brief Checks the class bound and the shedding state, then counts the task in.
+        static AdmissionStatus Admit(Class cls) noexcept {
+            if (Shedding[cls].load(std::memory_order_relaxed)) {
+                return AdmissionStatus::Overloaded;
+            }
+            const std::size_t max = MaxQueued[cls].load(std::memory_order_relaxed);
+            if (max != 0 && QueuedCount[cls].load(std::memory_order_relaxed) >= max) {
+                return AdmissionStatus::QueueFull;
+            }
+            QueuedCount[cls].fetch_add(1, std::memory_order_relaxed);
+            return AdmissionStatus::Accepted;
+        }
+
+        static Admission Refuse(AdmissionStatus status) noexcept {
+            Rejected.fetch_add(1, std::memory_order_relaxed);
+            return Admission{ status, NullTicket };
+        }
+
+        static std::shared_ptr<Record> MakeRecord(std::function<void()>&& f, Class cls) {
+            auto record = std::make_shared<Record>();
+            record->work = std::move(f);
+            record->cls = cls;
+            record->enqueued = Now();
+            return record;
+        }
+
+        /// @brief A task left its queue, started (sample) or not. Feeds the delay the shedding is based on.
+        static void Dequeued(const Record& record, bool sample) noexcept {
+            //Pinned tasks bypass admission, their queue is one worker's.
+            if (record.confined) {
+                return;
+            }
+            const bool drained = QueuedCount[record.cls].fetch_sub(1, std::memory_order_relaxed) == 1;
+            const std::int64_t target = TargetDelay.load(std::memory_order_relaxed);
+            if (target == 0 || (!sample && !drained)) {
+                return;
+            }
+            const std::int64_t now = Now();
+            std::atomic<std::int64_t>& aboveSince = AboveSince[record.cls];
+            //Below target, or nothing left standing in this class (even if cancelled rather than run): shed it no more.
+            if (drained || now - record.enqueued < target) {
+                aboveSince.store(0, std::memory_order_relaxed);
+                Shedding[record.cls].store(false, std::memory_order_relaxed);
+                return;
+            }
+            std::int64_t since = aboveSince.load(std::memory_order_relaxed);
+            if (since == 0) {
+                aboveSince.compare_exchange_strong(since, now, std::memory_order_relaxed);
+            }
+            else if (now - since >= Interval.load(std::memory_order_relaxed)) {
+                Shedding[record.cls].store(true, std::memory_order_relaxed);
+            }
+        }
+
+        /// @brief Takes a token from group's bucket, GroupsMutex held.
+        static bool TakeToken(Group& group) noexcept {
+            if (group.rate <= 0.0) {
+                return true;
+            }
+            const std::int64_t now = Now();
+            group.tokens = std::min(group.burst, group.tokens + group.rate * static_cast<double>(now - group.refilled) / 1e9);
+            group.refilled = now;
+            if (group.tokens < 1.0) {
+                return false;
+            }
+            group.tokens -= 1.0;
+            return true;
+        }
+
+        static std::shared_ptr<Record> Find(const Ticket& ticket) {
+            std::lock_guard<std::mutex> lock(RecordsMutex);
+            auto it = Records.find(ticket);
+            return it != Records.end() ? it->second : nullptr;
+        }
+
+        static Ticket Register(const std::shared_ptr<Record>& record) {
+            const Ticket ticket = NextTicket.fetch_add(1, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(RecordsMutex);
+            Records.emplace(ticket, record);
+            return ticket;
+        }
+
+        static std::int64_t ThreadCpuNanos() noexcept {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+            timespec now;
+            if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) == 0) {
+                return static_cast<std::int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+            }
+#endif
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        /// @brief The group whose turn it is, GroupsMutex held and some group active.
+        static Group& NextGroup() noexcept {
+            while (true) {
+                Group& group = *Active[Cursor];
+                if (group.deficit > 0) {
+                    return group;
+                }
+                //Turn over: the group gets its next quantum and waits for the others.
+                group.deficit += static_cast<std::int64_t>(group.weight) * FairQuantum.count();
+                Cursor = (Cursor + 1) % Active.size();
+            }
+        }
+
+        /// @brief Runs the task of whichever group's turn it is, one call per grouped task queued.
+        static void RunNextFair() noexcept {
+            Group* group;
+            std::shared_ptr<Record> record;
+            {
+                std::lock_guard<std::mutex> lock(GroupsMutex);
+                if (Active.empty()) {
+                    return;
+                }
+                group = &NextGroup();
+                record = std::move(group->queue.front());
+                group->queue.pop_front();
+                if (group->queue.empty()) {
+                    group->active = false;
+                    Active.erase(Active.begin() + static_cast<std::ptrdiff_t>(Cursor));
+                    Cursor = Active.empty() ? 0 : Cursor % Active.size();
+                }
+            }
+            const std::int64_t start = ThreadCpuNanos();
+            //Cancelled while queued, it neither ran nor used the group's turn.
+            if (!Run(*record)) {
+                return;
+            }
+            const std::int64_t used = std::max<std::int64_t>(0, ThreadCpuNanos() - start);
+            std::lock_guard<std::mutex> lock(GroupsMutex);
+            group->deficit -= used;
+            group->cpuTime += static_cast<std::uint64_t>(used);
+            if (record->state.load(std::memory_order_relaxed) == TaskState::Failed) {
+                group->failed++;
+            }
+            else {
+                group->completed++;
+            }
+        }
+
+        /// @brief The heap for tasks added from outside the pool.
+        static DeadlineHeap& OutsideHeap() {
+            static DeadlineHeap heap;
+            return heap;
+        }
+
+        static DeadlineHeap& HeapOf(int worker) {
+            if (worker < 0) {
+                return OutsideHeap();
+            }
+            const std::size_t index = static_cast<std::size_t>(worker);
+            std::lock_guard<std::mutex> lock(HeapsMutex);
+            //Sized on the first worker's use rather than up front, the pool may start or restart bigger after tasks were added.
+            if (index >= Heaps.size()) {
+                const std::size_t count = std::max<std::size_t>(index + 1, ThreadPool::GetThreadCount());
+                while (Heaps.size() < count) {
+                    Heaps.push_back(std::make_unique<DeadlineHeap>());
+                }
+            }
+            return *Heaps[index];
+        }
+
+        /// @brief Pops the earliest of the caller's heap and the outside heap, or else steals the earliest of all.
+        static bool PopEarliest(DeadlineEntry& entry) {
+            DeadlineHeap& own = HeapOf(ThreadPool::GetWorkerIndex());
+            DeadlineHeap& outside = OutsideHeap();
+            DeadlineHeap* first = &own;
+            if (outside.earliest.load(std::memory_order_relaxed) < own.earliest.load(std::memory_order_relaxed)) {
+                first = &outside;
+            }
+            if (first->Pop(entry) || (first != &outside && outside.Pop(entry))) {
+                return true;
+            }
+            while (true) {
+                DeadlineHeap* victim = nullptr;
+                std::int64_t best = outside.earliest.load(std::memory_order_relaxed);
+                if (best != INT64_MAX) {
+                    victim = &outside;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(HeapsMutex);
+                    for (const auto& heap : Heaps) {
+                        const std::int64_t top = heap->earliest.load(std::memory_order_relaxed);
+                        if (top < best) {
+                            best = top;
+                            victim = heap.get();
+                        }
+                    }
+                }
+                if (victim == nullptr) {
+                    return false;
+                }
+                if (victim->Pop(entry)) {
+                    return true;
+                }
+            }
+        }
+
+        /// @brief Runs the earliest live deadline task, one call per deadline task queued.
+        static void RunNextDeadline() noexcept {
+            DeadlineEntry entry;
+            while (PopEarliest(entry)) {
+                //Already run by a waiter or cancelled, it didn't expire.
+                if (entry.record->state.load(std::memory_order_acquire) != TaskState::Waiting) {
+                    return;
+                }
+                if (entry.policy != DeadlinePolicy::Run && entry.deadline < std::chrono::steady_clock::now()) {
+                    Expired.fetch_add(1, std::memory_order_relaxed);
+                    if (entry.policy == DeadlinePolicy::Drop) {
+                        TaskState expected = TaskState::Waiting;
+                        if (entry.record->state.compare_exchange_strong(expected, TaskState::Abandonned)) {
+                            entry.record->work = nullptr;
+                            Dequeued(*entry.record, false);
+                        }
+                    }
+                    else {
+                        ThreadPool::Submit([record = std::move(entry.record)]() { Run(*record); });
+                    }
+                    //This call still owes a live task.
+                    continue;
+                }
+                Run(*entry.record);
+                return;
+            }
+        }
+
+        static Ticket Accepted(const Admission& admission) {
+            if (!admission) {
+                throw TaskRejected(admission.Status);
+            }
+            return admission.Id;
+        }
+
+        /// @brief Runs the task unless someone already claimed or cancelled it, returns whether this call ran it.
+        static bool Run(Record& record) noexcept {
+            TaskState expected = TaskState::Waiting;
+            if (!record.state.compare_exchange_strong(expected, TaskState::Executing, std::memory_order_acquire)) {
+                return false;
+            }
+            Dequeued(record, true);
+            TaskState outcome = TaskState::Complete;
+            try {
+                record.work();
+            }
+            catch (...) {
+                outcome = TaskState::Failed;
+            }
+            record.work = nullptr;
+            record.state.store(outcome, std::memory_order_release);
+            return true;
+        }
     public:
-        static const Ticket& AddTask(std::function<void()> f){
-            return NullTicket;
+        /// @brief Queues f, or runs it inline when the pool is saturated. f is dropped if refused.
+        static Admission TrySubmit(std::function<void()> f){
+            if (!ThreadPool::IsHungry() || !ThreadPool::IsRunning()) {
+                try {
+                    f();
+                }
+                catch (...) {
+                    return Admission{ AdmissionStatus::Accepted, FailedTicket };
+                }
+                return Admission{ AdmissionStatus::Accepted, CompleteTicket };
+            }
+            if (const AdmissionStatus status = Admit(Ordinary); status != AdmissionStatus::Accepted) {
+                return Refuse(status);
+            }
+            auto record = MakeRecord(std::move(f), Ordinary);
+            const Ticket ticket = Register(record);
+            ThreadPool::Submit([record]() { Run(*record); });
+            return Admission{ AdmissionStatus::Accepted, ticket };
+        }
+        /// @throws TaskRejected if admission control refuses it.
+        static Ticket AddTask(std::function<void()> f){
+            return Accepted(TrySubmit(std::move(f)));
+        }
+        /**
+         * @brief Queues a task on group's queue, it runs when the group's turn comes, see TaskScheduler.
+         * Grouped tasks are always queued, running them inline would run them out of turn. f is dropped if refused.
+         */
+        static Admission TrySubmit(GroupId group, std::function<void()> f){
+            std::shared_ptr<Record> record;
+            Ticket ticket;
+            {
+                std::lock_guard<std::mutex> lock(GroupsMutex);
+                Group& target = Groups[group];
+                if (const AdmissionStatus status = Admit(Grouped); status != AdmissionStatus::Accepted) {
+                    return Refuse(status);
+                }
+                if (!TakeToken(target)) {
+                    QueuedCount[Grouped].fetch_sub(1, std::memory_order_relaxed);
+                    return Refuse(AdmissionStatus::RateLimited);
+                }
+                record = MakeRecord(std::move(f), Grouped);
+                ticket = Register(record);
+                target.queue.push_back(record);
+                if (!target.active) {
+                    //An idle group keeps its debt but doesn't bank credit.
+                    target.active = true;
+                    target.deficit = std::min<std::int64_t>(target.deficit, 0);
+                    Active.push_back(&target);
+                }
+            }
+            ThreadPool::Submit([]() { RunNextFair(); });
+            return Admission{ AdmissionStatus::Accepted, ticket };
+        }
+        /// @throws TaskRejected if admission control refuses it.
+        static Ticket AddTask(GroupId group, std::function<void()> f){
+            return Accepted(TrySubmit(group, std::move(f)));
+        }
+        /**
+         * @brief Queues a task due by deadline, see TaskScheduler. Deadline tasks are always queued. f is dropped if refused.
+         * @param expired What to do if it is still queued past its deadline.
+         */
+        static Admission TrySubmit(std::chrono::steady_clock::time_point deadline, std::function<void()> f, DeadlinePolicy expired = DeadlinePolicy::Drop){
+            if (const AdmissionStatus status = Admit(Deadlined); status != AdmissionStatus::Accepted) {
+                return Refuse(status);
+            }
+            auto record = MakeRecord(std::move(f), Deadlined);
+            const Ticket ticket = Register(record);
+            const int self = ThreadPool::GetWorkerIndex();
+            HeapOf(self).Push(DeadlineEntry{ deadline, std::move(record), expired });
+            if (self >= 0) {
+                ThreadPool::SubmitTo(static_cast<unsigned int>(self), []() { RunNextDeadline(); });
+            }
+            else {
+                ThreadPool::Submit([]() { RunNextDeadline(); });
+            }
+            return Admission{ AdmissionStatus::Accepted, ticket };
+        }
+        /// @throws TaskRejected if admission control refuses it.
+        static Ticket AddTask(std::chrono::steady_clock::time_point deadline, std::function<void()> f, DeadlinePolicy expired = DeadlinePolicy::Drop){
+            return Accepted(TrySubmit(deadline, std::move(f), expired));
+        }
+        static void SetAdmission(const AdmissionOptions& options) noexcept{
+            MaxQueued[Ordinary].store(options.MaxQueuedTasks, std::memory_order_relaxed);
+            MaxQueued[Grouped].store(options.MaxQueuedGroupTasks, std::memory_order_relaxed);
+            MaxQueued[Deadlined].store(options.MaxQueuedDeadlineTasks, std::memory_order_relaxed);
+            TargetDelay.store(std::chrono::duration_cast<std::chrono::nanoseconds>(options.TargetDelay).count(), std::memory_order_relaxed);
+            Interval.store(std::chrono::duration_cast<std::chrono::nanoseconds>(options.Interval).count(), std::memory_order_relaxed);
+            if (options.TargetDelay.count() == 0) {
+                for (unsigned int cls = 0; cls < ClassCount; cls++) {
+                    AboveSince[cls].store(0, std::memory_order_relaxed);
+                    Shedding[cls].store(false, std::memory_order_relaxed);
+                }
+            }
+        }
+        /**
+         * @brief Limits group to tasksPerSecond on average and burst at once, submissions past it are RateLimited.
+         * A rate of 0 lifts the limit.
+         */
+        static void SetGroupRateLimit(GroupId group, double tasksPerSecond, double burst){
+            std::lock_guard<std::mutex> lock(GroupsMutex);
+            Group& target = Groups[group];
+            target.rate = std::max(0.0, tasksPerSecond);
+            target.burst = std::max(1.0, burst);
+            target.tokens = target.burst;
+            target.refilled = Now();
+        }
+        /// @brief Submissions refused by admission control so far.
+        static std::uint64_t GetRejectedCount() noexcept{
+            return Rejected.load(std::memory_order_relaxed);
+        }
+        /// @brief Deadline tasks found past their deadline so far, dropped or demoted.
+        static std::uint64_t GetExpiredCount() noexcept{
+            return Expired.load(std::memory_order_relaxed);
+        }
+        /// @brief Share of the workers group gets relative to the others, 1 by default.
+        static void SetGroupWeight(GroupId group, unsigned int weight){
+            std::lock_guard<std::mutex> lock(GroupsMutex);
+            Groups[group].weight = std::max(1u, weight);
+        }
+        static GroupStats GetGroupStats(GroupId group){
+            std::lock_guard<std::mutex> lock(GroupsMutex);
+            GroupStats stats;
+            auto it = Groups.find(group);
+            if (it != Groups.end()) {
+                stats.CpuTime = std::chrono::nanoseconds(it->second.cpuTime);
+                stats.Completed = it->second.completed;
+                stats.Failed = it->second.failed;
+                stats.Queued = it->second.queue.size();
+                stats.Weight = it->second.weight;
+            }
+            return stats;
+        }
+        /// @brief Queues a task that only the given worker runs, even when waited for, see ThreadPool::SubmitPinned.
+        static Ticket AddTaskTo(unsigned int worker, std::function<void()> f){
+            auto record = std::make_shared<Record>();
+            record->work = std::move(f);
+            record->confined = true;
+            const Ticket ticket = Register(record);
+            ThreadPool::SubmitPinned(worker, [record]() { Run(*record); });
+            return ticket;
         }
         static const TaskState GetTaskState(const Ticket& ticket) noexcept{
-            return TaskState::Failed;
+            if (ticket == CompleteTicket) {
+                return TaskState::Complete;
+            }
+            if (ticket == FailedTicket) {
+                return TaskState::Failed;
+            }
+            std::shared_ptr<Record> record = Find(ticket);
+            return record ? record->state.load(std::memory_order_acquire) : TaskState::Failed;
         }
+        /**
+         * @brief Returns once the task finished or was abandoned. A task still queued runs on the calling thread
+         * (unless pinned to a worker, or waiting for its group's turn), one running elsewhere is waited for
+         * by running other queued work meanwhile.
+         */
         static void WaitForTask(const Ticket& ticket)noexcept{
-
+            std::shared_ptr<Record> record = Find(ticket);
+            if (!record) {
+                return;
+            }
+            //Running a grouped task here would skip its turn and escape its group's accounting.
+            const bool waitsItsTurn = record->confined || record->cls == Grouped;
+            if (!waitsItsTurn) {
+                Run(*record);
+            }
+            TaskState state;
+            while ((state = record->state.load(std::memory_order_acquire)) == TaskState::Executing || (state == TaskState::Waiting && waitsItsTurn)) {
+                if (ThreadPool::RunPending(1) == 0) {
+                    std::this_thread::yield();
+                }
+            }
         }
+        /// @brief Abandons a task that did not start yet, returns Abandonned then and its current state otherwise.
         static TaskState CancelTask(const Ticket& ticket){
-            return TaskState::Failed;
+            std::shared_ptr<Record> record = Find(ticket);
+            if (!record) {
+                return GetTaskState(ticket);
+            }
+            TaskState expected = TaskState::Waiting;
+            if (record->state.compare_exchange_strong(expected, TaskState::Abandonned)) {
+                record->work = nullptr;
+                Dequeued(*record, false);
+                return TaskState::Abandonned;
+            }
+            return expected;
+        }
+        /// @brief Forgets the ticket, its state can't be queried anymore. The task still runs if it was queued.
+        static void ReleaseTask(const Ticket& ticket){
+            std::lock_guard<std::mutex> lock(RecordsMutex);
+            Records.erase(ticket);
         }
     };
 } // namespace StreamLine::Internal
@@ -1,12 +1,37 @@
 #pragma once
 #include <iostream>
 #include <vector>
+#include <deque>
+#include <functional>
+#include <algorithm>
+#include <cstdlib>
 #include <atomic>
 #include <condition_variable>
 #include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
 
 namespace StreamLine{
         class ThreadPool final {
+        public:
+            /**
+            * @brief Hooks an event source, such as the I/O reactor, into the workers' idle loop.
+            */
+            struct IdleHandler{
+                /// @brief Called between tasks (idle = false) and before a worker sleeps (idle = true), must not block.
+                void (*Tick)(bool idle);
+                /// @brief Blocks until some event was handled or Wake is called, one worker polls at a time.
+                void (*Poll)();
+                /// @brief Interrupts a blocking Poll from another thread.
+                void (*Wake)();
+            };
         private:
             /**
             * @brief The number of threads in the pool.
@@ -16,18 +41,529 @@ namespace StreamLine{
             * @brief The threads in the pool.
             */
             static inline std::vector<std::thread> Threads;
+            /**
+            * @brief Work submitted to the pool, drained by the workers in FIFO order.
+            */
+            static inline std::deque<std::function<void()>> Queue;
+            static inline std::mutex QueueMutex;
+            /**
+            * @brief Per-worker state, guarded by QueueMutex.
+            */
+            struct Worker{
+                /// @brief Work submitted to this worker in particular, see SubmitTo.
+                std::deque<std::function<void()>> Mailbox;
+                /// @brief Work only this worker may run, see SubmitPinned.
+                std::deque<std::function<void()>> Pinned;
+                std::condition_variable Cv;
+                /// @brief Waiting on Cv, cleared by whoever wakes it.
+                bool Sleeping = false;
+            };
+            static inline std::unique_ptr<Worker[]> Workers;
+            /**
+            * @brief Tasks waiting in mailboxes, guarded by QueueMutex.
+            */
+            static inline std::size_t Mailed = 0;
+            /**
+            * @brief Tasks waiting in the queue and the mailboxes, written under QueueMutex, read without it.
+            */
+            static inline std::atomic<std::size_t> Queued{ 0 };
+            /**
+            * @brief Guarded by QueueMutex, workers exit once it is cleared and the queue is drained.
+            */
+            static inline bool Running = false;
+            /**
+            * @brief Workers sleeping on their Cv, guarded by QueueMutex.
+            */
+            static inline std::atomic<unsigned int> Sleepers{ 0 };
+            /**
+            * @brief Guarded by QueueMutex, PollerActive is set while a worker owns the handler's Poll.
+            */
+            static inline IdleHandler Handler{};
+            static inline bool PollerActive = false;
+            static inline int PollerIndex = -1;
+            /**
+            * @brief Set while the poller is (about to be) blocked in Poll, cleared by whoever wakes it.
+            */
+            static inline std::atomic<bool> PollerSleeping{ false };
+            /**
+            * @brief Calls into the handler in flight, SetIdleHandler waits for them to drain.
+            */
+            static inline std::atomic<unsigned int> HandlerUsers{ 0 };
+            /**
+            * @brief eventfd handed to external event loops, -1 until requested.
+            */
+            static inline std::atomic<int> NotifyFd{ -1 };
+            /**
+            * @brief Set once NotifyFd was signaled, cleared by RunPending once the queue is drained. Keeps Submit to one write per batch.
+            */
+            static inline std::atomic<bool> NotifyPending{ false };
+            /**
+            * @brief Index of the pool worker running on this thread, -1 for any other thread.
+            */
+            static inline thread_local int WorkerIndex = -1;
+
+            /**
+            * @brief Whether worker index (-1 for anyone) could take a task, lock held.
+            */
+            static inline bool HasWork(int index = -1) noexcept {
+                return !Queue.empty() || Mailed != 0 || (index >= 0 && !Workers[index].Pinned.empty());
+            }
+
+            /**
+            * @brief Takes the next task for worker index (-1 outside the pool), lock held.
+            * Its pinned work and its mailbox come first, then the shared queue, then the other workers' mailboxes.
+            */
+            static bool TakeTask(int index, std::function<void()>& task) {
+                const std::size_t count = Workers ? ThreadCount : 0;
+                if (index >= 0 && static_cast<std::size_t>(index) < count && !Workers[index].Pinned.empty()) {
+                    task = std::move(Workers[index].Pinned.front());
+                    Workers[index].Pinned.pop_front();
+                    return true;
+                }
+                if (index >= 0 && static_cast<std::size_t>(index) < count && !Workers[index].Mailbox.empty()) {
+                    task = std::move(Workers[index].Mailbox.front());
+                    Workers[index].Mailbox.pop_front();
+                    Mailed--;
+                    Queued.fetch_sub(1, std::memory_order_relaxed);
+                    return true;
+                }
+                if (!Queue.empty()) {
+                    task = std::move(Queue.front());
+                    Queue.pop_front();
+                    Queued.fetch_sub(1, std::memory_order_relaxed);
+                    return true;
+                }
+                if (Mailed == 0) {
+                    return false;
+                }
+                const std::size_t start = index >= 0 ? static_cast<std::size_t>(index) + 1 : 0;
+                for (std::size_t i = 0; i < count; i++) {
+                    Worker& victim = Workers[(start + i) % count];
+                    if (!victim.Mailbox.empty()) {
+                        //The owner is busy, stealing from the back keeps its oldest work for it.
+                        task = std::move(victim.Mailbox.back());
+                        victim.Mailbox.pop_back();
+                        Mailed--;
+                        Queued.fetch_sub(1, std::memory_order_relaxed);
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            static void WorkerLoop(unsigned int index) {
+                WorkerIndex = static_cast<int>(index);
+                std::unique_lock<std::mutex> lock(QueueMutex);
+                Worker& self = Workers[index];
+                while (true) {
+                    std::function<void()> task;
+                    if (TakeTask(static_cast<int>(index), task)) {
+                        IdleHandler handler = Handler;
+                        if (handler.Tick != nullptr) {
+                            HandlerUsers.fetch_add(1, std::memory_order_relaxed);
+                        }
+                        lock.unlock();
+                        task();
+                        task = nullptr;
+                        if (handler.Tick != nullptr) {
+                            handler.Tick(false);
+                            HandlerUsers.fetch_sub(1, std::memory_order_release);
+                        }
+                        lock.lock();
+                        continue;
+                    }
+                    if (!Running) {
+                        //Shutting down and nothing left to run.
+                        return;
+                    }
+                    IdleHandler handler = Handler;
+                    if (handler.Poll != nullptr && !PollerActive) {
+                        //This worker waits on the event source while the others sleep on the queue.
+                        PollerActive = true;
+                        PollerIndex = static_cast<int>(index);
+                        PollerSleeping.store(true);
+                        HandlerUsers.fetch_add(1, std::memory_order_relaxed);
+                        lock.unlock();
+                        handler.Poll();
+                        PollerSleeping.store(false);
+                        HandlerUsers.fetch_sub(1, std::memory_order_release);
+                        lock.lock();
+                        PollerActive = false;
+                        PollerIndex = -1;
+                        continue;
+                    }
+                    if (handler.Tick != nullptr) {
+                        HandlerUsers.fetch_add(1, std::memory_order_relaxed);
+                        lock.unlock();
+                        handler.Tick(true);
+                        HandlerUsers.fetch_sub(1, std::memory_order_release);
+                        lock.lock();
+                        if (HasWork(static_cast<int>(index)) || !Running) {
+                            continue;
+                        }
+                    }
+                    Sleepers++;
+                    self.Sleeping = true;
+                    self.Cv.wait(lock);
+                    if (self.Sleeping) {
+                        //Spurious wakeup, nobody counted this worker out.
+                        self.Sleeping = false;
+                        Sleepers--;
+                    }
+                }
+            }
+
+            static void WakeWorker(Worker& worker) {
+                worker.Sleeping = false;
+                Sleepers--;
+                worker.Cv.notify_one();
+            }
+
+            static void WakeAll() {
+                for (unsigned int i = 0; Workers && i < ThreadCount; i++) {
+                    if (Workers[i].Sleeping) {
+                        WakeWorker(Workers[i]);
+                    }
+                }
+            }
+
+            static void WakePoller(std::unique_lock<std::mutex>& lock) {
+                void (*wake)() = Handler.Wake;
+                HandlerUsers.fetch_add(1, std::memory_order_relaxed);
+                lock.unlock();
+                if (PollerSleeping.exchange(false)) {
+                    wake();
+                }
+                HandlerUsers.fetch_sub(1, std::memory_order_release);
+            }
+
+            /**
+            * @brief Signals the notification fd, at most once until RunPending drains the queue.
+            */
+            static void Notify() noexcept {
+#if defined(__linux__)
+                const int fd = NotifyFd.load(std::memory_order_acquire);
+                if (fd >= 0 && !NotifyPending.exchange(true)) {
+                    const std::uint64_t one = 1;
+                    [[maybe_unused]] ssize_t written = write(fd, &one, sizeof(one));
+                }
+#endif
+            }
+
+            static void WakeOne(std::unique_lock<std::mutex>& lock) {
+                if (Sleepers != 0) {
+                    for (unsigned int i = 0; i < ThreadCount; i++) {
+                        if (Workers[i].Sleeping) {
+                            WakeWorker(Workers[i]);
+                            break;
+                        }
+                    }
+                    lock.unlock();
+                    return;
+                }
+                if (Handler.Wake == nullptr) {
+                    lock.unlock();
+                    return;
+                }
+                WakePoller(lock);
+            }
         public:
             static void InitalizePool(unsigned int threadCount =  std::thread::hardware_concurrency() - 1) {
-                ThreadCount = std::min(threadCount, std::thread::hardware_concurrency() - 1);
+                {
+                    std::lock_guard<std::mutex> lock(QueueMutex);
+                    if (Running) {
+                        return;
+                    }
+                    Running = true;
+                }
+                //A pool without workers would silently queue work forever.
+                ThreadCount = std::max(1u, std::min(threadCount, std::thread::hardware_concurrency() - 1));
+                {
+                    std::lock_guard<std::mutex> lock(QueueMutex);
+                    Workers = std::make_unique<Worker[]>(ThreadCount);
+                    Mailed = 0;
+                    Queued.store(Queue.size(), std::memory_order_relaxed);
+                }
                 std::cout << ThreadCount <<" Threads Allocated";
+                static bool exitHookRegistered = false;
+                if (!exitHookRegistered) {
+                    //Joinable threads left in a static vector terminate the process on exit.
+                    std::atexit(Shutdown);
+                    exitHookRegistered = true;
+                }
                 for (unsigned int i = 0; i < ThreadCount; i++) {
-                    Threads.emplace_back([]() {
-                        while (true) {
-                            // Wait for a task to be assigned
-                            // Execute the task
+                    Threads.emplace_back(WorkerLoop, i);
+                }
+            }
+
+            /**
+             * @brief Queue work to be run by one of the workers.
+             *
+             * @note Work submitted before the pool is initialized stays queued until it is.
+             * The function must not throw, an escaping exception terminates the worker like it would a std::thread.
+             */
+            static void Submit(std::function<void()> f) {
+                std::unique_lock<std::mutex> lock(QueueMutex);
+                Queue.push_back(std::move(f));
+                Queued.fetch_add(1, std::memory_order_relaxed);
+                WakeOne(lock);
+                Notify();
+            }
+
+            /**
+             * @brief Queue work for one worker in particular, which runs it before the shared queue.
+             *
+             * Other workers steal it if they run out of work while that worker is busy.
+             * Outside a running pool, this is Submit.
+             */
+            static void SubmitTo(unsigned int worker, std::function<void()> f) {
+                std::unique_lock<std::mutex> lock(QueueMutex);
+                if (!Workers || !Running) {
+                    Queue.push_back(std::move(f));
+                    Queued.fetch_add(1, std::memory_order_relaxed);
+                    WakeOne(lock);
+                    Notify();
+                    return;
+                }
+                Worker& target = Workers[worker % ThreadCount];
+                target.Mailbox.push_back(std::move(f));
+                Mailed++;
+                Queued.fetch_add(1, std::memory_order_relaxed);
+                if (target.Sleeping) {
+                    WakeWorker(target);
+                    lock.unlock();
+                }
+                else if (PollerIndex == static_cast<int>(worker % ThreadCount) && Handler.Wake != nullptr) {
+                    WakePoller(lock);
+                }
+                else {
+                    //Busy: let a sleeping worker steal it.
+                    WakeOne(lock);
+                }
+                Notify();
+            }
+
+            /**
+             * @brief Queue work that only the given worker may run, for thread-affine resources it owns.
+             *
+             * Unlike SubmitTo, no other worker steals it, so it waits for that worker even when the others are idle.
+             * Outside a running pool there is no worker to pin it to, it is queued like Submit.
+             */
+            static void SubmitPinned(unsigned int worker, std::function<void()> f) {
+                std::unique_lock<std::mutex> lock(QueueMutex);
+                if (!Workers || !Running) {
+                    Queue.push_back(std::move(f));
+                    Queued.fetch_add(1, std::memory_order_relaxed);
+                    lock.unlock();
+                    Notify();
+                    return;
+                }
+                const unsigned int index = worker % ThreadCount;
+                Worker& target = Workers[index];
+                target.Pinned.push_back(std::move(f));
+                if (target.Sleeping) {
+                    WakeWorker(target);
+                    lock.unlock();
+                }
+                else if (PollerIndex == static_cast<int>(index) && Handler.Wake != nullptr) {
+                    WakePoller(lock);
+                }
+            }
+
+            /**
+             * @brief Takes back a task the caller queued that nobody started yet, found by comparing function objects.
+             *
+             * Looks from the back of the caller's mailbox (on a worker), then of the shared queue.
+             * @return Whether it was found and removed, the caller then runs it or drops it.
+             */
+            template<class Fn>
+            static bool Retract(const Fn& f) {
+                std::lock_guard<std::mutex> lock(QueueMutex);
+                auto take = [&f](std::deque<std::function<void()>>& tasks) {
+                    for (auto it = tasks.rbegin(); it != tasks.rend(); ++it) {
+                        const Fn* target = it->template target<Fn>();
+                        if (target != nullptr && *target == f) {
+                            tasks.erase(std::next(it).base());
+                            Queued.fetch_sub(1, std::memory_order_relaxed);
+                            return true;
                         }
-                        });
+                    }
+                    return false;
+                };
+                if (Workers && WorkerIndex >= 0 && static_cast<unsigned int>(WorkerIndex) < ThreadCount && take(Workers[WorkerIndex].Mailbox)) {
+                    Mailed--;
+                    return true;
+                }
+                return take(Queue);
+            }
+
+            /**
+             * @brief A non-blocking eventfd that becomes readable when work is queued, -1 where eventfd is unavailable.
+             *
+             * Lets an application owning its own epoll loop act as a worker: when the fd is readable, call RunPending.
+             * Don't read the fd yourself, it stays readable until RunPending drains the queue and clears it.
+             * Created on first call, Submit signals it from then on.
+             */
+            static int GetNotificationFd() {
+#if defined(__linux__)
+                std::lock_guard<std::mutex> lock(QueueMutex);
+                if (NotifyFd.load(std::memory_order_relaxed) < 0) {
+                    const int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+                    NotifyFd.store(fd, std::memory_order_release);
+                    if (fd >= 0 && HasWork()) {
+                        //Work queued before anyone listened.
+                        NotifyPending.store(true);
+                        const std::uint64_t one = 1;
+                        [[maybe_unused]] ssize_t written = write(fd, &one, sizeof(one));
+                    }
+                }
+                return NotifyFd.load(std::memory_order_relaxed);
+#else
+                return -1;
+#endif
+            }
+
+            /**
+             * @brief Runs queued work on the calling thread, for event loops acting as a worker.
+             *
+             * Stops after maxTasks tasks, once budget has elapsed or when the queue runs dry.
+             * The notification fd stays signaled while work is left behind and is cleared once the queue is drained.
+             * Works whether or not the pool was initialized, an event loop can be the only worker.
+             *
+             * @return The number of tasks run.
+             */
+            static std::size_t RunPending(std::size_t maxTasks, std::chrono::microseconds budget = std::chrono::microseconds::max()) {
+                const auto start = std::chrono::steady_clock::now();
+                std::size_t ran = 0;
+                std::unique_lock<std::mutex> lock(QueueMutex);
+                std::function<void()> task;
+                while (ran < maxTasks && TakeTask(WorkerIndex, task)) {
+                    IdleHandler handler = Handler;
+                    if (handler.Tick != nullptr) {
+                        HandlerUsers.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    lock.unlock();
+                    task();
+                    task = nullptr;
+                    ran++;
+                    if (handler.Tick != nullptr) {
+                        handler.Tick(false);
+                        HandlerUsers.fetch_sub(1, std::memory_order_release);
+                    }
+                    const bool overBudget = budget != std::chrono::microseconds::max() && std::chrono::steady_clock::now() - start >= budget;
+                    lock.lock();
+                    if (overBudget) {
+                        break;
+                    }
+                }
+                const bool leftover = HasWork();
+                lock.unlock();
+                if (leftover) {
+                    Notify();
+                }
+                else if (NotifyPending.load()) {
+#if defined(__linux__)
+                    std::uint64_t drained;
+                    [[maybe_unused]] ssize_t cleared = read(NotifyFd.load(std::memory_order_acquire), &drained, sizeof(drained));
+#endif
+                    NotifyPending.store(false);
+                    //Submits racing with the clear saw the flag still set and skipped their write.
+                    lock.lock();
+                    const bool raced = HasWork();
+                    lock.unlock();
+                    if (raced) {
+                        Notify();
+                    }
+                }
+                return ran;
+            }
+
+            /**
+             * @brief Installs the handler driven by idle workers, an empty handler uninstalls it.
+             *
+             * @note When uninstalling, returns once no worker is inside the previous handler anymore.
+             */
+            static void SetIdleHandler(const IdleHandler& handler) {
+                IdleHandler previous{};
+                {
+                    std::lock_guard<std::mutex> lock(QueueMutex);
+                    previous = Handler;
+                    Handler = handler;
+                    //Sleeping workers pick up the poller role.
+                    WakeAll();
+                }
+                if (handler.Tick != nullptr || handler.Poll != nullptr) {
+                    return;
+                }
+                while (HandlerUsers.load(std::memory_order_acquire) != 0) {
+                    if (previous.Wake != nullptr) {
+                        previous.Wake();
+                    }
+                    std::this_thread::yield();
+                }
+            }
+
+            /**
+             * @brief Stops the workers once the queued work has been drained and joins them.
+             */
+            static void Shutdown() {
+                {
+                    std::unique_lock<std::mutex> lock(QueueMutex);
+                    if (!Running) {
+                        return;
+                    }
+                    Running = false;
+                    WakeAll();
+                    if (Handler.Wake != nullptr) {
+                        //Off the lock: waking may run completions, which submit work.
+                        void (*wake)() = Handler.Wake;
+                        HandlerUsers.fetch_add(1, std::memory_order_relaxed);
+                        lock.unlock();
+                        wake();
+                        HandlerUsers.fetch_sub(1, std::memory_order_release);
+                    }
                 }
+                for (auto& thread : Threads) {
+                    if (thread.get_id() == std::this_thread::get_id()) {
+                        //Shutdown requested from inside a task, this worker exits once the task returns.
+                        thread.detach();
+                    }
+                    else if (thread.joinable()) {
+                        thread.join();
+                    }
+                }
+                Threads.clear();
+            }
+
+            static bool IsRunning() noexcept {
+                std::lock_guard<std::mutex> lock(QueueMutex);
+                return Running;
+            }
+
+            static inline bool IsWorkerThread() noexcept {
+                return WorkerIndex >= 0;
+            }
+
+            /**
+             * @brief Dense index of the calling worker in [0, GetThreadCount()), -1 when called from outside the pool.
+             */
+            static inline int GetWorkerIndex() noexcept {
+                return WorkerIndex;
+            }
+
+            static inline unsigned int GetThreadCount() noexcept {
+                return ThreadCount;
+            }
+
+            /**
+             * @brief Whether more work could start right now: a worker is idle, or fewer tasks wait than there are workers.
+             *
+             * A racy hint, read without the lock. Spawning code can run work inline instead of queueing it when this is false,
+             * every worker being busy with more queued behind.
+             */
+            static inline bool IsHungry() noexcept {
+                return Sleepers.load(std::memory_order_relaxed) != 0 || PollerSleeping.load(std::memory_order_relaxed)
+                    || Queued.load(std::memory_order_relaxed) < ThreadCount;
             }
-        }; 
-}
\ No newline at end of file
+        };
+}
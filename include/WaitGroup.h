@@ -7,6 +7,7 @@
 #include <thread>
 #include <string>
 #include "Concept.h"
+#include "Fiber.h"
 
 namespace StreamLine {
 
@@ -92,9 +93,10 @@ namespace StreamLine {
     class WaitGroup {
     private:
         mutable std::atomic<unsigned int> count{ 0 };            // Counter for tracking the number of tasks
-        std::thread::id owner = std::this_thread::get_id(); // ID of the thread that created the WaitGroup
+        const void* owner = Fiber::ExecutionId(); // ID of the thread (or fiber) that created the WaitGroup
         mutable mutex mtx;                         // Mutex for coordinating condition variable
         mutable std::condition_variable cv;             // Condition variable for wait signaling
+        mutable FiberWaitList fiberWaiters;             // Parked owner fiber, guarded by mtx
         std::atomic<bool> waiting{ false };     // Flag to prevent multiple waits
 
         //For reset.
@@ -110,7 +112,7 @@ namespace StreamLine {
         // Increment the counter, No other thread besides the creating thread can Add.
         // If called after Waiting has started WaitGroupUseAfterWait exception will be thrown.
         void Add(int n) {
-            if (std::this_thread::get_id() != owner) {
+            if (Fiber::ExecutionId() != owner) {
                 throw WaitGroupOwnershipException();
             }
             if (waiting) {
@@ -130,7 +132,7 @@ namespace StreamLine {
          * @param ex if ex is not NULL, the waitgroup is considered not successful.
          */
         void Done()const noexcept {
-            if (std::this_thread::get_id() == owner) {
+            if (Fiber::ExecutionId() == owner) {
 #ifdef DEBUG
                 //Reaching this is a API design violation, but yeah, safeguards. safeguards.
                 std::cout << "Done is called by the owner, This is not the correct usage of WaitGroup\n";
@@ -138,6 +140,8 @@ namespace StreamLine {
                 return;
             }
             if (count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<mutex> lock(mtx);
+                fiberWaiters.WakeAll();
                 cv.notify_all();  // Notify waiting threads
             }
         }
@@ -162,7 +166,7 @@ namespace StreamLine {
             WaitGroup new_wg;
 
             // Transfer ownership to current thread
-            new_wg.owner = std::this_thread::get_id();
+            new_wg.owner = Fiber::ExecutionId();
 
             std::unique_lock<mutex> lock(original.mtx);
 
@@ -182,7 +186,7 @@ namespace StreamLine {
 
         // Wait for the counter to reach zero, this will never throw on the main thread.
         void Wait() {
-            if (std::this_thread::get_id() != owner) {
+            if (Fiber::ExecutionId() != owner) {
                 //Only owner thread can wait (to avoid deadlocks).
                 throw WaitGroupOwnershipException();
             }
@@ -196,6 +200,13 @@ namespace StreamLine {
                 //return;
             }
             std::unique_lock<mutex> lock(mtx);
+            if (Fiber::Current() != nullptr) {
+                // Park the fiber instead of the worker running it.
+                while (count.load(std::memory_order_acquire) != 0) {
+                    fiberWaiters.Park(lock);
+                }
+                return;
+            }
             cv.wait(lock, [&] { return count.load(std::memory_order_acquire) == 0; });
             // Reset the waiting flag after the wait is done, out of precaution.
             //waiting.store(false, std::memory_order_release);
@@ -203,7 +214,7 @@ namespace StreamLine {
 
         [[nodiscard]]
         bool WaitFor(std::chrono::milliseconds timeout) {
-            if (std::this_thread::get_id() != owner) {
+            if (Fiber::ExecutionId() != owner) {
                 throw WaitGroupOwnershipException();
             }
 
@@ -212,6 +223,17 @@ namespace StreamLine {
                 throw std::runtime_error("WaitGroup instance is one-use only.");
             }
 
+            if (Fiber::Current() != nullptr) {
+                // No timed parking yet, keep yielding the fiber so the worker stays available.
+                const auto deadline = std::chrono::steady_clock::now() + timeout;
+                while (count.load(std::memory_order_acquire) != 0) {
+                    if (std::chrono::steady_clock::now() >= deadline) {
+                        return false;
+                    }
+                    Fiber::Yield();
+                }
+                return true;
+            }
             std::unique_lock<mutex> lock(mtx);
             bool success = cv.wait_for(lock, timeout, [&] {
                 return count.load(std::memory_order_acquire) == 0;
@@ -223,7 +245,7 @@ namespace StreamLine {
         }
 
         void Reset() {
-            if (owner != std::this_thread::get_id()) {
+            if (owner != Fiber::ExecutionId()) {
                 throw WaitGroupOwnershipException();
             }
 
@@ -0,0 +1,333 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "ThreadPool.h"
+
+namespace StreamLine{
+    /** \addtogroup Stream
+     *  @{
+     */
+
+    /// @brief Event time, in whatever unit the stream uses (ms since epoch, sequence numbers...).
+    using EventTime = std::int64_t;
+
+    enum class WindowKind : unsigned int{
+        Tumbling, Sliding, Session
+    };
+
+    /**
+     * @brief Describes how events are grouped in windows, build it with Tumbling, Sliding or Session.
+     */
+    struct WindowSpec{
+        WindowKind Kind = WindowKind::Tumbling;
+        /// @brief Window length, for tumbling and sliding windows.
+        EventTime Size = 1;
+        /// @brief Distance between the starts of two sliding windows.
+        EventTime Slide = 1;
+        /// @brief Inactivity closing a session.
+        EventTime Gap = 1;
+
+        static WindowSpec Tumbling(EventTime size) {
+            return WindowSpec{ WindowKind::Tumbling, size, size, 0 };
+        }
+        static WindowSpec Sliding(EventTime size, EventTime slide) {
+            return WindowSpec{ WindowKind::Sliding, size, slide, 0 };
+        }
+        static WindowSpec Session(EventTime gap) {
+            return WindowSpec{ WindowKind::Session, 0, 0, gap };
+        }
+    };
+
+    /// @brief [Start, End) in event time.
+    struct WindowBounds{
+        EventTime Start;
+        EventTime End;
+    };
+
+    /**
+     * @brief Aggregates a keyed event stream over event-time windows, on the ThreadPool.
+     *
+     * Keys are partitioned by hash, and each partition is processed by one task at a time.
+     * A partition's windows are therefore only touched by one thread at a time and need no locks, producers only
+     * briefly lock the partition's inbox. A window [Start, End) is emitted once the watermark reaches End,
+     * events falling only in windows that were already emitted are late and dropped.
+     *
+     * fold(acc, value) adds an event to a window's accumulator, which starts as a copy of initial.
+     * Session windows that grow into each other are combined with merge(acc, other), required for sessions.
+     * emit(key, bounds, acc) runs on the partition's worker.
+     *
+     * @note A watermark applies to the events pushed before it. Events racing with AdvanceWatermark may be
+     * counted in or out of the windows it closes.
+     *
+     * Example usage:
+     * @code
+     * WindowedAggregator<std::string, double, double> rollup(WindowSpec::Tumbling(1000), 0.0,
+     *     [](double& sum, const double& v) { sum += v; }, nullptr,
+     *     [](const std::string& key, WindowBounds w, double&& sum) { Publish(key, w.Start, sum); });
+     * rollup.Push("cpu", timestamp, 0.5);
+     * rollup.AdvanceWatermark(timestamp - 5000);
+     * @endcode
+     */
+    template<class Key, class Value, class Acc, class Hash = std::hash<Key>>
+    class WindowedAggregator{
+    public:
+        using Fold = std::function<void(Acc&, const Value&)>;
+        using Merge = std::function<void(Acc&, const Acc&)>;
+        using Emit = std::function<void(const Key&, WindowBounds, Acc&&)>;
+    private:
+        struct Event{
+            Key key;
+            EventTime time;
+            Value value;
+        };
+
+        struct Window{
+            WindowBounds bounds;
+            Acc acc;
+        };
+
+        struct alignas(64) Partition{
+            std::mutex mtx;
+            std::vector<Event> inbox;
+            EventTime watermark = std::numeric_limits<EventTime>::min();
+            bool scheduled = false;
+
+            //Owned by the partition's running task.
+            std::unordered_map<Key, std::vector<Window>, Hash> keys;
+            std::vector<Event> work;
+            EventTime applied = std::numeric_limits<EventTime>::min();
+            EventTime earliestEnd = std::numeric_limits<EventTime>::max();
+        };
+
+        WindowSpec spec;
+        Acc initial;
+        Fold fold;
+        Merge merge;
+        Emit emit;
+        Hash hash;
+        std::unique_ptr<Partition[]> partitions;
+        std::size_t count;
+        std::atomic<std::size_t> pending{ 0 };
+        std::atomic<std::uint64_t> late{ 0 };
+
+        static EventTime FloorTo(EventTime time, EventTime step) noexcept {
+            const EventTime rest = time % step;
+            return time - (rest < 0 ? rest + step : rest);
+        }
+
+        std::size_t PartitionOf(const Key& key) const {
+            //Spread poor hashes (identity for integers) before taking the modulo.
+            const std::uint64_t h = static_cast<std::uint64_t>(hash(key)) * 0x9E3779B97F4A7C15ull;
+            return static_cast<std::size_t>((h >> 32) % count);
+        }
+
+        void Schedule(std::size_t index) {
+            pending.fetch_add(1, std::memory_order_relaxed);
+            ThreadPool::Submit([this, index]() { Run(index); });
+        }
+
+        /// @brief Folds value into its window, false if that window was already emitted.
+        bool Add(Partition& p, std::vector<Window>& windows, WindowBounds bounds, const Value& value) {
+            if (bounds.End <= p.applied) {
+                return false;
+            }
+            auto it = std::find_if(windows.begin(), windows.end(), [&](const Window& w) { return w.bounds.Start >= bounds.Start; });
+            if (it == windows.end() || it->bounds.Start != bounds.Start) {
+                it = windows.insert(it, Window{ bounds, initial });
+                p.earliestEnd = std::min(p.earliestEnd, bounds.End);
+            }
+            fold(it->acc, value);
+            return true;
+        }
+
+        bool AddSession(Partition& p, std::vector<Window>& windows, EventTime time, const Value& value) {
+            Window session{ WindowBounds{ time, time + spec.Gap }, initial };
+            if (session.bounds.End <= p.applied) {
+                return false;
+            }
+            fold(session.acc, value);
+            //Absorb every session the new one overlaps.
+            auto it = windows.begin();
+            while (it != windows.end()) {
+                if (it->bounds.Start < session.bounds.End && session.bounds.Start < it->bounds.End) {
+                    session.bounds.Start = std::min(session.bounds.Start, it->bounds.Start);
+                    session.bounds.End = std::max(session.bounds.End, it->bounds.End);
+                    merge(it->acc, session.acc);
+                    session.acc = std::move(it->acc);
+                    it = windows.erase(it);
+                    continue;
+                }
+                ++it;
+            }
+            it = std::find_if(windows.begin(), windows.end(), [&](const Window& w) { return w.bounds.Start > session.bounds.Start; });
+            p.earliestEnd = std::min(p.earliestEnd, session.bounds.End);
+            windows.insert(it, std::move(session));
+            return true;
+        }
+
+        void Insert(Partition& p, Event& event) {
+            std::vector<Window>& windows = p.keys[event.key];
+            bool added = false;
+            switch (spec.Kind) {
+            case WindowKind::Tumbling: {
+                const EventTime start = FloorTo(event.time, spec.Size);
+                added = Add(p, windows, WindowBounds{ start, start + spec.Size }, event.value);
+                break;
+            }
+            case WindowKind::Sliding:
+                for (EventTime start = FloorTo(event.time, spec.Slide); start > event.time - spec.Size; start -= spec.Slide) {
+                    added |= Add(p, windows, WindowBounds{ start, start + spec.Size }, event.value);
+                }
+                break;
+            case WindowKind::Session:
+                added = AddSession(p, windows, event.time, event.value);
+                break;
+            }
+            //Late once per event, and only if none of its windows were still open.
+            if (!added) {
+                late.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (windows.empty()) {
+                p.keys.erase(event.key);
+            }
+        }
+
+        /// @brief Emits the windows the watermark went past.
+        void Fire(Partition& p) {
+            if (p.applied < p.earliestEnd) {
+                return;
+            }
+            p.earliestEnd = std::numeric_limits<EventTime>::max();
+            for (auto it = p.keys.begin(); it != p.keys.end();) {
+                std::vector<Window>& windows = it->second;
+                auto open = std::stable_partition(windows.begin(), windows.end(), [&](const Window& w) { return w.bounds.End <= p.applied; });
+                for (auto w = windows.begin(); w != open; ++w) {
+                    emit(it->first, w->bounds, std::move(w->acc));
+                }
+                windows.erase(windows.begin(), open);
+                for (const Window& w : windows) {
+                    p.earliestEnd = std::min(p.earliestEnd, w.bounds.End);
+                }
+                it = windows.empty() ? p.keys.erase(it) : std::next(it);
+            }
+        }
+
+        void Run(std::size_t index) {
+            Partition& p = partitions[index];
+            while (true) {
+                EventTime watermark;
+                {
+                    std::lock_guard<std::mutex> lock(p.mtx);
+                    watermark = p.watermark;
+                    if (p.inbox.empty() && watermark == p.applied) {
+                        p.scheduled = false;
+                        break;
+                    }
+                    p.work.swap(p.inbox);
+                }
+                for (Event& event : p.work) {
+                    Insert(p, event);
+                }
+                p.work.clear();
+                if (watermark > p.applied) {
+                    p.applied = watermark;
+                    Fire(p);
+                }
+            }
+            pending.fetch_sub(1, std::memory_order_release);
+        }
+    public:
+        /**
+         * @param partitionCount Independent partitions, 0 for one per worker.
+         * @throws std::invalid_argument for a non-positive window size, slide or gap, or a session spec without merge.
+         */
+        WindowedAggregator(const WindowSpec& windowSpec, Acc initialValue, Fold foldFunction, Merge mergeFunction, Emit emitFunction,
+            std::size_t partitionCount = 0, Hash keyHash = Hash())
+            : spec(windowSpec), initial(std::move(initialValue)), fold(std::move(foldFunction)), merge(std::move(mergeFunction)),
+            emit(std::move(emitFunction)), hash(std::move(keyHash)) {
+            const bool valid = spec.Kind == WindowKind::Session ? spec.Gap > 0 && merge != nullptr : spec.Size > 0 && spec.Slide > 0;
+            if (!valid) {
+                throw std::invalid_argument("Invalid window specification");
+            }
+            count = partitionCount != 0 ? partitionCount : std::max(1u, ThreadPool::GetThreadCount());
+            partitions = std::make_unique<Partition[]>(count);
+        }
+
+        /// @brief Waits for the partition tasks, open windows are dropped, Close emits them.
+        ~WindowedAggregator() {
+            Wait();
+        }
+
+        WindowedAggregator(const WindowedAggregator&) = delete;
+        WindowedAggregator& operator=(const WindowedAggregator&) = delete;
+
+        void Push(Key key, EventTime time, Value value) {
+            const std::size_t index = PartitionOf(key);
+            Partition& p = partitions[index];
+            {
+                std::lock_guard<std::mutex> lock(p.mtx);
+                p.inbox.push_back(Event{ std::move(key), time, std::move(value) });
+                if (p.scheduled) {
+                    return;
+                }
+                p.scheduled = true;
+            }
+            Schedule(index);
+        }
+
+        /**
+         * @brief Declares that no event older than watermark will be pushed anymore, windows ending by then are emitted.
+         * Watermarks only move forward, an older one is ignored.
+         */
+        void AdvanceWatermark(EventTime watermark) {
+            for (std::size_t i = 0; i < count; i++) {
+                Partition& p = partitions[i];
+                {
+                    std::lock_guard<std::mutex> lock(p.mtx);
+                    if (watermark <= p.watermark) {
+                        continue;
+                    }
+                    p.watermark = watermark;
+                    if (p.scheduled) {
+                        continue;
+                    }
+                    p.scheduled = true;
+                }
+                Schedule(i);
+            }
+        }
+
+        /**
+         * @brief Returns once everything pushed so far was processed, helping with queued pool work meanwhile.
+         */
+        void Wait() {
+            while (pending.load(std::memory_order_acquire) != 0) {
+                if (ThreadPool::RunPending(1) == 0) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        /// @brief Emits every open window and waits for it, later events are late.
+        void Close() {
+            AdvanceWatermark(std::numeric_limits<EventTime>::max());
+            Wait();
+        }
+
+        /// @brief Events dropped for arriving after their windows were emitted.
+        std::uint64_t GetLateCount() const noexcept {
+            return late.load(std::memory_order_relaxed);
+        }
+    };
+    ///@}
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include "ThreadPool.h"
+
+namespace StreamLine{
+    /** \addtogroup Parallel
+     *  @{
+     */
+
+    /**
+     * @brief One T per thread, for accumulating without contention and combining at the end.
+     *
+     * Workers index a dense array of cache-line-aligned slots by their worker index, so Local() is a load and
+     * a branch. Threads outside the pool (and workers started after construction) get slots of their own
+     * through a locked map. Slots are constructed on first use, by factory or by default.
+     *
+     * Example usage:
+     * @code
+     * WorkerLocal<std::array<std::size_t, 256>> histograms;
+     * ParallelFor(0, n, 0, [&](std::size_t first, std::size_t last) {
+     *     auto& counts = histograms.Local();
+     *     for (std::size_t i = first; i < last; i++) {
+     *         counts[bytes[i]]++;
+     *     }
+     * });
+     * histograms.ForEach([&](const auto& counts) { Add(total, counts); });
+     * @endcode
+     *
+     * @note ForEach, Combine and Clear must not race with Local. A fiber must not keep the reference
+     * across a yield, it may resume on another worker.
+     */
+    template<class T>
+    class WorkerLocal{
+    private:
+        struct alignas(64) Slot{
+            std::optional<T> value;
+        };
+
+        std::function<T()> factory;
+        std::unique_ptr<Slot[]> slots;
+        std::size_t count;
+        std::mutex mtx;
+        std::unordered_map<std::thread::id, std::unique_ptr<Slot>> others;
+
+        T& Construct(Slot& slot) {
+            if (factory) {
+                slot.value.emplace(factory());
+            }
+            else {
+                slot.value.emplace();
+            }
+            return *slot.value;
+        }
+
+        T& OtherLocal() {
+            std::lock_guard<std::mutex> lock(mtx);
+            std::unique_ptr<Slot>& slot = others[std::this_thread::get_id()];
+            if (!slot) {
+                slot = std::make_unique<Slot>();
+            }
+            return slot->value ? *slot->value : Construct(*slot);
+        }
+    public:
+        /// @brief Slots are default-constructed.
+        WorkerLocal() : count(ThreadPool::GetThreadCount()) {
+            slots = std::make_unique<Slot[]>(count);
+        }
+
+        /// @brief Slots are constructed from factory(), called on the thread first using them.
+        explicit WorkerLocal(std::function<T()> slotFactory) : WorkerLocal() {
+            factory = std::move(slotFactory);
+        }
+
+        WorkerLocal(const WorkerLocal&) = delete;
+        WorkerLocal& operator=(const WorkerLocal&) = delete;
+
+        /// @brief The calling thread's T, constructed on the first call.
+        T& Local() {
+            const int worker = ThreadPool::GetWorkerIndex();
+            if (worker >= 0 && static_cast<std::size_t>(worker) < count) {
+                Slot& slot = slots[static_cast<std::size_t>(worker)];
+                return slot.value ? *slot.value : Construct(slot);
+            }
+            return OtherLocal();
+        }
+
+        /// @brief Calls f(T&) on every constructed slot.
+        template<class F>
+        void ForEach(F&& f) {
+            for (std::size_t i = 0; i < count; i++) {
+                if (slots[i].value) {
+                    f(*slots[i].value);
+                }
+            }
+            std::lock_guard<std::mutex> lock(mtx);
+            for (auto& [id, slot] : others) {
+                if (slot->value) {
+                    f(*slot->value);
+                }
+            }
+        }
+
+        /// @brief Folds the constructed slots with op(T, T) -> T, T() when there are none.
+        template<class Op>
+        T Combine(Op&& op) {
+            std::optional<T> result;
+            ForEach([&](T& value) {
+                if (result) {
+                    result.emplace(op(std::move(*result), value));
+                }
+                else {
+                    result.emplace(value);
+                }
+            });
+            return result ? std::move(*result) : T();
+        }
+
+        /// @brief Slots constructed so far.
+        std::size_t Size() {
+            std::size_t constructed = 0;
+            ForEach([&](T&) { constructed++; });
+            return constructed;
+        }
+
+        /// @brief Destroys every slot, the next Local constructs them again.
+        void Clear() {
+            for (std::size_t i = 0; i < count; i++) {
+                slots[i].value.reset();
+            }
+            std::lock_guard<std::mutex> lock(mtx);
+            others.clear();
+        }
+    };
+    ///@}
+}
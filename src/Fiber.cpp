@@ -0,0 +1,348 @@
+#include "Fiber.h"
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <utility>
+
+#if defined(_MSC_VER)
+#define STREAMLINE_NOINLINE __declspec(noinline)
+#else
+#define STREAMLINE_NOINLINE __attribute__((noinline))
+#endif
+
+#if STREAMLINE_FIBERS_SUPPORTED
+#include <sys/mman.h>
+#include <unistd.h>
+
+extern "C" void streamline_switch_context(void** from, void* to);
+extern "C" void streamline_fiber_trampoline();
+
+#if defined(__APPLE__)
+#define STREAMLINE_ASM_FUNCTION(name) ".globl _" #name "\n_" #name ":\n"
+#else
+#define STREAMLINE_ASM_FUNCTION(name) ".globl " #name "\n.type " #name ", %function\n" #name ":\n"
+#endif
+
+//Saves the callee-saved registers on the current stack, stores the stack pointer in *from,
+//then restores the registers saved on the `to` stack and returns into it.
+//The trampoline is the first return address of a new fiber, it calls entry(arg) with both taken from the initial frame.
+#if defined(__x86_64__)
+__asm__(
+    ".text\n"
+    ".p2align 4\n"
+    STREAMLINE_ASM_FUNCTION(streamline_switch_context)
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    subq $16, %rsp\n"
+    "    stmxcsr 8(%rsp)\n"
+    "    fnstcw (%rsp)\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    ldmxcsr 8(%rsp)\n"
+    "    fldcw (%rsp)\n"
+    "    addq $16, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".p2align 4\n"
+    STREAMLINE_ASM_FUNCTION(streamline_fiber_trampoline)
+    "    movq %r12, %rdi\n"
+    "    callq *%r13\n"
+    "    ud2\n"
+);
+#elif defined(__aarch64__)
+__asm__(
+    ".text\n"
+    ".p2align 4\n"
+    STREAMLINE_ASM_FUNCTION(streamline_switch_context)
+    "    sub sp, sp, #160\n"
+    "    stp x19, x20, [sp, #0]\n"
+    "    stp x21, x22, [sp, #16]\n"
+    "    stp x23, x24, [sp, #32]\n"
+    "    stp x25, x26, [sp, #48]\n"
+    "    stp x27, x28, [sp, #64]\n"
+    "    stp x29, x30, [sp, #80]\n"
+    "    stp d8, d9, [sp, #96]\n"
+    "    stp d10, d11, [sp, #112]\n"
+    "    stp d12, d13, [sp, #128]\n"
+    "    stp d14, d15, [sp, #144]\n"
+    "    mov x9, sp\n"
+    "    str x9, [x0]\n"
+    "    mov sp, x1\n"
+    "    ldp x19, x20, [sp, #0]\n"
+    "    ldp x21, x22, [sp, #16]\n"
+    "    ldp x23, x24, [sp, #32]\n"
+    "    ldp x25, x26, [sp, #48]\n"
+    "    ldp x27, x28, [sp, #64]\n"
+    "    ldp x29, x30, [sp, #80]\n"
+    "    ldp d8, d9, [sp, #96]\n"
+    "    ldp d10, d11, [sp, #112]\n"
+    "    ldp d12, d13, [sp, #128]\n"
+    "    ldp d14, d15, [sp, #144]\n"
+    "    add sp, sp, #160\n"
+    "    ret\n"
+    ".p2align 4\n"
+    STREAMLINE_ASM_FUNCTION(streamline_fiber_trampoline)
+    "    mov x0, x19\n"
+    "    blr x20\n"
+    "    brk #0\n"
+);
+#endif
+#endif
+
+namespace StreamLine{
+    namespace {
+        //Only touched through the out of line accessors below, a fiber can resume on another thread
+        //and the compiler must not reuse a thread local address computed before the switch.
+        thread_local Fiber* currentFiber = nullptr;
+        thread_local const char threadTag = 0;
+
+#if STREAMLINE_FIBERS_SUPPORTED
+        std::mutex stackMutex;
+        std::vector<FiberStack> freeStacks;
+        std::size_t maxCachedStacks = 1024;
+        std::size_t maxGuardedStacks = 16384;
+        std::size_t guardedStacks = 0; // Mapped guard-paged stacks, cached ones included.
+
+        std::size_t PageSize() noexcept {
+            static const std::size_t size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+            return size;
+        }
+
+        void UnmapStack(const FiberStack& stack) noexcept {
+            munmap(stack.Base, stack.Size);
+            if (stack.Guarded) {
+                std::lock_guard<std::mutex> lock(stackMutex);
+                guardedStacks--;
+            }
+        }
+#endif
+    }
+
+#if STREAMLINE_FIBERS_SUPPORTED
+    FiberStack FiberStackPool::Acquire(std::size_t size, bool lazy, bool guard) {
+        const std::size_t page = PageSize();
+        const std::size_t mapping = ((size + page - 1) / page) * page + (guard ? page : 0);
+        {
+            std::lock_guard<std::mutex> lock(stackMutex);
+            for (auto it = freeStacks.rbegin(); it != freeStacks.rend(); ++it) {
+                if (it->Size == mapping && it->Lazy == lazy && it->Guarded == guard) {
+                    FiberStack stack = *it;
+                    *it = freeStacks.back();
+                    freeStacks.pop_back();
+                    return stack;
+                }
+            }
+            if (guard) {
+                //Unguarded stacks past the budget would turn an overflow into silent corruption.
+                if (guardedStacks >= maxGuardedStacks) {
+                    throw std::bad_alloc();
+                }
+                guardedStacks++;
+            }
+        }
+        //Pages are committed on first touch: most fibers only ever use a few of them.
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_STACK
+        flags |= MAP_STACK;
+#endif
+        if (lazy) {
+#ifdef MAP_NORESERVE
+            flags |= MAP_NORESERVE;
+#endif
+        }
+        FiberStack stack{ nullptr, mapping, lazy, guard };
+        stack.Base = mmap(nullptr, mapping, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (stack.Base == MAP_FAILED) {
+            stack.Base = nullptr;
+        }
+        else if (guard && mprotect(stack.Base, page, PROT_NONE) != 0) {
+            munmap(stack.Base, mapping);
+            stack.Base = nullptr;
+        }
+        if (stack.Base == nullptr) {
+            if (guard) {
+                std::lock_guard<std::mutex> lock(stackMutex);
+                guardedStacks--;
+            }
+            throw std::bad_alloc();
+        }
+        return stack;
+    }
+
+    void FiberStackPool::Release(const FiberStack& stack) noexcept {
+        if (stack.Lazy) {
+            //Hand the committed pages back, the reservation itself is kept for reuse.
+            const std::size_t guard = stack.Guarded ? PageSize() : 0;
+            madvise(static_cast<char*>(stack.Base) + guard, stack.Size - guard, MADV_DONTNEED);
+        }
+        {
+            std::lock_guard<std::mutex> lock(stackMutex);
+            if (freeStacks.size() < maxCachedStacks) {
+                freeStacks.push_back(stack);
+                return;
+            }
+        }
+        UnmapStack(stack);
+    }
+
+    void FiberStackPool::SetMaxCached(std::size_t count) noexcept {
+        std::lock_guard<std::mutex> lock(stackMutex);
+        maxCachedStacks = count;
+    }
+
+    void FiberStackPool::SetMaxGuarded(std::size_t count) noexcept {
+        std::lock_guard<std::mutex> lock(stackMutex);
+        maxGuardedStacks = count;
+    }
+
+    void FiberStackPool::Trim() noexcept {
+        std::vector<FiberStack> stacks;
+        {
+            std::lock_guard<std::mutex> lock(stackMutex);
+            stacks.swap(freeStacks);
+        }
+        for (const FiberStack& stack : stacks) {
+            UnmapStack(stack);
+        }
+    }
+
+    Fiber::Fiber(std::function<void()>&& f, const FiberStack& s) : stack(s), body(std::move(f)) {
+        //The fiber object lives at the top of its own stack, the initial frame sits right below it.
+        std::uintptr_t top = reinterpret_cast<std::uintptr_t>(this) & ~static_cast<std::uintptr_t>(15);
+        auto* frame = reinterpret_cast<std::uintptr_t*>(top);
+#if defined(__x86_64__)
+        *--frame = 0; //Padding, the trampoline starts with a 16 byte aligned stack.
+        *--frame = 0;
+        *--frame = reinterpret_cast<std::uintptr_t>(&streamline_fiber_trampoline);
+        *--frame = 0; //rbp
+        *--frame = 0; //rbx
+        *--frame = reinterpret_cast<std::uintptr_t>(this); //r12
+        *--frame = reinterpret_cast<std::uintptr_t>(&Fiber::Entry); //r13
+        *--frame = 0; //r14
+        *--frame = 0; //r15
+        *--frame = 0x1F80; //Default MXCSR
+        *--frame = 0x037F; //Default x87 control word
+#elif defined(__aarch64__)
+        frame -= 20;
+        for (int i = 0; i < 20; i++) {
+            frame[i] = 0;
+        }
+        frame[0] = reinterpret_cast<std::uintptr_t>(this); //x19
+        frame[1] = reinterpret_cast<std::uintptr_t>(&Fiber::Entry); //x20
+        frame[11] = reinterpret_cast<std::uintptr_t>(&streamline_fiber_trampoline); //x30
+#endif
+        sp = frame;
+    }
+
+    void Fiber::Entry(void* self) noexcept {
+        Fiber* fiber = static_cast<Fiber*>(self);
+        try {
+            fiber->body();
+        }
+        catch (...) {
+            std::terminate();
+        }
+        //Release the captures while still on the fiber's stack.
+        fiber->body = nullptr;
+        fiber->finished = true;
+        streamline_switch_context(&fiber->sp, fiber->callerSp);
+    }
+
+    void Fiber::Resume() {
+        Fiber* previous = std::exchange(currentFiber, this);
+        streamline_switch_context(&callerSp, sp);
+        currentFiber = previous;
+        if (finished) {
+            FiberStack s = stack;
+            this->~Fiber();
+            FiberStackPool::Release(s);
+            return;
+        }
+        void (*action)(void*) = std::exchange(afterSwitch, nullptr);
+        void* arg = afterSwitchArg;
+        //The fiber may be resumed elsewhere as soon as the action runs, don't touch it afterwards.
+        if (action != nullptr) {
+            action(arg);
+        }
+    }
+
+    void Fiber::Spawn(std::function<void()> f, const FiberOptions& options) {
+        if (!ThreadPool::IsRunning()) {
+            throw InvalidOperation();
+        }
+        FiberStack stack = FiberStackPool::Acquire(options.StackSize, options.LazyCommit, options.GuardPage);
+        void* slot = static_cast<char*>(stack.Top()) - ((sizeof(Fiber) + 15) & ~static_cast<std::size_t>(15));
+        Fiber* fiber;
+        try {
+            fiber = new (slot) Fiber(std::move(f), stack);
+        }
+        catch (...) {
+            FiberStackPool::Release(stack);
+            throw;
+        }
+        fiber->Unpark();
+    }
+
+    void Fiber::Park(void (*action)(void*), void* arg) {
+        Fiber* self = Current();
+        if (self == nullptr) {
+            throw InvalidOperation();
+        }
+        self->afterSwitch = action;
+        self->afterSwitchArg = arg;
+        streamline_switch_context(&self->sp, self->callerSp);
+    }
+#else
+    FiberStack FiberStackPool::Acquire(std::size_t, bool, bool) {
+        throw InvalidOperation();
+    }
+    void FiberStackPool::Release(const FiberStack&) noexcept {}
+    void FiberStackPool::SetMaxCached(std::size_t) noexcept {}
+    void FiberStackPool::SetMaxGuarded(std::size_t) noexcept {}
+    void FiberStackPool::Trim() noexcept {}
+
+    void Fiber::Spawn(std::function<void()>, const FiberOptions&) {
+        throw InvalidOperation();
+    }
+
+    void Fiber::Park(void (*)(void*), void*) {
+        throw InvalidOperation();
+    }
+
+    void Fiber::Resume() {}
+#endif
+
+    STREAMLINE_NOINLINE Fiber* Fiber::Current() noexcept {
+        return currentFiber;
+    }
+
+    STREAMLINE_NOINLINE const void* Fiber::ExecutionId() noexcept {
+        if (currentFiber != nullptr) {
+            return currentFiber;
+        }
+        return &threadTag;
+    }
+
+    void Fiber::Yield() {
+        if (Current() != nullptr) {
+            Park([](void* self) noexcept { static_cast<Fiber*>(self)->Unpark(); }, Current());
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+
+    void Fiber::Unpark() {
+        ThreadPool::Submit([this]() { Resume(); });
+    }
+}
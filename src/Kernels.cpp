@@ -0,0 +1,316 @@
+#include "Kernels.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string_view>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define STREAMLINE_KERNELS_X86 1
+#include <immintrin.h>
+#else
+#define STREAMLINE_KERNELS_X86 0
+#endif
+
+namespace StreamLine::Kernels{
+    namespace{
+        template<CompareOp Op, class T>
+        inline bool Compare(T a, T b) noexcept {
+            if constexpr (Op == CompareOp::Equal) return a == b;
+            else if constexpr (Op == CompareOp::NotEqual) return a != b;
+            else if constexpr (Op == CompareOp::Less) return a < b;
+            else if constexpr (Op == CompareOp::LessEqual) return a <= b;
+            else if constexpr (Op == CompareOp::Greater) return a > b;
+            else return a >= b;
+        }
+
+        //MurmurHash3's 64-bit finalizer.
+        constexpr std::uint64_t MixFirst = 0xff51afd7ed558ccdull;
+        constexpr std::uint64_t MixSecond = 0xc4ceb9fe1a85ec53ull;
+
+        inline std::uint64_t Mix(std::uint64_t x) noexcept {
+            x ^= x >> 33;
+            x *= MixFirst;
+            x ^= x >> 33;
+            x *= MixSecond;
+            x ^= x >> 33;
+            return x;
+        }
+
+        template<class T>
+        inline std::uint64_t BitsOf(T value) noexcept {
+            if constexpr (sizeof(T) == 4) {
+                return std::bit_cast<std::uint32_t>(value);
+            }
+            else {
+                return std::bit_cast<std::uint64_t>(value);
+            }
+        }
+
+        namespace Scalar{
+            template<CompareOp Op, class T>
+            std::size_t SelectOp(const T* values, std::size_t count, T value, std::uint32_t* out, std::uint32_t base) noexcept {
+                std::size_t selected = 0;
+                for (std::size_t i = 0; i < count; i++) {
+                    //Branch-free: the index is always written, and kept when the comparison holds.
+                    out[selected] = base + static_cast<std::uint32_t>(i);
+                    selected += Compare<Op>(values[i], value);
+                }
+                return selected;
+            }
+
+            template<class T>
+            std::size_t Select(const T* values, std::size_t count, CompareOp op, T value, std::uint32_t* out, std::uint32_t base) noexcept {
+                switch (op) {
+                case CompareOp::Equal: return SelectOp<CompareOp::Equal>(values, count, value, out, base);
+                case CompareOp::NotEqual: return SelectOp<CompareOp::NotEqual>(values, count, value, out, base);
+                case CompareOp::Less: return SelectOp<CompareOp::Less>(values, count, value, out, base);
+                case CompareOp::LessEqual: return SelectOp<CompareOp::LessEqual>(values, count, value, out, base);
+                case CompareOp::Greater: return SelectOp<CompareOp::Greater>(values, count, value, out, base);
+                default: return SelectOp<CompareOp::GreaterEqual>(values, count, value, out, base);
+                }
+            }
+
+            template<class T>
+            void Gather(const T* values, const std::uint32_t* selection, std::size_t count, T* out) noexcept {
+                for (std::size_t i = 0; i < count; i++) {
+                    out[i] = values[selection[i]];
+                }
+            }
+
+            template<class T>
+            SumType<T> Sum(const T* values, std::size_t count) noexcept {
+                SumType<T> total = 0;
+                for (std::size_t i = 0; i < count; i++) {
+                    total += static_cast<SumType<T>>(values[i]);
+                }
+                return total;
+            }
+
+            template<class T>
+            T Min(const T* values, std::size_t count) noexcept {
+                T result = std::numeric_limits<T>::max();
+                for (std::size_t i = 0; i < count; i++) {
+                    result = std::min(result, values[i]);
+                }
+                return result;
+            }
+
+            template<class T>
+            T Max(const T* values, std::size_t count) noexcept {
+                T result = std::numeric_limits<T>::lowest();
+                for (std::size_t i = 0; i < count; i++) {
+                    result = std::max(result, values[i]);
+                }
+                return result;
+            }
+
+            template<class T>
+            void Hash(const T* values, std::size_t count, std::uint64_t* out) noexcept {
+                for (std::size_t i = 0; i < count; i++) {
+                    out[i] = Mix(BitsOf(values[i]));
+                }
+            }
+        }
+
+#if STREAMLINE_KERNELS_X86
+        /// @brief Entry m lists the set bits of m in ascending order, the left-packing permutation of AVX2 selects.
+        constexpr auto CompressTable = []() {
+            std::array<std::array<std::uint32_t, 8>, 256> table{};
+            for (unsigned mask = 0; mask < 256; mask++) {
+                unsigned next = 0;
+                for (unsigned lane = 0; lane < 8; lane++) {
+                    if (mask & (1u << lane)) {
+                        table[mask][next++] = lane;
+                    }
+                }
+            }
+            return table;
+        }();
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("sse4.2,popcnt"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("sse4.2,popcnt")
+#endif
+        namespace Sse42{
+            constexpr std::size_t Bytes = 16;
+#include "KernelsLevel.inl"
+        }
+#if defined(__clang__)
+#pragma clang attribute pop
+#pragma clang attribute push(__attribute__((target("avx2,bmi,bmi2,popcnt"))), apply_to = function)
+#else
+#pragma GCC pop_options
+#pragma GCC push_options
+#pragma GCC target("avx2,bmi,bmi2,popcnt")
+#endif
+        namespace Avx2{
+            constexpr std::size_t Bytes = 32;
+#include "KernelsLevel.inl"
+        }
+#if defined(__clang__)
+#pragma clang attribute pop
+#pragma clang attribute push(__attribute__((target("avx512f,avx512dq,avx512vl,avx512bw,bmi,bmi2,popcnt"))), apply_to = function)
+#else
+#pragma GCC pop_options
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512dq,avx512vl,avx512bw,bmi,bmi2,popcnt")
+#endif
+        namespace Avx512{
+            constexpr std::size_t Bytes = 64;
+#include "KernelsLevel.inl"
+        }
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+#endif
+
+        template<class T>
+        struct Table{
+            std::size_t(*select)(const T*, std::size_t, CompareOp, T, std::uint32_t*, std::uint32_t) noexcept;
+            void(*gather)(const T*, const std::uint32_t*, std::size_t, T*) noexcept;
+            SumType<T>(*sum)(const T*, std::size_t) noexcept;
+            T(*min)(const T*, std::size_t) noexcept;
+            T(*max)(const T*, std::size_t) noexcept;
+            void(*hash)(const T*, std::size_t, std::uint64_t*) noexcept;
+        };
+
+#define STREAMLINE_KERNEL_TABLE(Level, T) \
+        Table<T>{ &Level::Select<T>, &Level::Gather<T>, &Level::Sum<T>, &Level::Min<T>, &Level::Max<T>, &Level::Hash<T> }
+
+        //Constant-initialized to scalar, so the kernels work before the dispatch below ran.
+        template<class T>
+        Table<T> table = STREAMLINE_KERNEL_TABLE(Scalar, T);
+
+        SimdLevel activeLevel = SimdLevel::Scalar;
+
+        SimdLevel Detect() noexcept {
+            SimdLevel detected = SimdLevel::Scalar;
+#if STREAMLINE_KERNELS_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")
+                && __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512bw")) {
+                detected = SimdLevel::AVX512;
+            }
+            else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2")) {
+                detected = SimdLevel::AVX2;
+            }
+            else if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt")) {
+                detected = SimdLevel::SSE42;
+            }
+#endif
+            if (const char* cap = std::getenv("STREAMLINE_SIMD")) {
+                const std::string_view name(cap);
+                const SimdLevel requested = name == "avx512" ? SimdLevel::AVX512 : name == "avx2" ? SimdLevel::AVX2
+                    : name == "sse4.2" ? SimdLevel::SSE42 : SimdLevel::Scalar;
+                detected = std::min(detected, requested);
+            }
+            return detected;
+        }
+
+        template<class T>
+        void Install(SimdLevel level) noexcept {
+            switch (level) {
+#if STREAMLINE_KERNELS_X86
+            case SimdLevel::AVX512:
+                table<T> = STREAMLINE_KERNEL_TABLE(Avx512, T);
+                break;
+            case SimdLevel::AVX2:
+                table<T> = STREAMLINE_KERNEL_TABLE(Avx2, T);
+                break;
+            case SimdLevel::SSE42:
+                table<T> = STREAMLINE_KERNEL_TABLE(Sse42, T);
+                break;
+#endif
+            default:
+                break;
+            }
+        }
+
+        //Dispatch is decided here, once, during static initialization.
+        const bool dispatched = []() noexcept {
+            activeLevel = Detect();
+            Install<std::int32_t>(activeLevel);
+            Install<std::int64_t>(activeLevel);
+            Install<std::uint32_t>(activeLevel);
+            Install<std::uint64_t>(activeLevel);
+            Install<float>(activeLevel);
+            Install<double>(activeLevel);
+            return true;
+        }();
+    }
+
+    SimdLevel GetSimdLevel() noexcept {
+        return activeLevel;
+    }
+
+    template<class T>
+    std::size_t Select(const T* values, std::size_t count, CompareOp op, T value, std::uint32_t* out, std::uint32_t base) noexcept {
+        return table<T>.select(values, count, op, value, out, base);
+    }
+
+    template<class T>
+    std::size_t Refine(const T* values, const std::uint32_t* selection, std::size_t count, CompareOp op, T value, std::uint32_t* out) noexcept {
+        //Gathers blocks of the selected values and runs the dense select over them.
+        constexpr std::size_t Block = 256;
+        alignas(64) T gathered[Block];
+        alignas(64) std::uint32_t hits[Block];
+        std::size_t kept = 0;
+        for (std::size_t first = 0; first < count; first += Block) {
+            const std::size_t length = std::min(Block, count - first);
+            table<T>.gather(values, selection + first, length, gathered);
+            const std::size_t found = table<T>.select(gathered, length, op, value, hits, 0);
+            //Writes trail reads, so out may alias selection.
+            for (std::size_t i = 0; i < found; i++) {
+                out[kept++] = selection[first + hits[i]];
+            }
+        }
+        return kept;
+    }
+
+    template<class T>
+    void Gather(const T* values, const std::uint32_t* selection, std::size_t count, T* out) noexcept {
+        table<T>.gather(values, selection, count, out);
+    }
+
+    template<class T>
+    SumType<T> Sum(const T* values, std::size_t count) noexcept {
+        return table<T>.sum(values, count);
+    }
+
+    template<class T>
+    T Min(const T* values, std::size_t count) noexcept {
+        return table<T>.min(values, count);
+    }
+
+    template<class T>
+    T Max(const T* values, std::size_t count) noexcept {
+        return table<T>.max(values, count);
+    }
+
+    template<class T>
+    void Hash(const T* values, std::size_t count, std::uint64_t* out) noexcept {
+        table<T>.hash(values, count, out);
+    }
+
+#define STREAMLINE_KERNELS_INSTANTIATE(T) \
+    template std::size_t Select<T>(const T*, std::size_t, CompareOp, T, std::uint32_t*, std::uint32_t) noexcept; \
+    template std::size_t Refine<T>(const T*, const std::uint32_t*, std::size_t, CompareOp, T, std::uint32_t*) noexcept; \
+    template void Gather<T>(const T*, const std::uint32_t*, std::size_t, T*) noexcept; \
+    template SumType<T> Sum<T>(const T*, std::size_t) noexcept; \
+    template T Min<T>(const T*, std::size_t) noexcept; \
+    template T Max<T>(const T*, std::size_t) noexcept; \
+    template void Hash<T>(const T*, std::size_t, std::uint64_t*) noexcept;
+    STREAMLINE_KERNELS_INSTANTIATE(std::int32_t)
+    STREAMLINE_KERNELS_INSTANTIATE(std::int64_t)
+    STREAMLINE_KERNELS_INSTANTIATE(std::uint32_t)
+    STREAMLINE_KERNELS_INSTANTIATE(std::uint64_t)
+    STREAMLINE_KERNELS_INSTANTIATE(float)
+    STREAMLINE_KERNELS_INSTANTIATE(double)
+}
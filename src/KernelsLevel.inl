@@ -0,0 +1,229 @@
+//Included by Kernels.cpp once per x86 SIMD level, inside that level's namespace and target region.
+//The enclosing namespace defines Bytes, the vector width of the level.
+
+template<class T>
+struct Lanes{
+    static constexpr std::size_t Width = Bytes / sizeof(T);
+    using UInt = std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>;
+    typedef T Vec __attribute__((vector_size(Bytes)));
+    typedef UInt Raw __attribute__((vector_size(Bytes)));
+    typedef SumType<T> Wide __attribute__((vector_size(Width * 8)));
+    typedef std::uint64_t Wide64 __attribute__((vector_size(Width * 8)));
+};
+
+template<class T>
+inline typename Lanes<T>::Vec Load(const T* p) noexcept {
+    typename Lanes<T>::Vec v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+template<CompareOp Op, class V>
+inline auto CompareVector(V a, V b) noexcept {
+    if constexpr (Op == CompareOp::Equal) return a == b;
+    else if constexpr (Op == CompareOp::NotEqual) return a != b;
+    else if constexpr (Op == CompareOp::Less) return a < b;
+    else if constexpr (Op == CompareOp::LessEqual) return a <= b;
+    else if constexpr (Op == CompareOp::Greater) return a > b;
+    else return a >= b;
+}
+
+/// @brief One bit per lane of a comparison result.
+template<class T, class M>
+inline unsigned MaskBits(M mask) noexcept {
+    if constexpr (Bytes == 16) {
+        if constexpr (sizeof(T) == 4) return static_cast<unsigned>(_mm_movemask_ps(reinterpret_cast<__m128>(mask)));
+        else return static_cast<unsigned>(_mm_movemask_pd(reinterpret_cast<__m128d>(mask)));
+    }
+    else if constexpr (Bytes == 32) {
+        if constexpr (sizeof(T) == 4) return static_cast<unsigned>(_mm256_movemask_ps(reinterpret_cast<__m256>(mask)));
+        else return static_cast<unsigned>(_mm256_movemask_pd(reinterpret_cast<__m256d>(mask)));
+    }
+    else {
+        if constexpr (sizeof(T) == 4) return _mm512_movepi32_mask(reinterpret_cast<__m512i>(mask));
+        else return _mm512_movepi64_mask(reinterpret_cast<__m512i>(mask));
+    }
+}
+
+/// @brief Appends start + lane for every set bit, may write up to a full vector of indices past the returned count.
+template<class T>
+inline std::size_t Emit(unsigned bits, std::uint32_t start, std::uint32_t* out) noexcept {
+    if constexpr (Bytes == 64) {
+        if constexpr (sizeof(T) == 4) {
+            const __m512i lanes = _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+            _mm512_mask_compressstoreu_epi32(out, static_cast<__mmask16>(bits), _mm512_add_epi32(lanes, _mm512_set1_epi32(static_cast<int>(start))));
+        }
+        else {
+            const __m256i lanes = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+            _mm256_mask_compressstoreu_epi32(out, static_cast<__mmask8>(bits), _mm256_add_epi32(lanes, _mm256_set1_epi32(static_cast<int>(start))));
+        }
+    }
+    else if constexpr (Bytes == 32) {
+        //The compressed lane numbers come straight from the table, offset them by start.
+        const __m256i lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(CompressTable[bits].data()));
+        const __m256i indices = _mm256_add_epi32(lanes, _mm256_set1_epi32(static_cast<int>(start)));
+        if constexpr (sizeof(T) == 4) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), indices);
+        }
+        else {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(indices));
+        }
+    }
+    else {
+        unsigned rest = bits;
+        std::uint32_t* p = out;
+        while (rest != 0) {
+            *p++ = start + static_cast<std::uint32_t>(std::countr_zero(rest));
+            rest &= rest - 1;
+        }
+    }
+    return static_cast<std::size_t>(std::popcount(bits));
+}
+
+template<CompareOp Op, class T>
+std::size_t SelectOp(const T* values, std::size_t count, T value, std::uint32_t* out, std::uint32_t base) noexcept {
+    using L = Lanes<T>;
+    const typename L::Vec needle = typename L::Vec{} + value;
+    std::size_t i = 0;
+    std::size_t selected = 0;
+    //Never more than i indices were written, so the extra lanes Emit stores stay within count.
+    for (; i + L::Width <= count; i += L::Width) {
+        const unsigned bits = MaskBits<T>(CompareVector<Op>(Load(values + i), needle));
+        selected += Emit<T>(bits, base + static_cast<std::uint32_t>(i), out + selected);
+    }
+    for (; i < count; i++) {
+        out[selected] = base + static_cast<std::uint32_t>(i);
+        selected += Compare<Op>(values[i], value);
+    }
+    return selected;
+}
+
+template<class T>
+std::size_t Select(const T* values, std::size_t count, CompareOp op, T value, std::uint32_t* out, std::uint32_t base) noexcept {
+    switch (op) {
+    case CompareOp::Equal: return SelectOp<CompareOp::Equal>(values, count, value, out, base);
+    case CompareOp::NotEqual: return SelectOp<CompareOp::NotEqual>(values, count, value, out, base);
+    case CompareOp::Less: return SelectOp<CompareOp::Less>(values, count, value, out, base);
+    case CompareOp::LessEqual: return SelectOp<CompareOp::LessEqual>(values, count, value, out, base);
+    case CompareOp::Greater: return SelectOp<CompareOp::Greater>(values, count, value, out, base);
+    default: return SelectOp<CompareOp::GreaterEqual>(values, count, value, out, base);
+    }
+}
+
+/// @note The hardware gathers take signed 32-bit indices, rows past 2^31 are out of reach.
+template<class T>
+void Gather(const T* values, const std::uint32_t* selection, std::size_t count, T* out) noexcept {
+    std::size_t i = 0;
+    if constexpr (Bytes == 64) {
+        if constexpr (sizeof(T) == 4) {
+            for (; i + 16 <= count; i += 16) {
+                const __m512i indices = _mm512_loadu_si512(selection + i);
+                _mm512_storeu_si512(out + i, _mm512_i32gather_epi32(indices, values, 4));
+            }
+        }
+        else {
+            for (; i + 8 <= count; i += 8) {
+                const __m256i indices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(selection + i));
+                _mm512_storeu_si512(out + i, _mm512_i32gather_epi64(indices, values, 8));
+            }
+        }
+    }
+    else if constexpr (Bytes == 32) {
+        if constexpr (sizeof(T) == 4) {
+            for (; i + 8 <= count; i += 8) {
+                const __m256i indices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(selection + i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_i32gather_epi32(reinterpret_cast<const int*>(values), indices, 4));
+            }
+        }
+        else {
+            for (; i + 4 <= count; i += 4) {
+                const __m128i indices = _mm_loadu_si128(reinterpret_cast<const __m128i*>(selection + i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_i32gather_epi64(reinterpret_cast<const long long*>(values), indices, 8));
+            }
+        }
+    }
+    for (; i < count; i++) {
+        out[i] = values[selection[i]];
+    }
+}
+
+template<class T>
+SumType<T> Sum(const T* values, std::size_t count) noexcept {
+    using L = Lanes<T>;
+    typename L::Wide first{};
+    typename L::Wide second{};
+    std::size_t i = 0;
+    //Two accumulators hide the add latency.
+    for (; i + 2 * L::Width <= count; i += 2 * L::Width) {
+        first += __builtin_convertvector(Load(values + i), typename L::Wide);
+        second += __builtin_convertvector(Load(values + i + L::Width), typename L::Wide);
+    }
+    for (; i + L::Width <= count; i += L::Width) {
+        first += __builtin_convertvector(Load(values + i), typename L::Wide);
+    }
+    first += second;
+    SumType<T> total = 0;
+    for (std::size_t lane = 0; lane < L::Width; lane++) {
+        total += first[lane];
+    }
+    for (; i < count; i++) {
+        total += static_cast<SumType<T>>(values[i]);
+    }
+    return total;
+}
+
+template<bool Largest, class T>
+T Extreme(const T* values, std::size_t count) noexcept {
+    using L = Lanes<T>;
+    T result = Largest ? std::numeric_limits<T>::lowest() : std::numeric_limits<T>::max();
+    std::size_t i = 0;
+    if (count >= L::Width) {
+        typename L::Vec best = Load(values);
+        for (i = L::Width; i + L::Width <= count; i += L::Width) {
+            const typename L::Vec v = Load(values + i);
+            if constexpr (Largest) {
+                best = v > best ? v : best;
+            }
+            else {
+                best = v < best ? v : best;
+            }
+        }
+        for (std::size_t lane = 0; lane < L::Width; lane++) {
+            result = Largest ? std::max<T>(result, best[lane]) : std::min<T>(result, best[lane]);
+        }
+    }
+    for (; i < count; i++) {
+        result = Largest ? std::max(result, values[i]) : std::min(result, values[i]);
+    }
+    return result;
+}
+
+template<class T>
+T Min(const T* values, std::size_t count) noexcept {
+    return Extreme<false>(values, count);
+}
+
+template<class T>
+T Max(const T* values, std::size_t count) noexcept {
+    return Extreme<true>(values, count);
+}
+
+template<class T>
+void Hash(const T* values, std::size_t count, std::uint64_t* out) noexcept {
+    using L = Lanes<T>;
+    std::size_t i = 0;
+    for (; i + L::Width <= count; i += L::Width) {
+        typename L::Raw raw;
+        std::memcpy(&raw, values + i, sizeof(raw));
+        typename L::Wide64 x = __builtin_convertvector(raw, typename L::Wide64);
+        x ^= x >> 33;
+        x *= MixFirst;
+        x ^= x >> 33;
+        x *= MixSecond;
+        x ^= x >> 33;
+        std::memcpy(out + i, &x, sizeof(x));
+    }
+    for (; i < count; i++) {
+        out[i] = Mix(BitsOf(values[i]));
+    }
+}
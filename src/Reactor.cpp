@@ -0,0 +1,776 @@
+#include "Reactor.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace StreamLine::IO{
+#if defined(__linux__)
+    namespace {
+        enum class OperationKind : unsigned char{
+            Read, Write, Accept, Timeout
+        };
+
+        struct Operation{
+            OperationKind kind;
+            int fd = -1;
+            void* buffer = nullptr;
+            std::size_t length = 0;
+            std::int64_t offset = -1;
+            std::chrono::nanoseconds delay{ 0 };
+            __kernel_timespec timeout{};
+            //Empty for the reactor's own timers.
+            Completion then;
+        };
+
+        using Ready = std::vector<std::pair<Operation*, int>>;
+
+        std::atomic<unsigned int> batchSize{ 32 };
+        //Task boundaries a queued submission may wait for a batch to fill up.
+        constexpr unsigned int FlushInterval = 8;
+
+        void Complete(Ready& ready) {
+            for (auto& [op, result] : ready) {
+                if (op == nullptr) {
+                    continue;
+                }
+                if (op->then) {
+                    op->then(result);
+                }
+                delete op;
+            }
+            ready.clear();
+        }
+
+        int PerformNow(const Operation* op) noexcept {
+            ssize_t n = -1;
+            switch (op->kind) {
+            case OperationKind::Read:
+                n = op->offset >= 0 ? pread(op->fd, op->buffer, op->length, op->offset) : read(op->fd, op->buffer, op->length);
+                break;
+            case OperationKind::Write:
+                n = op->offset >= 0 ? pwrite(op->fd, op->buffer, op->length, op->offset) : write(op->fd, op->buffer, op->length);
+                break;
+            case OperationKind::Accept:
+                n = accept4(op->fd, nullptr, nullptr, SOCK_CLOEXEC);
+                break;
+            case OperationKind::Timeout:
+                return -ETIME;
+            }
+            return n >= 0 ? static_cast<int>(n) : -errno;
+        }
+
+        class Backend{
+        public:
+            virtual ~Backend() = default;
+            virtual void Push(Operation* op) = 0;
+            virtual void Flush() = 0;
+            virtual void Tick(bool idle) = 0;
+            /// @brief Waits up to timeoutMs (forever when negative) and runs the completions, returns whether any ran.
+            virtual bool Wait(int timeoutMs) = 0;
+            virtual void Wake() = 0;
+        };
+
+        class UringBackend final : public Backend{
+        private:
+            int ringFd = -1;
+            void* sqRing = MAP_FAILED;
+            std::size_t sqRingSize = 0;
+            void* cqRing = MAP_FAILED;
+            std::size_t cqRingSize = 0;
+            io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+            std::size_t sqesSize = 0;
+
+            unsigned* sqHead = nullptr;
+            unsigned* sqTail = nullptr;
+            unsigned* sqArray = nullptr;
+            unsigned sqMask = 0;
+            unsigned sqEntries = 0;
+            unsigned* cqHead = nullptr;
+            unsigned* cqTail = nullptr;
+            unsigned cqMask = 0;
+            io_uring_cqe* cqes = nullptr;
+
+            std::mutex sqMutex;
+            std::mutex cqMutex;
+            //Entries written to the ring but not handed to the kernel yet, only changed under sqMutex.
+            std::atomic<unsigned> queued{ 0 };
+            std::atomic<unsigned> ticksSinceFlush{ 0 };
+            //Operations handed to the ring and not reaped yet, released with the ring.
+            std::mutex inflightMutex;
+            std::unordered_set<Operation*> inflight;
+
+            static int Enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) noexcept {
+                return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+            }
+
+            bool Probe() {
+                constexpr unsigned count = 64;
+                std::vector<unsigned char> storage(sizeof(io_uring_probe) + count * sizeof(io_uring_probe_op), 0);
+                auto* probe = reinterpret_cast<io_uring_probe*>(storage.data());
+                if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe, count) < 0) {
+                    return false;
+                }
+                for (unsigned op : { IORING_OP_NOP, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_ACCEPT, IORING_OP_TIMEOUT }) {
+                    if (op > probe->last_op || (probe->ops[op].flags & IO_URING_OP_SUPPORTED) == 0) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            /// @brief Hands the queued entries to the kernel, sqMutex held.
+            void SubmitLocked() noexcept {
+                ticksSinceFlush.store(0, std::memory_order_relaxed);
+                while (queued.load(std::memory_order_relaxed) != 0) {
+                    //GETEVENTS without a minimum also moves overflowed completions back into the ring.
+                    int submitted = Enter(ringFd, queued.load(std::memory_order_relaxed), 0, IORING_ENTER_GETEVENTS);
+                    if (submitted < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        //EBUSY/EAGAIN: the completion ring is backed up, reaping makes room.
+                        return;
+                    }
+                    queued.fetch_sub(static_cast<unsigned>(submitted), std::memory_order_relaxed);
+                    if (submitted == 0) {
+                        return;
+                    }
+                }
+            }
+
+            /// @brief Claims the next free entry, sqMutex held. Makes room by submitting (and reaping) when full.
+            io_uring_sqe* NextEntry(Ready& ready) {
+                while (*sqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+                    SubmitLocked();
+                    if (*sqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+                        Reap(ready);
+                        std::this_thread::yield();
+                    }
+                }
+                io_uring_sqe* sqe = &sqes[*sqTail & sqMask];
+                std::memset(sqe, 0, sizeof(io_uring_sqe));
+                return sqe;
+            }
+
+            void Commit() noexcept {
+                const unsigned tail = *sqTail;
+                sqArray[tail & sqMask] = tail & sqMask;
+                __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+                queued.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            bool HasCompletions() const noexcept {
+                return __atomic_load_n(cqTail, __ATOMIC_ACQUIRE) != __atomic_load_n(cqHead, __ATOMIC_RELAXED);
+            }
+
+            void Reap(Ready& ready) {
+                std::lock_guard<std::mutex> lock(cqMutex);
+                unsigned head = *cqHead;
+                const unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+                const std::size_t first = ready.size();
+                for (; head != tail; head++) {
+                    const io_uring_cqe& cqe = cqes[head & cqMask];
+                    ready.emplace_back(reinterpret_cast<Operation*>(cqe.user_data), cqe.res);
+                }
+                __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+                if (ready.size() != first) {
+                    std::lock_guard<std::mutex> inflightLock(inflightMutex);
+                    for (std::size_t i = first; i < ready.size(); i++) {
+                        inflight.erase(ready[i].first);
+                    }
+                }
+            }
+
+            static void Prepare(io_uring_sqe* sqe, Operation* op) noexcept {
+                sqe->user_data = reinterpret_cast<std::uint64_t>(op);
+                sqe->fd = op->fd;
+                switch (op->kind) {
+                case OperationKind::Read:
+                case OperationKind::Write:
+                    sqe->opcode = op->kind == OperationKind::Read ? IORING_OP_READ : IORING_OP_WRITE;
+                    sqe->addr = reinterpret_cast<std::uint64_t>(op->buffer);
+                    sqe->len = static_cast<std::uint32_t>(std::min<std::size_t>(op->length, std::numeric_limits<std::uint32_t>::max()));
+                    sqe->off = op->offset < 0 ? ~static_cast<std::uint64_t>(0) : static_cast<std::uint64_t>(op->offset);
+                    break;
+                case OperationKind::Accept:
+                    sqe->opcode = IORING_OP_ACCEPT;
+                    sqe->accept_flags = SOCK_CLOEXEC;
+                    break;
+                case OperationKind::Timeout:
+                    op->timeout.tv_sec = op->delay.count() / 1000000000;
+                    op->timeout.tv_nsec = op->delay.count() % 1000000000;
+                    sqe->opcode = IORING_OP_TIMEOUT;
+                    sqe->fd = -1;
+                    sqe->addr = reinterpret_cast<std::uint64_t>(&op->timeout);
+                    sqe->len = 1;
+                    break;
+                }
+            }
+        public:
+            bool Open(unsigned entries) {
+                io_uring_params params{};
+                //Room for completions of several batches in flight.
+                params.flags = IORING_SETUP_CQSIZE;
+                params.cq_entries = entries * 8;
+                ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+                if (ringFd < 0 && errno == EINVAL) {
+                    params = io_uring_params{};
+                    ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+                }
+                if (ringFd < 0 || !Probe()) {
+                    return false;
+                }
+                sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+                cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+                const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+                if (singleMap) {
+                    sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+                }
+                sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+                if (sqRing == MAP_FAILED) {
+                    return false;
+                }
+                cqRing = singleMap ? sqRing : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+                if (cqRing == MAP_FAILED) {
+                    return false;
+                }
+                sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+                sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+                if (sqes == MAP_FAILED) {
+                    return false;
+                }
+                auto at = [](void* base, unsigned offset) { return reinterpret_cast<unsigned*>(static_cast<char*>(base) + offset); };
+                sqHead = at(sqRing, params.sq_off.head);
+                sqTail = at(sqRing, params.sq_off.tail);
+                sqArray = at(sqRing, params.sq_off.array);
+                sqMask = *at(sqRing, params.sq_off.ring_mask);
+                sqEntries = *at(sqRing, params.sq_off.ring_entries);
+                cqHead = at(cqRing, params.cq_off.head);
+                cqTail = at(cqRing, params.cq_off.tail);
+                cqMask = *at(cqRing, params.cq_off.ring_mask);
+                cqes = reinterpret_cast<io_uring_cqe*>(static_cast<char*>(cqRing) + params.cq_off.cqes);
+                return true;
+            }
+
+            ~UringBackend() override {
+                //Closing the ring cancels what the kernel still holds, the operations can go once it is closed.
+                if (ringFd >= 0) {
+                    close(ringFd);
+                }
+                for (Operation* op : inflight) {
+                    delete op;
+                }
+                if (sqes != MAP_FAILED) {
+                    munmap(sqes, sqesSize);
+                }
+                if (cqRing != MAP_FAILED && cqRing != sqRing) {
+                    munmap(cqRing, cqRingSize);
+                }
+                if (sqRing != MAP_FAILED) {
+                    munmap(sqRing, sqRingSize);
+                }
+            }
+
+            void Push(Operation* op) override {
+                Ready ready;
+                {
+                    std::lock_guard<std::mutex> lock(sqMutex);
+                    Prepare(NextEntry(ready), op);
+                    Commit();
+                    {
+                        //The kernel only sees the entry once submitted, so no completion can beat this.
+                        std::lock_guard<std::mutex> inflightLock(inflightMutex);
+                        inflight.insert(op);
+                    }
+                    //Threads outside the pool never tick, and a full batch goes out right away.
+                    if (!ThreadPool::IsWorkerThread() || queued.load(std::memory_order_relaxed) >= batchSize.load(std::memory_order_relaxed)) {
+                        SubmitLocked();
+                    }
+                }
+                Complete(ready);
+            }
+
+            void Flush() override {
+                std::lock_guard<std::mutex> lock(sqMutex);
+                SubmitLocked();
+            }
+
+            void Tick(bool idle) override {
+                if (queued.load(std::memory_order_relaxed) != 0) {
+                    if (idle || queued.load(std::memory_order_relaxed) >= batchSize.load(std::memory_order_relaxed)
+                        || ticksSinceFlush.fetch_add(1, std::memory_order_relaxed) + 1 >= FlushInterval) {
+                        Flush();
+                    }
+                }
+                if (HasCompletions()) {
+                    Ready ready;
+                    Reap(ready);
+                    Complete(ready);
+                }
+            }
+
+            bool Wait(int timeoutMs) override {
+                if (timeoutMs > 0) {
+                    //Bounds the wait below, completes as an ordinary (silent) timer.
+                    Push(new Operation{ OperationKind::Timeout, -1, nullptr, 0, -1, std::chrono::milliseconds(timeoutMs), {}, {} });
+                }
+                Flush();
+                if (timeoutMs != 0 && !HasCompletions()) {
+                    if (Enter(ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR && errno != EBUSY) {
+                        return false;
+                    }
+                }
+                Ready ready;
+                Reap(ready);
+                bool any = false;
+                for (auto& [op, result] : ready) {
+                    any |= op != nullptr && op->then;
+                }
+                Complete(ready);
+                return any;
+            }
+
+            void Wake() override {
+                Ready ready;
+                {
+                    std::lock_guard<std::mutex> lock(sqMutex);
+                    io_uring_sqe* sqe = NextEntry(ready);
+                    sqe->opcode = IORING_OP_NOP;
+                    sqe->user_data = 0;
+                    Commit();
+                    SubmitLocked();
+                }
+                Complete(ready);
+            }
+        };
+
+        class EpollBackend final : public Backend{
+        private:
+            struct Waiters{
+                std::deque<Operation*> readers;
+                std::deque<Operation*> writers;
+                bool registered = false;
+            };
+            struct Timer{
+                std::chrono::steady_clock::time_point deadline;
+                Operation* op;
+                bool operator>(const Timer& other) const noexcept {
+                    return deadline > other.deadline;
+                }
+            };
+            static constexpr std::int64_t NoDeadline = std::numeric_limits<std::int64_t>::max();
+
+            int epollFd = -1;
+            int wakeFd = -1;
+            std::mutex mtx;
+            std::unordered_map<int, Waiters> fds;
+            std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+            //Earliest timer in steady clock nanoseconds, lets Tick skip the lock.
+            std::atomic<std::int64_t> nextDeadline{ NoDeadline };
+
+            static std::int64_t Ticks(std::chrono::steady_clock::time_point t) noexcept {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+            }
+
+            /// @brief (Re)arms fd for its waiters, mtx held. Returns -errno on failure.
+            int Arm(int fd, Waiters& waiters) noexcept {
+                epoll_event event{};
+                event.events = EPOLLONESHOT | (waiters.readers.empty() ? 0u : static_cast<unsigned>(EPOLLIN))
+                    | (waiters.writers.empty() ? 0u : static_cast<unsigned>(EPOLLOUT));
+                event.data.fd = fd;
+                int op = waiters.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+                for (int attempt = 0; attempt < 2; attempt++) {
+                    if (epoll_ctl(epollFd, op, fd, &event) == 0) {
+                        waiters.registered = true;
+                        return 0;
+                    }
+                    //The fd was closed and its number reused, or registered by an earlier incarnation.
+                    if (errno == ENOENT) {
+                        op = EPOLL_CTL_ADD;
+                    }
+                    else if (errno == EEXIST) {
+                        op = EPOLL_CTL_MOD;
+                    }
+                    else {
+                        break;
+                    }
+                }
+                return -errno;
+            }
+
+            void FireTimers(Ready& ready) {
+                const auto now = std::chrono::steady_clock::now();
+                if (nextDeadline.load(std::memory_order_relaxed) > Ticks(now)) {
+                    return;
+                }
+                std::lock_guard<std::mutex> lock(mtx);
+                while (!timers.empty() && timers.top().deadline <= now) {
+                    ready.emplace_back(timers.top().op, -ETIME);
+                    timers.pop();
+                }
+                nextDeadline.store(timers.empty() ? NoDeadline : Ticks(timers.top().deadline), std::memory_order_relaxed);
+            }
+
+            void HandleEvent(int fd, std::uint32_t events, Ready& ready) {
+                Operation* reader = nullptr;
+                Operation* writer = nullptr;
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    auto it = fds.find(fd);
+                    if (it == fds.end()) {
+                        return;
+                    }
+                    //One operation per direction and event, a blocking fd then never blocks the poller.
+                    if ((events & (EPOLLIN | EPOLLERR | EPOLLHUP)) != 0 && !it->second.readers.empty()) {
+                        reader = it->second.readers.front();
+                        it->second.readers.pop_front();
+                    }
+                    if ((events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) != 0 && !it->second.writers.empty()) {
+                        writer = it->second.writers.front();
+                        it->second.writers.pop_front();
+                    }
+                }
+                Operation* retry[2] = { nullptr, nullptr };
+                for (Operation* op : { reader, writer }) {
+                    if (op == nullptr) {
+                        continue;
+                    }
+                    const int result = PerformNow(op);
+                    if (result == -EAGAIN || result == -EWOULDBLOCK) {
+                        retry[op == writer] = op;
+                    }
+                    else {
+                        ready.emplace_back(op, result);
+                    }
+                }
+                std::lock_guard<std::mutex> lock(mtx);
+                Waiters& waiters = fds[fd];
+                if (retry[0] != nullptr) {
+                    waiters.readers.push_front(retry[0]);
+                }
+                if (retry[1] != nullptr) {
+                    waiters.writers.push_front(retry[1]);
+                }
+                if (waiters.readers.empty() && waiters.writers.empty()) {
+                    //Left registered but disarmed, the next operation re-arms it.
+                    return;
+                }
+                const int error = Arm(fd, waiters);
+                if (error != 0) {
+                    for (Operation* op : waiters.readers) {
+                        ready.emplace_back(op, error);
+                    }
+                    for (Operation* op : waiters.writers) {
+                        ready.emplace_back(op, error);
+                    }
+                    fds.erase(fd);
+                }
+            }
+        public:
+            bool Open() {
+                epollFd = epoll_create1(EPOLL_CLOEXEC);
+                wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+                if (epollFd < 0 || wakeFd < 0) {
+                    return false;
+                }
+                epoll_event event{};
+                event.events = EPOLLIN;
+                event.data.fd = wakeFd;
+                return epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event) == 0;
+            }
+
+            ~EpollBackend() override {
+                for (auto& [fd, waiters] : fds) {
+                    for (Operation* op : waiters.readers) {
+                        delete op;
+                    }
+                    for (Operation* op : waiters.writers) {
+                        delete op;
+                    }
+                }
+                while (!timers.empty()) {
+                    delete timers.top().op;
+                    timers.pop();
+                }
+                if (wakeFd >= 0) {
+                    close(wakeFd);
+                }
+                if (epollFd >= 0) {
+                    close(epollFd);
+                }
+            }
+
+            void Push(Operation* op) override {
+                if (op->kind == OperationKind::Timeout) {
+                    const auto deadline = std::chrono::steady_clock::now() + op->delay;
+                    bool earliest;
+                    {
+                        std::lock_guard<std::mutex> lock(mtx);
+                        earliest = timers.empty() || deadline < timers.top().deadline;
+                        timers.push(Timer{ deadline, op });
+                        if (earliest) {
+                            nextDeadline.store(Ticks(deadline), std::memory_order_relaxed);
+                        }
+                    }
+                    if (earliest) {
+                        //The poller has to recompute its wait.
+                        Wake();
+                    }
+                    return;
+                }
+                int error;
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    Waiters& waiters = fds[op->fd];
+                    auto& list = op->kind == OperationKind::Write ? waiters.writers : waiters.readers;
+                    list.push_back(op);
+                    error = Arm(op->fd, waiters);
+                    if (error != 0) {
+                        list.pop_back();
+                        if (waiters.readers.empty() && waiters.writers.empty() && !waiters.registered) {
+                            fds.erase(op->fd);
+                        }
+                    }
+                }
+                if (error != 0) {
+                    //EPERM: regular files can't be polled, they are always ready.
+                    Ready ready{ { op, error == -EPERM ? PerformNow(op) : error } };
+                    Complete(ready);
+                }
+            }
+
+            void Flush() override {}
+
+            void Tick(bool) override {
+                if (nextDeadline.load(std::memory_order_relaxed) == NoDeadline) {
+                    return;
+                }
+                Ready ready;
+                FireTimers(ready);
+                Complete(ready);
+            }
+
+            bool Wait(int timeoutMs) override {
+                const std::int64_t next = nextDeadline.load(std::memory_order_relaxed);
+                if (next != NoDeadline) {
+                    const std::int64_t untilTimer = (next - Ticks(std::chrono::steady_clock::now()) + 999999) / 1000000;
+                    const int timerMs = static_cast<int>(std::clamp<std::int64_t>(untilTimer, 0, std::numeric_limits<int>::max()));
+                    timeoutMs = timeoutMs < 0 ? timerMs : std::min(timeoutMs, timerMs);
+                }
+                epoll_event events[64];
+                const int count = epoll_wait(epollFd, events, 64, timeoutMs);
+                Ready ready;
+                for (int i = 0; i < count; i++) {
+                    if (events[i].data.fd == wakeFd) {
+                        std::uint64_t drained;
+                        while (read(wakeFd, &drained, sizeof(drained)) > 0) {}
+                        continue;
+                    }
+                    HandleEvent(events[i].data.fd, events[i].events, ready);
+                }
+                FireTimers(ready);
+                const bool any = !ready.empty();
+                Complete(ready);
+                return any;
+            }
+
+            void Wake() override {
+                const std::uint64_t one = 1;
+                [[maybe_unused]] ssize_t written = write(wakeFd, &one, sizeof(one));
+            }
+        };
+
+        std::mutex initMutex;
+        std::atomic<Backend*> active{ nullptr };
+        //Callers inside Push, Flush or Poll, Shutdown waits for them before deleting the backend.
+        std::atomic<unsigned int> users{ 0 };
+        ReactorBackend activeKind = ReactorBackend::None;
+
+        /// @brief Pins the active backend for the duration of a call, null once shut down.
+        struct Lease{
+            Backend* backend;
+
+            Lease() noexcept {
+                //Sequentially consistent with Shutdown's exchange: either this sees null or Shutdown sees the count.
+                users.fetch_add(1);
+                backend = active.load();
+            }
+
+            ~Lease() {
+                users.fetch_sub(1, std::memory_order_release);
+            }
+
+            Lease(const Lease&) = delete;
+            Lease& operator=(const Lease&) = delete;
+        };
+
+        void TickHook(bool idle) {
+            if (Backend* backend = active.load(std::memory_order_acquire)) {
+                backend->Tick(idle);
+            }
+        }
+
+        void PollHook() {
+            if (Backend* backend = active.load(std::memory_order_acquire)) {
+                backend->Wait(-1);
+            }
+        }
+
+        void WakeHook() {
+            if (Backend* backend = active.load(std::memory_order_acquire)) {
+                backend->Wake();
+            }
+        }
+
+        void Push(Operation* op) {
+            Lease lease;
+            if (lease.backend == nullptr) {
+                delete op;
+                throw InvalidOperation();
+            }
+            lease.backend->Push(op);
+        }
+    }
+
+    ReactorBackend Reactor::Initialize(ReactorBackend preferred, unsigned int entries) {
+        std::lock_guard<std::mutex> lock(initMutex);
+        if (active.load(std::memory_order_relaxed) != nullptr) {
+            return activeKind;
+        }
+        std::unique_ptr<Backend> backend;
+        if (preferred == ReactorBackend::IoUring) {
+            auto uring = std::make_unique<UringBackend>();
+            if (uring->Open(entries)) {
+                backend = std::move(uring);
+                activeKind = ReactorBackend::IoUring;
+            }
+        }
+        if (backend == nullptr && preferred != ReactorBackend::None) {
+            auto epoll = std::make_unique<EpollBackend>();
+            if (epoll->Open()) {
+                backend = std::move(epoll);
+                activeKind = ReactorBackend::Epoll;
+            }
+        }
+        if (backend == nullptr) {
+            activeKind = ReactorBackend::None;
+            return activeKind;
+        }
+        active.store(backend.release(), std::memory_order_release);
+        ThreadPool::SetIdleHandler(ThreadPool::IdleHandler{ TickHook, PollHook, WakeHook });
+        static bool exitHookRegistered = false;
+        if (!exitHookRegistered) {
+            std::atexit(Shutdown);
+            exitHookRegistered = true;
+        }
+        return activeKind;
+    }
+
+    void Reactor::Shutdown() noexcept {
+        std::lock_guard<std::mutex> lock(initMutex);
+        if (active.load(std::memory_order_relaxed) == nullptr) {
+            return;
+        }
+        //Waits for the workers to leave the hooks before the backend goes away.
+        ThreadPool::SetIdleHandler(ThreadPool::IdleHandler{});
+        Backend* backend = active.exchange(nullptr);
+        //New callers now throw, the ones already in flight are waited out, a blocked Poll is woken to leave.
+        while (users.load(std::memory_order_acquire) != 0) {
+            try {
+                backend->Wake();
+            }
+            catch (...) {
+                //A completion run by the wake that fails (e.g. resubmitting) is dropped with the reactor.
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        delete backend;
+        activeKind = ReactorBackend::None;
+    }
+
+    ReactorBackend Reactor::GetBackend() noexcept {
+        std::lock_guard<std::mutex> lock(initMutex);
+        return activeKind;
+    }
+
+    void Reactor::Read(int fd, void* buffer, std::size_t length, std::int64_t offset, Completion then) {
+        Push(new Operation{ OperationKind::Read, fd, buffer, length, offset, {}, {}, std::move(then) });
+    }
+
+    void Reactor::Write(int fd, const void* buffer, std::size_t length, std::int64_t offset, Completion then) {
+        Push(new Operation{ OperationKind::Write, fd, const_cast<void*>(buffer), length, offset, {}, {}, std::move(then) });
+    }
+
+    void Reactor::Accept(int fd, Completion then) {
+        Push(new Operation{ OperationKind::Accept, fd, nullptr, 0, -1, {}, {}, std::move(then) });
+    }
+
+    void Reactor::Timeout(std::chrono::nanoseconds delay, Completion then) {
+        Push(new Operation{ OperationKind::Timeout, -1, nullptr, 0, -1, std::max(delay, std::chrono::nanoseconds(0)), {}, std::move(then) });
+    }
+
+    void Reactor::SetBatchSize(unsigned int count) noexcept {
+        batchSize.store(std::max(1u, count), std::memory_order_relaxed);
+    }
+
+    void Reactor::Flush() {
+        Lease lease;
+        if (lease.backend != nullptr) {
+            lease.backend->Flush();
+        }
+    }
+
+    bool Reactor::Poll(std::chrono::milliseconds timeout) {
+        Lease lease;
+        if (lease.backend == nullptr) {
+            throw InvalidOperation();
+        }
+        return lease.backend->Wait(static_cast<int>(timeout.count()));
+    }
+#else
+    ReactorBackend Reactor::Initialize(ReactorBackend, unsigned int) {
+        return ReactorBackend::None;
+    }
+    void Reactor::Shutdown() noexcept {}
+    ReactorBackend Reactor::GetBackend() noexcept {
+        return ReactorBackend::None;
+    }
+    void Reactor::Read(int, void*, std::size_t, std::int64_t, Completion) {
+        throw InvalidOperation();
+    }
+    void Reactor::Write(int, const void*, std::size_t, std::int64_t, Completion) {
+        throw InvalidOperation();
+    }
+    void Reactor::Accept(int, Completion) {
+        throw InvalidOperation();
+    }
+    void Reactor::Timeout(std::chrono::nanoseconds, Completion) {
+        throw InvalidOperation();
+    }
+    void Reactor::SetBatchSize(unsigned int) noexcept {}
+    void Reactor::Flush() {}
+    bool Reactor::Poll(std::chrono::milliseconds) {
+        throw InvalidOperation();
+    }
+#endif
+}
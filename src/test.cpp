@@ -1,5 +1,25 @@
 #include "StreamLine.h"
+#include "tests/Test.h"
+#include <cstring>
 
-int main(){
-    
-}
\ No newline at end of file
+//Runs every registered case, or those whose name contains argv[1].
+int main(int argc, char** argv){
+    using namespace StreamLine::Tests;
+    int failed = 0;
+    for (const Case& test : Registry()) {
+        if (argc > 1 && std::strstr(test.Name, argv[1]) == nullptr) {
+            continue;
+        }
+        const int before = Failures();
+        std::printf("%s\n", test.Name);
+        std::fflush(stdout);
+        test.Body();
+        if (Failures() != before) {
+            std::printf("%s FAILED\n", test.Name);
+            failed++;
+        }
+    }
+    std::printf("%d failed\n", failed);
+    StreamLine::ThreadPool::Shutdown();
+    return failed == 0 ? 0 : 1;
+}
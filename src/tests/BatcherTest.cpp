@@ -0,0 +1,90 @@
+#include "Test.h"
+#include "Batcher.h"
+#include "Parallel.h"
+#include "Reactor.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+using namespace StreamLine;
+
+namespace {
+    struct Collected{
+        std::mutex mtx;
+        std::vector<int> items;
+        std::size_t batches = 0;
+        std::size_t largest = 0;
+        std::atomic<std::size_t> count{ 0 };
+
+        Batcher<int>::Sink Sink() {
+            return [this](std::vector<int> batch) {
+                std::lock_guard<std::mutex> lock(mtx);
+                batches++;
+                largest = std::max(largest, batch.size());
+                items.insert(items.end(), batch.begin(), batch.end());
+                count += batch.size();
+            };
+        }
+    };
+}
+
+STREAMLINE_TEST(BatcherFlushesFullBuffers){
+    Tests::StartPool();
+    Collected out;
+    {
+        Batcher<int> batcher(out.Sink(), BatcherOptions{ 10, std::chrono::microseconds(0) });
+        for (int i = 0; i < 95; i++) {
+            batcher.Add(i);
+        }
+        CHECK(Tests::WaitUntil([&]() { return out.count.load() == 90; }));
+        batcher.Flush();
+        CHECK(Tests::WaitUntil([&]() { return out.count.load() == 95; }));
+    }
+    std::lock_guard<std::mutex> lock(out.mtx);
+    CHECK(out.batches == 10);
+    CHECK(out.largest == 10);
+    std::sort(out.items.begin(), out.items.end());
+    for (int i = 0; i < 95; i++) {
+        CHECK(out.items[i] == i);
+    }
+}
+
+STREAMLINE_TEST(BatcherCollectsFromEveryWorker){
+    Tests::StartPool();
+    constexpr int Count = 10000;
+    Collected out;
+    {
+        Batcher<int> batcher(out.Sink(), BatcherOptions{ 64, std::chrono::microseconds(0) });
+        ParallelFor(0, Count, 100, [&](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; i++) {
+                batcher.Add(static_cast<int>(i));
+            }
+        });
+        //The destructor flushes the partial buffers.
+    }
+    CHECK(Tests::WaitUntil([&]() { return out.count.load() == Count; }));
+    std::lock_guard<std::mutex> lock(out.mtx);
+    CHECK(out.largest <= 64);
+    std::sort(out.items.begin(), out.items.end());
+    CHECK(std::adjacent_find(out.items.begin(), out.items.end()) == out.items.end());
+}
+
+STREAMLINE_TEST(BatcherFlushesOnTheReactorTimer){
+    Tests::StartPool();
+    if (IO::Reactor::Initialize() == IO::ReactorBackend::None) {
+        std::printf("  reactor unavailable, skipped\n");
+        return;
+    }
+    Collected out;
+    {
+        Batcher<int> batcher(out.Sink(), BatcherOptions{ 1000, std::chrono::microseconds(2000) });
+        for (int i = 0; i < 3; i++) {
+            batcher.Add(i);
+        }
+        //Neither full nor flushed, only the delay hands these downstream.
+        CHECK(Tests::WaitUntil([&]() { return out.count.load() == 3; }, std::chrono::seconds(2)));
+    }
+    IO::Reactor::Shutdown();
+    std::lock_guard<std::mutex> lock(out.mtx);
+    CHECK(out.batches == 1);
+}
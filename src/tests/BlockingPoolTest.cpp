@@ -0,0 +1,150 @@
+#include "Test.h"
+#include "BlockingPool.h"
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+using namespace StreamLine;
+
+STREAMLINE_TEST(BlockingPoolGrowsForBlockedWork){
+    constexpr int Count = 8;
+    std::atomic<int> started{ 0 };
+    std::atomic<int> finished{ 0 };
+    for (int i = 0; i < Count; i++) {
+        BlockingPool::Submit([&]() {
+            started++;
+            //Every call blocks until all of them run at once, which takes a thread each.
+            Tests::WaitUntil([&]() { return started.load() == Count; });
+            finished++;
+        });
+    }
+    CHECK(Tests::WaitUntil([&]() { return finished.load() == Count; }));
+    CHECK(BlockingPool::GetThreadCount() >= Count);
+}
+
+STREAMLINE_TEST(BlockingPoolShrinksAfterKeepAlive){
+    BlockingPool::Shutdown();
+    BlockingPool::SetKeepAlive(std::chrono::milliseconds(10));
+    std::atomic<bool> ran{ false };
+    BlockingPool::Submit([&]() { ran = true; });
+    CHECK(Tests::WaitUntil([&]() { return ran.load(); }));
+    CHECK(Tests::WaitUntil([]() { return BlockingPool::GetThreadCount() == 0; }));
+    BlockingPool::SetKeepAlive(std::chrono::milliseconds(10000));
+}
+
+STREAMLINE_TEST(BlockingPoolCapsItsThreads){
+    BlockingPool::Shutdown();
+    BlockingPool::SetMaxThreads(2);
+    constexpr int Count = 16;
+    std::atomic<int> running{ 0 };
+    std::atomic<int> peak{ 0 };
+    std::atomic<int> finished{ 0 };
+    for (int i = 0; i < Count; i++) {
+        BlockingPool::Submit([&]() {
+            const int now = ++running;
+            int seen = peak.load();
+            while (now > seen && !peak.compare_exchange_weak(seen, now)) {}
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            running--;
+            finished++;
+        });
+    }
+    //Work past the cap queues instead of being dropped.
+    CHECK(Tests::WaitUntil([&]() { return finished.load() == Count; }));
+    CHECK(peak.load() <= 2);
+    BlockingPool::SetMaxThreads(512);
+}
+
+STREAMLINE_TEST(RunBlockingParksTheFiberInsteadOfItsWorker){
+    Tests::StartPool();
+    std::atomic<bool> released{ false };
+    std::atomic<int> result{ 0 };
+    Fiber::Spawn([&]() {
+        result = RunBlocking([&]() {
+            //Only a pool task releases this, it could never run if the fiber held the (possibly only) worker.
+            Tests::WaitUntil([&]() { return released.load(); });
+            return 42;
+        });
+    });
+    ThreadPool::Submit([&]() { released = true; });
+    CHECK(Tests::WaitUntil([&]() { return result.load() == 42; }));
+}
+
+STREAMLINE_TEST(RunBlockingRethrowsInTheFiber){
+    Tests::StartPool();
+    std::atomic<int> outcome{ 0 };
+    Fiber::Spawn([&]() {
+        bool caught = false;
+        try {
+            RunBlocking([]() -> int { throw std::runtime_error("blocked call failed"); });
+        }
+        catch (const std::runtime_error&) {
+            caught = true;
+        }
+        outcome = caught ? 1 : 2;
+    });
+    CHECK(Tests::WaitUntil([&]() { return outcome.load() != 0; }));
+    CHECK(outcome.load() == 1);
+}
+
+STREAMLINE_TEST(RunBlockingMovesWorkerCallsToTheBlockingPool){
+    Tests::StartPool();
+    std::atomic<int> outcome{ 0 };
+    ThreadPool::Submit([&]() {
+        const std::thread::id worker = std::this_thread::get_id();
+        const int where = RunBlocking([&]() { return std::this_thread::get_id() != worker && !ThreadPool::IsWorkerThread() ? 1 : 2; });
+        bool caught = false;
+        try {
+            RunBlocking([]() { throw std::runtime_error("blocked call failed"); });
+        }
+        catch (const std::runtime_error&) {
+            caught = true;
+        }
+        outcome = caught ? where : 3;
+    });
+    CHECK(Tests::WaitUntil([&]() { return outcome.load() != 0; }));
+    CHECK(outcome.load() == 1);
+    //Off the pool the call stays on the caller.
+    const std::thread::id self = std::this_thread::get_id();
+    CHECK(RunBlocking([&]() { return std::this_thread::get_id() == self; }));
+}
+
+STREAMLINE_TEST(RunBlockingKeepsAWaitingWorkerBusy){
+    //One worker, so only that worker can run the task f waits for.
+    ThreadPool::Shutdown();
+    ThreadPool::InitalizePool(1);
+    std::atomic<bool> released{ false };
+    std::atomic<int> result{ 0 };
+    ThreadPool::Submit([&]() {
+        ThreadPool::Submit([&]() { released = true; });
+        result = RunBlocking([&]() {
+            Tests::WaitUntil([&]() { return released.load(); });
+            return released.load() ? 42 : 0;
+        });
+    });
+    CHECK(Tests::WaitUntil([&]() { return result.load() != 0; }));
+    CHECK(result.load() == 42);
+    ThreadPool::Shutdown();
+    Tests::StartPool();
+}
+
+STREAMLINE_TEST(RunBlockingHandsTheResultToThePool){
+    Tests::StartPool();
+    std::atomic<int> value{ 0 };
+    std::atomic<bool> onPool{ false };
+    std::atomic<bool> failed{ false };
+    RunBlocking([]() { return 7; }, [&](std::future<int> result) {
+        onPool = ThreadPool::IsWorkerThread();
+        value = result.get();
+    });
+    RunBlocking([]() { throw std::runtime_error("nope"); }, [&](std::future<void> result) {
+        try {
+            result.get();
+        }
+        catch (const std::runtime_error&) {
+            failed = true;
+        }
+    });
+    CHECK(Tests::WaitUntil([&]() { return value.load() == 7 && failed.load(); }));
+    CHECK(onPool.load());
+}
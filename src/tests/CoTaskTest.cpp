@@ -0,0 +1,92 @@
+#include "Test.h"
+#include "CoTask.h"
+#include <atomic>
+#include <stdexcept>
+#include <string>
+
+using namespace StreamLine;
+
+namespace {
+    CoTask<long> Fib(int n) {
+        if (n < 2) {
+            co_return n;
+        }
+        SpawnScope scope;
+        long a = 0;
+        co_await scope.Spawn(Fib(n - 1), a);
+        long b = co_await Fib(n - 2);
+        co_await scope.Sync();
+        co_return a + b;
+    }
+
+    CoTask<int> Twice(int value) {
+        co_return 2 * value;
+    }
+
+    CoTask<int> Failing(int value) {
+        if (value > 0) {
+            throw std::runtime_error("child " + std::to_string(value));
+        }
+        co_return value;
+    }
+
+    CoTask<void> Count(std::atomic<int>& counter, int depth) {
+        counter++;
+        if (depth == 0) {
+            co_return;
+        }
+        SpawnScope scope;
+        co_await scope.Spawn(Count(counter, depth - 1));
+        co_await scope.Spawn(Count(counter, depth - 1));
+        co_await scope.Sync();
+    }
+
+    CoTask<std::string> SpawnFailures() {
+        SpawnScope scope;
+        int ok = -1;
+        int bad = -1;
+        co_await scope.Spawn(Failing(0), ok);
+        co_await scope.Spawn(Failing(1), bad);
+        std::string message = "no exception";
+        try {
+            co_await scope.Sync();
+        }
+        catch (const std::runtime_error& e) {
+            message = e.what();
+        }
+        //The scope can be used again once synced.
+        int again = -1;
+        co_await scope.Spawn(Twice(4), again);
+        co_await scope.Sync();
+        co_return message + " " + std::to_string(ok) + " " + std::to_string(again);
+    }
+}
+
+STREAMLINE_TEST(CoTaskSpawnMatchesSerialRecursion){
+    Tests::StartPool();
+    CHECK(SyncWait(Fib(20)) == 6765);
+    CHECK(SyncWait(Twice(21)) == 42);
+    std::atomic<int> counter{ 0 };
+    SyncWait(Count(counter, 10));
+    CHECK(counter.load() == (1 << 11) - 1);
+}
+
+STREAMLINE_TEST(CoTaskRethrowsFromChildrenAtSync){
+    Tests::StartPool();
+    CHECK(SyncWait(SpawnFailures()) == "child 1 0 8");
+    bool threw = false;
+    try {
+        SyncWait(Failing(3));
+    }
+    catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+STREAMLINE_TEST(CoTaskRunsWithoutAPool){
+    ThreadPool::Shutdown();
+    //No worker steals the queued parents, SyncWait runs them itself.
+    CHECK(SyncWait(Fib(15)) == 610);
+    Tests::StartPool();
+}
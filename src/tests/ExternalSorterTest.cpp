@@ -0,0 +1,148 @@
+#include "Test.h"
+#include "ExternalSorter.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace StreamLine;
+using namespace StreamLine::IO;
+
+namespace {
+    std::vector<std::int64_t> RandomValues(std::size_t count) {
+        std::mt19937_64 rng(11);
+        std::vector<std::int64_t> values(count);
+        for (std::int64_t& value : values) {
+            value = static_cast<std::int64_t>(rng() % 100000);
+        }
+        return values;
+    }
+
+    /// @brief 512-record blocks and 1024-record runs, so a few thousand records already spill and merge in passes.
+    ExternalSorterOptions TinyBudget() {
+        ExternalSorterOptions options;
+        options.BlockSize = 4096;
+        options.MemoryBudget = 5 * 4096;
+        return options;
+    }
+
+    std::vector<std::int64_t> Drain(ExternalSorter<std::int64_t>& sorter) {
+        std::vector<std::int64_t> out;
+        sorter.ForEach([&](std::int64_t value) { out.push_back(value); });
+        return out;
+    }
+}
+
+STREAMLINE_TEST(ExternalSorterSortsInMemoryWithoutSpilling){
+    Tests::StartPool();
+    std::vector<std::int64_t> values = RandomValues(50000);
+    ExternalSorter<std::int64_t> sorter;
+    sorter.Push(values.data(), values.size());
+    sorter.Finish();
+    CHECK(sorter.GetRunCount() == 0);
+    std::sort(values.begin(), values.end());
+    CHECK(Drain(sorter) == values);
+    std::int64_t extra = 0;
+    CHECK(!sorter.Next(extra));
+
+    ExternalSorter<std::int64_t> empty;
+    empty.Finish();
+    CHECK(Drain(empty).empty());
+}
+
+STREAMLINE_TEST(ExternalSorterMergesSpilledRunsInPasses){
+    Tests::StartPool();
+    std::vector<std::int64_t> values = RandomValues(20000);
+    ExternalSorter<std::int64_t> sorter(TinyBudget());
+    for (std::int64_t value : values) {
+        sorter.Push(value);
+    }
+    CHECK(sorter.GetRunCount() > 2);
+    sorter.Finish();
+    //A fan-in of 2 leaves at most two runs for the final merge.
+    CHECK(sorter.GetRunCount() <= 2);
+    std::sort(values.begin(), values.end());
+    CHECK(Drain(sorter) == values);
+}
+
+STREAMLINE_TEST(ExternalSorterTakesPushesFromWorkers){
+    Tests::StartPool();
+    const std::vector<std::int64_t> values = RandomValues(30000);
+    ExternalSorter<std::int64_t, std::greater<>> sorter(TinyBudget());
+    ParallelFor(0, values.size(), 97, [&](std::size_t first, std::size_t last) {
+        sorter.Push(values.data() + first, last - first);
+    });
+    sorter.Finish();
+    std::vector<std::int64_t> expected = values;
+    std::sort(expected.begin(), expected.end(), std::greater<>());
+    std::vector<std::int64_t> out;
+    sorter.ForEach([&](std::int64_t value) { out.push_back(value); });
+    CHECK(out == expected);
+}
+
+STREAMLINE_TEST(ExternalSorterRejectsMisuse){
+    ExternalSorterOptions options;
+    options.BlockSize = 4096;
+    options.MemoryBudget = 4 * 4096;
+    bool threw = false;
+    try {
+        ExternalSorter<std::int64_t> sorter(options);
+    }
+    catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    CHECK(threw);
+
+    ExternalSorter<std::int64_t> sorter;
+    std::int64_t value = 0;
+    CHECK(!sorter.Next(value));
+    sorter.Finish();
+    threw = false;
+    try {
+        sorter.Push(value);
+    }
+    catch (const std::logic_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+    threw = false;
+    try {
+        sorter.Finish();
+    }
+    catch (const std::logic_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+STREAMLINE_TEST(ExternalSorterReportsAFailedFinalSpill){
+    Tests::StartPool();
+    Tests::TempFile directory("sorter-spill-dir");
+    CHECK(mkdir(directory.Path.c_str(), 0700) == 0);
+    ExternalSorterOptions options = TinyBudget();
+    options.TempDirectory = directory.Path;
+    ExternalSorter<std::int64_t> sorter(options);
+    //One full run spilled, one record left for Finish to spill once the directory is gone.
+    const std::vector<std::int64_t> values = RandomValues(1025);
+    sorter.Push(values.data(), values.size());
+    CHECK(Tests::WaitUntil([&]() { return sorter.GetRunCount() == 1; }));
+    CHECK(rmdir(directory.Path.c_str()) == 0);
+    //From a worker, where the spill is handed to the BlockingPool.
+    std::atomic<int> outcome{ 0 };
+    ThreadPool::SubmitTo(0, [&]() {
+        try {
+            sorter.Finish();
+            outcome = 1;
+        }
+        catch (const std::system_error&) {
+            outcome = 2;
+        }
+    });
+    CHECK(Tests::WaitUntil([&]() { return outcome.load() != 0; }));
+    CHECK(outcome.load() == 2);
+}
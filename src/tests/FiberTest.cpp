@@ -0,0 +1,120 @@
+#include "Test.h"
+#include "Fiber.h"
+#include "Latch.h"
+#include <atomic>
+#include <cmath>
+#include <new>
+
+using namespace StreamLine;
+
+STREAMLINE_TEST(FiberParksInsteadOfBlockingItsWorker){
+    //One worker, so a fiber blocking it would keep the others from ever starting.
+    ThreadPool::Shutdown();
+    ThreadPool::InitalizePool(1);
+    constexpr int Count = 1000;
+    Locks::Latch gate;
+    std::atomic<int> started{ 0 };
+    std::atomic<int> finished{ 0 };
+    for (int i = 0; i < Count; i++) {
+        Fiber::Spawn([&]() {
+            started++;
+            gate.Wait();
+            finished++;
+        });
+    }
+    //Every fiber reaches the latch, a parked fiber leaves its worker to the others.
+    CHECK(Tests::WaitUntil([&]() { return started.load() == Count; }));
+    CHECK(finished.load() == 0);
+    gate.Signal();
+    CHECK(Tests::WaitUntil([&]() { return finished.load() == Count; }));
+    ThreadPool::Shutdown();
+    Tests::StartPool();
+}
+
+STREAMLINE_TEST(FiberKeepsItsStateAcrossSwitches){
+    Tests::StartPool();
+    constexpr int Count = 64;
+    std::atomic<int> correct{ 0 };
+    std::atomic<int> done{ 0 };
+    for (int i = 0; i < Count; i++) {
+        Fiber::Spawn([&, i]() {
+            //Callee-saved registers and the stack frame must survive the fiber moving between threads.
+            double x = i;
+            long sum = 0;
+            for (int step = 0; step < 20; step++) {
+                x = std::sqrt(x * x + 1.0);
+                sum += step * i;
+                Fiber::Yield();
+            }
+            double expected = i;
+            for (int step = 0; step < 20; step++) {
+                expected = std::sqrt(expected * expected + 1.0);
+            }
+            if (x == expected && sum == 190L * i && Fiber::Current() != nullptr) {
+                correct++;
+            }
+            done++;
+        });
+    }
+    CHECK(Tests::WaitUntil([&]() { return done.load() == Count; }));
+    CHECK(correct.load() == Count);
+}
+
+STREAMLINE_TEST(FiberIdentityIsStableAcrossParks){
+    Tests::StartPool();
+    std::atomic<bool> same{ false };
+    std::atomic<bool> done{ false };
+    Fiber::Spawn([&]() {
+        const void* id = Fiber::ExecutionId();
+        Fiber::Yield();
+        same = Fiber::ExecutionId() == id && id == Fiber::Current();
+        done = true;
+    });
+    CHECK(Tests::WaitUntil([&]() { return done.load(); }));
+    CHECK(same.load());
+    CHECK(Fiber::Current() == nullptr);
+}
+
+STREAMLINE_TEST(FiberStackGuardBudgetFailsInsteadOfDroppingTheGuard){
+#if STREAMLINE_FIBERS_SUPPORTED
+    Tests::StartPool();
+    FiberStackPool::Trim();
+    FiberStackPool::SetMaxGuarded(0);
+    bool threw = false;
+    try {
+        FiberStackPool::Release(FiberStackPool::Acquire(64 * 1024, false, true));
+    }
+    catch (const std::bad_alloc&) {
+        threw = true;
+    }
+    CHECK(threw);
+    //Unguarded stacks are opt-in and not limited by the budget.
+    FiberStack unguarded = FiberStackPool::Acquire(64 * 1024, false, false);
+    CHECK(!unguarded.Guarded);
+    CHECK(unguarded.Base != nullptr);
+    FiberStackPool::Release(unguarded);
+    std::atomic<bool> ran{ false };
+    FiberOptions options;
+    options.GuardPage = false;
+    Fiber::Spawn([&]() { ran = true; }, options);
+    CHECK(Tests::WaitUntil([&]() { return ran.load(); }));
+    FiberStackPool::SetMaxGuarded(16384);
+    FiberStack guarded = FiberStackPool::Acquire(64 * 1024, true, true);
+    CHECK(guarded.Guarded);
+    FiberStackPool::Release(guarded);
+    FiberStackPool::Trim();
+#endif
+}
+
+STREAMLINE_TEST(FiberSpawnNeedsARunningPool){
+    ThreadPool::Shutdown();
+    bool threw = false;
+    try {
+        Fiber::Spawn([]() {});
+    }
+    catch (const InvalidOperation&) {
+        threw = true;
+    }
+    CHECK(threw);
+    Tests::StartPool();
+}
@@ -0,0 +1,99 @@
+#include "Test.h"
+#include "GroupBy.h"
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <random>
+#include <vector>
+
+using namespace StreamLine;
+
+namespace {
+    using Sums = GroupBy<std::uint64_t, std::int64_t, std::int64_t>;
+
+    Sums MakeSums(const GroupByOptions& options = GroupByOptions()) {
+        return Sums(0,
+            [](std::int64_t& sum, const std::int64_t& value) { sum += value; },
+            [](std::int64_t& sum, const std::int64_t& other) { sum += other; },
+            options);
+    }
+
+    struct Input{
+        std::vector<std::uint64_t> Keys;
+        std::vector<std::int64_t> Values;
+        std::map<std::uint64_t, std::int64_t> Expected;
+    };
+
+    Input RandomInput(std::size_t count, std::uint64_t distinct) {
+        std::mt19937_64 rng(5);
+        Input input;
+        for (std::size_t i = 0; i < count; i++) {
+            const std::uint64_t key = rng() % distinct;
+            const std::int64_t value = static_cast<std::int64_t>(rng() % 1000);
+            input.Keys.push_back(key);
+            input.Values.push_back(value);
+            input.Expected[key] += value;
+        }
+        return input;
+    }
+
+    template<class Aggregator>
+    void PushInParallel(Aggregator& aggregator, const Input& input) {
+        ParallelFor(0, input.Keys.size(), 1000, [&](std::size_t first, std::size_t last) {
+            aggregator.Push(input.Keys.data() + first, input.Values.data() + first, last - first);
+        });
+    }
+}
+
+STREAMLINE_TEST(GroupBySumsFewKeysAcrossWorkers){
+    Tests::StartPool();
+    const Input input = RandomInput(200000, 64);
+    Sums sums = MakeSums();
+    PushInParallel(sums, input);
+    std::mutex mtx;
+    std::map<std::uint64_t, std::int64_t> groups;
+    std::size_t emitted = 0;
+    sums.Finish([&](const std::uint64_t& key, std::int64_t&& sum) {
+        std::lock_guard<std::mutex> lock(mtx);
+        groups[key] = sum;
+        emitted++;
+    });
+    CHECK(emitted == input.Expected.size());
+    CHECK(groups == input.Expected);
+}
+
+STREAMLINE_TEST(GroupByFlushesAndPartitionsManyKeys){
+    Tests::StartPool();
+    //Mostly distinct keys overflow a small local table, the workers then skip pre-aggregation.
+    const Input input = RandomInput(100000, 80000);
+    GroupByOptions options;
+    options.LocalTableBytes = 4096;
+    options.RadixBits = 4;
+    Sums sums = MakeSums(options);
+    PushInParallel(sums, input);
+    const auto groups = sums.Collect();
+    CHECK(groups.size() == input.Expected.size());
+    std::map<std::uint64_t, std::int64_t> merged(groups.begin(), groups.end());
+    CHECK(merged == input.Expected);
+}
+
+STREAMLINE_TEST(GroupByIsEmptyAfterFinishAndReusable){
+    Tests::StartPool();
+    GroupByOptions options;
+    options.RadixBits = 0;
+    Sums sums = MakeSums(options);
+    for (std::uint64_t key = 0; key < 10; key++) {
+        sums.Push(key, 1);
+        sums.Push(key, 2);
+    }
+    auto groups = sums.Collect();
+    std::sort(groups.begin(), groups.end());
+    CHECK(groups.size() == 10);
+    CHECK(std::all_of(groups.begin(), groups.end(), [](const auto& group) { return group.second == 3; }));
+    CHECK(sums.Collect().empty());
+
+    sums.Push(42, 7);
+    groups = sums.Collect();
+    CHECK(groups.size() == 1 && groups[0].first == 42 && groups[0].second == 7);
+}
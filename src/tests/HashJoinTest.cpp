@@ -0,0 +1,190 @@
+#include "Test.h"
+#include "HashJoin.h"
+#include <algorithm>
+#include <array>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+using namespace StreamLine;
+
+namespace {
+    using Row = std::array<std::int64_t, 4>;
+
+    const Schema Users{ { "id", ColumnType::Int64 }, { "weight", ColumnType::Int32 } };
+    const Schema Orders{ { "user", ColumnType::Int32 }, { "amount", ColumnType::Int64 } };
+
+    /// @brief Users 0..count, every tenth one twice with another weight.
+    std::vector<RecordBatch> UserBatches(std::size_t count, std::size_t batchRows) {
+        std::vector<std::int64_t> ids;
+        for (std::size_t i = 0; i < count; i++) {
+            ids.push_back(static_cast<std::int64_t>(i));
+            if (i % 10 == 0) {
+                ids.push_back(static_cast<std::int64_t>(i));
+            }
+        }
+        std::vector<RecordBatch> batches;
+        for (std::size_t first = 0; first < ids.size(); first += batchRows) {
+            const std::size_t rows = std::min(batchRows, ids.size() - first);
+            RecordBatch& batch = batches.emplace_back(Users, rows);
+            for (std::size_t r = 0; r < rows; r++) {
+                batch.GetColumn(0).Data<std::int64_t>()[r] = ids[first + r];
+                batch.GetColumn(1).Data<std::int32_t>()[r] = static_cast<std::int32_t>(first + r);
+            }
+            batch.Resize(rows);
+        }
+        return batches;
+    }
+
+    /// @brief Orders for users 0..users + 200, every seventh order with a null user.
+    std::vector<RecordBatch> OrderBatches(std::size_t count, std::size_t users, std::size_t batchRows) {
+        std::vector<RecordBatch> batches;
+        for (std::size_t first = 0; first < count; first += batchRows) {
+            const std::size_t rows = std::min(batchRows, count - first);
+            RecordBatch& batch = batches.emplace_back(Orders, rows);
+            for (std::size_t r = 0; r < rows; r++) {
+                const std::size_t order = first + r;
+                batch.GetColumn(0).Data<std::int32_t>()[r] = static_cast<std::int32_t>(order * 31 % (users + 200));
+                batch.GetColumn(1).Data<std::int64_t>()[r] = static_cast<std::int64_t>(order);
+                if (order % 7 == 0) {
+                    batch.GetColumn(0).SetNull(r);
+                }
+            }
+            batch.Resize(rows);
+        }
+        return batches;
+    }
+
+    std::vector<Row> Expected(const std::vector<RecordBatch>& users, const std::vector<RecordBatch>& orders) {
+        std::vector<Row> rows;
+        for (const RecordBatch& order : orders) {
+            for (std::size_t o = 0; o < order.Size(); o++) {
+                if (!order.GetColumn(0).IsValid(o)) {
+                    continue;
+                }
+                for (const RecordBatch& user : users) {
+                    for (std::size_t u = 0; u < user.Size(); u++) {
+                        if (user.GetColumn(0).Data<std::int64_t>()[u] == order.GetColumn(0).Data<std::int32_t>()[o]) {
+                            rows.push_back(Row{ user.GetColumn(0).Data<std::int64_t>()[u], user.GetColumn(1).Data<std::int32_t>()[u],
+                                order.GetColumn(0).Data<std::int32_t>()[o], order.GetColumn(1).Data<std::int64_t>()[o] });
+                        }
+                    }
+                }
+            }
+        }
+        std::sort(rows.begin(), rows.end());
+        return rows;
+    }
+
+    void Append(std::vector<Row>& rows, const RecordBatch& batch) {
+        for (std::size_t r = 0; r < batch.Size(); r++) {
+            rows.push_back(Row{ batch.GetColumn(0).Data<std::int64_t>()[r], batch.GetColumn(1).Data<std::int32_t>()[r],
+                batch.GetColumn(2).Data<std::int32_t>()[r], batch.GetColumn(3).Data<std::int64_t>()[r] });
+        }
+    }
+
+    /// @brief Builds and probes on the workers, then joins what was spilled.
+    std::vector<Row> Join(HashJoin& join, const std::vector<RecordBatch>& users, const std::vector<RecordBatch>& orders) {
+        ParallelFor(0, users.size(), 1, [&](std::size_t i, std::size_t) { join.Build(users[i]); });
+        join.FinishBuild();
+        std::mutex mtx;
+        std::vector<Row> rows;
+        auto sink = [&](RecordBatch&& batch) {
+            CHECK(batch.Size() <= 64);
+            std::lock_guard<std::mutex> lock(mtx);
+            Append(rows, batch);
+        };
+        ParallelFor(0, orders.size(), 1, [&](std::size_t i, std::size_t) { join.Probe(orders[i], sink); });
+        join.FinishProbe(sink);
+        std::sort(rows.begin(), rows.end());
+        return rows;
+    }
+}
+
+STREAMLINE_TEST(HashJoinMatchesEveryPairInMemory){
+    Tests::StartPool();
+    const auto users = UserBatches(1000, 128);
+    const auto orders = OrderBatches(4000, 1000, 256);
+    HashJoinOptions options;
+    options.RadixBits = 4;
+    options.OutputRows = 64;
+    HashJoin join(Users, 0, Orders, 0, options);
+    CHECK(join.GetOutputSchema().size() == 4);
+    const std::vector<Row> rows = Join(join, users, orders);
+    CHECK(join.GetSpilledPartitions() == 0);
+    CHECK(!rows.empty());
+    CHECK(rows == Expected(users, orders));
+}
+
+STREAMLINE_TEST(HashJoinSpillsPartitionsPastTheBudget){
+    Tests::StartPool();
+    const auto users = UserBatches(2000, 100);
+    const auto orders = OrderBatches(6000, 2000, 300);
+    HashJoinOptions options;
+    options.RadixBits = 3;
+    options.OutputRows = 64;
+    //A few kilobytes of 28-byte build rows, most partitions end up on disk.
+    options.MemoryBudget = 16 << 10;
+    options.SpillBlockSize = 1 << 10;
+    HashJoin join(Users, 0, Orders, 0, options);
+    const std::vector<Row> rows = Join(join, users, orders);
+    CHECK(join.GetSpilledPartitions() > 0);
+    CHECK(rows == Expected(users, orders));
+}
+
+STREAMLINE_TEST(HashJoinProbesOnlySelectedRows){
+    Tests::StartPool();
+    const auto users = UserBatches(100, 1000);
+    auto orders = OrderBatches(300, 100, 300);
+    HashJoin join(Users, 0, Orders, 0);
+    join.Build(users[0]);
+    join.FinishBuild();
+    orders[0].Select<std::int64_t>(1, [](std::int64_t amount) { return amount < 50; });
+    std::vector<Row> rows;
+    for (const RecordBatch& batch : join.Probe(orders[0])) {
+        Append(rows, batch);
+    }
+    CHECK(!rows.empty());
+    CHECK(std::all_of(rows.begin(), rows.end(), [](const Row& row) { return row[3] < 50 && row[0] == row[2]; }));
+    orders[0].Compact();
+    std::sort(rows.begin(), rows.end());
+    CHECK(rows == Expected(users, orders));
+}
+
+STREAMLINE_TEST(HashJoinRejectsBadKeysAndOrdering){
+    bool threw = false;
+    try {
+        HashJoin join({ { "price", ColumnType::Float64 } }, 0, Orders, 0);
+    }
+    catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    CHECK(threw);
+    threw = false;
+    try {
+        HashJoin join(Users, 2, Orders, 0);
+    }
+    catch (const std::out_of_range&) {
+        threw = true;
+    }
+    CHECK(threw);
+
+    HashJoin join(Users, 0, Orders, 0);
+    const auto orders = OrderBatches(10, 10, 10);
+    threw = false;
+    try {
+        join.Probe(orders[0]);
+    }
+    catch (const std::logic_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+    threw = false;
+    try {
+        join.Build(orders[0]);
+    }
+    catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
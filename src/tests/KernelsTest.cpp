@@ -0,0 +1,166 @@
+#include "Test.h"
+#include "Kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace StreamLine;
+using namespace StreamLine::Kernels;
+
+namespace {
+    constexpr CompareOp Ops[] = {
+        CompareOp::Equal, CompareOp::NotEqual, CompareOp::Less, CompareOp::LessEqual, CompareOp::Greater, CompareOp::GreaterEqual
+    };
+
+    template<class T>
+    bool Holds(T a, CompareOp op, T b) {
+        switch (op) {
+        case CompareOp::Equal: return a == b;
+        case CompareOp::NotEqual: return a != b;
+        case CompareOp::Less: return a < b;
+        case CompareOp::LessEqual: return a <= b;
+        case CompareOp::Greater: return a > b;
+        default: return a >= b;
+        }
+    }
+
+    template<class T>
+    std::vector<T> RandomValues(std::size_t count, std::mt19937_64& rng) {
+        std::vector<T> values(count);
+        for (T& value : values) {
+            if constexpr (std::is_floating_point_v<T>) {
+                value = static_cast<T>(static_cast<int>(rng() % 64) - 32) / 4;
+            }
+            else if constexpr (std::is_signed_v<T>) {
+                //Small values repeat, so Equal selects something. Extremes check signed compares.
+                value = static_cast<T>(static_cast<int>(rng() % 64) - 32);
+            }
+            else {
+                value = static_cast<T>(rng() % 64);
+            }
+        }
+        if (count > 3) {
+            values[1] = std::numeric_limits<T>::max();
+            values[2] = std::numeric_limits<T>::lowest();
+        }
+        return values;
+    }
+
+    template<class T>
+    void CheckAgainstScalar() {
+        std::mt19937_64 rng(42);
+        //Lengths around the vector widths, so both the SIMD body and the tail run.
+        for (std::size_t count : { 0u, 1u, 3u, 7u, 8u, 15u, 16u, 17u, 31u, 64u, 257u, 1000u }) {
+            const std::vector<T> values = RandomValues<T>(count, rng);
+            for (CompareOp op : Ops) {
+                for (T needle : { T(0), T(3), std::numeric_limits<T>::max() }) {
+                    std::vector<std::uint32_t> out(count + 16);
+                    const std::size_t found = Select(values.data(), count, op, needle, out.data(), 100);
+                    std::vector<std::uint32_t> expected;
+                    for (std::size_t i = 0; i < count; i++) {
+                        if (Holds(values[i], op, needle)) {
+                            expected.push_back(static_cast<std::uint32_t>(100 + i));
+                        }
+                    }
+                    CHECK(found == expected.size());
+                    CHECK(std::equal(expected.begin(), expected.end(), out.begin()));
+
+                    //Refine in place over every other row.
+                    std::vector<std::uint32_t> selection;
+                    for (std::uint32_t i = 0; i < count; i += 2) {
+                        selection.push_back(i);
+                    }
+                    std::vector<std::uint32_t> refinedExpected;
+                    for (std::uint32_t row : selection) {
+                        if (Holds(values[row], op, needle)) {
+                            refinedExpected.push_back(row);
+                        }
+                    }
+                    const std::size_t kept = Refine(values.data(), selection.data(), selection.size(), op, needle, selection.data());
+                    CHECK(kept == refinedExpected.size());
+                    CHECK(std::equal(refinedExpected.begin(), refinedExpected.end(), selection.begin()));
+                }
+            }
+            //The extremes at 1 and 2 would overflow the sums, those start past them. Quarters add up exactly either way.
+            const std::size_t skip = std::min<std::size_t>(count, 3);
+            SumType<T> sum = 0;
+            T smallest = std::numeric_limits<T>::max();
+            T largest = std::numeric_limits<T>::lowest();
+            for (std::size_t i = 0; i < count; i++) {
+                if (i >= skip) {
+                    sum += static_cast<SumType<T>>(values[i]);
+                }
+                smallest = std::min(smallest, values[i]);
+                largest = std::max(largest, values[i]);
+            }
+            CHECK(Sum(values.data() + skip, count - skip) == sum);
+            CHECK(Min(values.data(), count) == smallest);
+            CHECK(Max(values.data(), count) == largest);
+
+            std::vector<std::uint32_t> rows;
+            for (std::uint32_t i = 0; i < count; i += 3) {
+                rows.push_back(count - 1 - i);
+            }
+            std::vector<T> gathered(rows.size());
+            Gather(values.data(), rows.data(), rows.size(), gathered.data());
+            for (std::size_t i = 0; i < rows.size(); i++) {
+                CHECK(gathered[i] == values[rows[i]]);
+            }
+
+            std::vector<std::uint64_t> hashes(count);
+            Hash(values.data(), count, hashes.data());
+            for (std::size_t i = 0; i < count; i++) {
+                std::uint64_t single;
+                Hash(&values[i], 1, &single);
+                CHECK(hashes[i] == single);
+            }
+        }
+    }
+}
+
+STREAMLINE_TEST(KernelsMatchScalarLoopsOnEveryType){
+    std::printf("  SIMD level %u\n", static_cast<unsigned>(GetSimdLevel()));
+    CheckAgainstScalar<std::int32_t>();
+    CheckAgainstScalar<std::int64_t>();
+    CheckAgainstScalar<std::uint32_t>();
+    CheckAgainstScalar<std::uint64_t>();
+    CheckAgainstScalar<float>();
+    CheckAgainstScalar<double>();
+}
+
+STREAMLINE_TEST(KernelsSumFloatsWithinRounding){
+    std::vector<float> values(1000);
+    double expected = 0;
+    for (std::size_t i = 0; i < values.size(); i++) {
+        values[i] = static_cast<float>(i) * 0.25f;
+        expected += values[i];
+    }
+    CHECK(std::abs(Sum(values.data(), values.size()) - expected) < 1e-6 * expected);
+}
+
+STREAMLINE_TEST(KernelsSelectWhereOnUnsignedColumns){
+    RecordBatch batch({ { "small", ColumnType::UInt32 }, { "large", ColumnType::UInt64 } }, 100);
+    std::uint32_t* small = batch.GetColumn(0).Data<std::uint32_t>();
+    std::uint64_t* large = batch.GetColumn(1).Data<std::uint64_t>();
+    for (std::uint32_t i = 0; i < 100; i++) {
+        small[i] = i;
+        //Past INT64_MAX, a signed compare would get these backwards.
+        large[i] = (std::uint64_t(1) << 63) + i;
+    }
+    batch.Resize(100);
+    batch.GetColumn(0).SetNull(60);
+    SelectWhere<std::uint32_t>(batch, 0, CompareOp::GreaterEqual, 50u);
+    SelectWhere<std::uint64_t>(batch, 1, CompareOp::Less, (std::uint64_t(1) << 63) + 70);
+    std::vector<std::size_t> rows;
+    batch.ForEachRow([&](std::size_t row) { rows.push_back(row); });
+    std::vector<std::size_t> expected;
+    for (std::size_t i = 50; i < 70; i++) {
+        if (i != 60) {
+            expected.push_back(i);
+        }
+    }
+    CHECK(rows == expected);
+}
@@ -0,0 +1,82 @@
+#include "Test.h"
+#include "MappedFile.h"
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <system_error>
+
+using namespace StreamLine;
+using namespace StreamLine::IO;
+
+namespace {
+    std::string WriteLines(const std::string& path, int count) {
+        std::string content;
+        for (int i = 0; i < count; i++) {
+            content += "record " + std::to_string(i) + "\n";
+        }
+        std::ofstream(path, std::ios::binary) << content;
+        return content;
+    }
+}
+
+STREAMLINE_TEST(MappedFileSourceSplitsOnRecordBoundaries){
+    Tests::TempFile file("mapped-split");
+    const std::string content = WriteLines(file.Path, 5000);
+    MappedFileSource source(file.Path);
+    CHECK(source.View() == content);
+    const auto chunks = source.Split(1000);
+    CHECK(chunks.size() > 1);
+    std::string joined;
+    for (std::size_t i = 0; i < chunks.size(); i++) {
+        CHECK(!chunks[i].empty());
+        //Every chunk ends on a delimiter, the last one too since the file does.
+        CHECK(chunks[i].back() == '\n');
+        if (i + 1 < chunks.size()) {
+            CHECK(chunks[i].size() >= 1000);
+        }
+        joined += chunks[i];
+    }
+    CHECK(joined == content);
+}
+
+STREAMLINE_TEST(MappedFileSourceParsesChunksInParallel){
+    Tests::StartPool();
+    Tests::TempFile file("mapped-parse");
+    constexpr int Count = 20000;
+    WriteLines(file.Path, Count);
+    MappedFileSource source(file.Path);
+    std::atomic<long> lines{ 0 };
+    std::atomic<long> sum{ 0 };
+    source.ForEachChunk([&](std::string_view chunk, std::size_t) {
+        long localLines = 0;
+        long localSum = 0;
+        std::size_t start = 0;
+        while (start < chunk.size()) {
+            const std::size_t end = chunk.find('\n', start);
+            const std::string_view line = chunk.substr(start, end - start);
+            localSum += std::stol(std::string(line.substr(line.find(' ') + 1)));
+            localLines++;
+            start = end + 1;
+        }
+        lines += localLines;
+        sum += localSum;
+    }, 4096);
+    CHECK(lines.load() == Count);
+    CHECK(sum.load() == static_cast<long>(Count) * (Count - 1) / 2);
+}
+
+STREAMLINE_TEST(MappedFileHandlesEmptyAndMissingFiles){
+    Tests::TempFile file("mapped-empty");
+    std::ofstream(file.Path, std::ios::binary).close();
+    MappedFileSource empty(file.Path);
+    CHECK(empty.View().empty());
+    CHECK(empty.Split(16).empty());
+    bool threw = false;
+    try {
+        MappedFile missing("/nonexistent/streamline/file");
+    }
+    catch (const std::system_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
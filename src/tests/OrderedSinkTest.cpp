@@ -0,0 +1,106 @@
+#include "Test.h"
+#include "OrderedSink.h"
+#include "Parallel.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace StreamLine;
+using namespace StreamLine::IO;
+
+namespace {
+    std::string ReadAll(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        std::stringstream content;
+        content << in.rdbuf();
+        return content.str();
+    }
+
+    std::string Expected(int count) {
+        std::string content;
+        for (int i = 0; i < count; i++) {
+            content += std::to_string(i) + ",";
+        }
+        return content;
+    }
+}
+
+STREAMLINE_TEST(OrderedSinkWritesInSequenceOrder){
+    Tests::TempFile file("sink-reverse");
+    constexpr int Count = 500;
+    {
+        OrderedSink sink(file.Path);
+        //Everything but sequence 0 waits in the window, pushing 0 drains the lot.
+        for (int i = Count - 1; i >= 0; i--) {
+            sink.Push(static_cast<std::uint64_t>(i), std::to_string(i) + ",");
+        }
+        CHECK(sink.GetNextSequence() == Count);
+        sink.Close();
+    }
+    CHECK(ReadAll(file.Path) == Expected(Count));
+}
+
+STREAMLINE_TEST(OrderedSinkOrdersPushesFromWorkers){
+    Tests::StartPool();
+    for (bool offload : { false, true }) {
+        Tests::TempFile file(offload ? "sink-offload" : "sink-parallel");
+        constexpr int Count = 2000;
+        OrderedSinkOptions options;
+        options.Window = Count;
+        options.MaxBatch = 16;
+        options.OffloadWrites = offload;
+        OrderedSink sink(file.Path, options);
+        ParallelFor(0, Count, 7, [&](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; i++) {
+                sink.Push(i, std::to_string(i) + ",");
+            }
+        });
+        sink.Close();
+        CHECK(ReadAll(file.Path) == Expected(Count));
+    }
+}
+
+STREAMLINE_TEST(OrderedSinkRejectsDuplicatesAndGaps){
+    Tests::TempFile file("sink-gap");
+    OrderedSink sink(file.Path);
+    sink.Push(0, "a");
+    bool duplicate = false;
+    try {
+        sink.Push(0, "again");
+    }
+    catch (const std::invalid_argument&) {
+        duplicate = true;
+    }
+    CHECK(duplicate);
+    sink.Push(2, "c");
+    bool gap = false;
+    try {
+        sink.Close();
+    }
+    catch (const std::runtime_error&) {
+        gap = true;
+    }
+    CHECK(gap);
+    CHECK(ReadAll(file.Path) == "a");
+}
+
+STREAMLINE_TEST(OrderedSinkRefusesPushesOnceClosed){
+    Tests::TempFile file("sink-closed");
+    OrderedSinkOptions options;
+    options.Window = 4;
+    OrderedSink sink(file.Path, options);
+    sink.Push(0, "a");
+    sink.Close();
+    //Next in line, and far past the window: neither may be dropped silently or wait forever.
+    for (std::uint64_t sequence : { 1, 100 }) {
+        bool refused = false;
+        try {
+            sink.Push(sequence, "late");
+        }
+        catch (const InvalidOperation&) {
+            refused = true;
+        }
+        CHECK(refused);
+    }
+    CHECK(ReadAll(file.Path) == "a");
+}
@@ -0,0 +1,113 @@
+#include "Test.h"
+#include "ParallelSort.h"
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace StreamLine;
+
+namespace {
+    template<class T>
+    std::vector<T> RandomValues(std::size_t count, T range) {
+        std::mt19937_64 rng(7);
+        std::vector<T> values(count);
+        for (T& value : values) {
+            value = static_cast<T>(rng() % static_cast<std::uint64_t>(range)) - range / 2;
+        }
+        return values;
+    }
+
+    struct Keyed{
+        std::int32_t key;
+        std::uint32_t order;
+    };
+}
+
+STREAMLINE_TEST(ParallelSortMatchesStdSort){
+    Tests::StartPool();
+    for (std::int64_t range : { std::int64_t(16), std::int64_t(1) << 40 }) {
+        //Past the cutoff so the sample sort runs, few distinct keys exercise the splitter buckets.
+        std::vector<std::int64_t> values = RandomValues<std::int64_t>(300000, range);
+        std::vector<std::int64_t> expected = values;
+        std::sort(expected.begin(), expected.end());
+        ParallelSort(values.begin(), values.end());
+        CHECK(values == expected);
+    }
+    std::vector<int> descending = RandomValues<int>(100000, 1000);
+    ParallelSort(descending.begin(), descending.end(), std::greater<>());
+    CHECK(std::is_sorted(descending.begin(), descending.end(), std::greater<>()));
+}
+
+STREAMLINE_TEST(ParallelStableSortKeepsEqualKeysInOrder){
+    Tests::StartPool();
+    const std::vector<int> keys = RandomValues<int>(200000, 100);
+    std::vector<Keyed> values(keys.size());
+    for (std::size_t i = 0; i < keys.size(); i++) {
+        values[i] = Keyed{ keys[i], static_cast<std::uint32_t>(i) };
+    }
+    auto byKey = [](const Keyed& a, const Keyed& b) { return a.key < b.key; };
+    std::vector<Keyed> expected = values;
+    std::stable_sort(expected.begin(), expected.end(), byKey);
+    ParallelStableSort(values.begin(), values.end(), byKey);
+    CHECK(std::equal(values.begin(), values.end(), expected.begin(),
+        [](const Keyed& a, const Keyed& b) { return a.key == b.key && a.order == b.order; }));
+}
+
+STREAMLINE_TEST(ParallelRadixSortOrdersSignedKeysStably){
+    Tests::StartPool();
+    std::vector<std::int64_t> values = RandomValues<std::int64_t>(200000, std::int64_t(1) << 50);
+    values.push_back(std::numeric_limits<std::int64_t>::min());
+    values.push_back(std::numeric_limits<std::int64_t>::max());
+    std::vector<std::int64_t> expected = values;
+    std::sort(expected.begin(), expected.end());
+    ParallelRadixSort(values.begin(), values.end());
+    CHECK(values == expected);
+
+    const std::vector<int> keys = RandomValues<int>(100000, 64);
+    std::vector<Keyed> records(keys.size());
+    for (std::size_t i = 0; i < keys.size(); i++) {
+        records[i] = Keyed{ keys[i], static_cast<std::uint32_t>(i) };
+    }
+    ParallelRadixSort(records.begin(), records.end(), [](const Keyed& r) { return r.key; });
+    bool stable = true;
+    for (std::size_t i = 1; i < records.size(); i++) {
+        stable &= records[i - 1].key < records[i].key || (records[i - 1].key == records[i].key && records[i - 1].order < records[i].order);
+    }
+    CHECK(stable);
+}
+
+STREAMLINE_TEST(ParallelSortHandlesNonTrivialElements){
+    Tests::StartPool();
+    std::vector<std::string> values;
+    for (int value : RandomValues<int>(100000, 5000)) {
+        values.push_back("item-" + std::to_string(value));
+    }
+    std::vector<std::string> expected = values;
+    std::stable_sort(expected.begin(), expected.end());
+    ParallelStableSort(values.begin(), values.end());
+    CHECK(values == expected);
+    ParallelSort(values.begin(), values.end(), std::greater<>());
+    CHECK(std::is_sorted(values.begin(), values.end(), std::greater<>()));
+}
+
+STREAMLINE_TEST(SortScratchIsReturnedFromAnotherThread){
+    SortScratch& scratch = SortScratch::Local();
+    auto outer = std::make_unique<SortBuffer<int>>(1000);
+    CHECK(scratch.Capacity() >= 1000 * sizeof(int));
+    {
+        //Nested on a thread already sorting: a temporary, not the borrowed scratch.
+        SortBuffer<int> nested(1000);
+        CHECK(nested.Data() != outer->Data());
+    }
+    const int* borrowed = outer->Data();
+    //As when a fiber parked mid-sort resumes, and finishes, on another worker.
+    std::thread([&]() { outer.reset(); }).join();
+    SortBuffer<int> again(1000);
+    CHECK(again.Data() == borrowed);
+    scratch.Release();
+    CHECK(scratch.Capacity() != 0);
+}
@@ -0,0 +1,224 @@
+#include "Test.h"
+#include "Parallel.h"
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace StreamLine;
+
+namespace {
+    /// @brief Worker that ran each chunk, in the order they started.
+    struct ChunkLog{
+        std::vector<int> Owners;
+        std::vector<std::size_t> Order;
+        std::atomic<std::size_t> Next{ 0 };
+
+        explicit ChunkLog(std::size_t chunks) : Owners(chunks, -2), Order(chunks) {}
+
+        void Record(std::size_t chunk) {
+            Owners[chunk] = ThreadPool::GetWorkerIndex();
+            Order[Next.fetch_add(1)] = chunk;
+        }
+    };
+}
+
+STREAMLINE_TEST(AffinityPartitionerCoversEveryIndexOnce){
+    Tests::StartPool();
+    AffinityPartitioner affinity;
+    for (std::size_t n : { 1000, 1000, 5000, 1000 }) {
+        std::vector<std::atomic<int>> hits(n);
+        ParallelFor(0, n, 64, [&](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; i++) {
+                hits[i]++;
+            }
+        }, affinity);
+        bool once = true;
+        for (auto& hit : hits) {
+            once &= hit.load() == 1;
+        }
+        CHECK(once);
+    }
+    bool threw = false;
+    try {
+        ParallelFor(0, 1000, 64, [](std::size_t first, std::size_t) {
+            if (first == 512) {
+                throw std::runtime_error("chunk");
+            }
+        }, affinity);
+    }
+    catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+STREAMLINE_TEST(AffinityPartitionerHandsChunksBackToTheirWorker){
+    Tests::StartPool();
+    constexpr std::size_t Chunks = 64;
+    AffinityPartitioner affinity;
+    auto run = [&](ChunkLog& log) {
+        ParallelFor(0, Chunks, 1, [&](std::size_t chunk, std::size_t) {
+            log.Record(chunk);
+            //Long enough for the workers to wake and take their share.
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }, affinity);
+    };
+    ChunkLog first(Chunks);
+    run(first);
+    ChunkLog second(Chunks);
+    run(second);
+    //A worker starts on its own mailbox, so its first chunk is one it ran last time.
+    for (unsigned int worker = 0; worker < ThreadPool::GetThreadCount(); worker++) {
+        bool ranBefore = false;
+        for (int owner : first.Owners) {
+            ranBefore |= owner == static_cast<int>(worker);
+        }
+        for (std::size_t chunk : second.Order) {
+            if (second.Owners[chunk] == static_cast<int>(worker)) {
+                CHECK(!ranBefore || first.Owners[chunk] == static_cast<int>(worker));
+                break;
+            }
+        }
+    }
+}
+
+STREAMLINE_TEST(AffinityPartitionerKeepsOwnersAcrossCallsFromOutsideThePool){
+    Tests::StartPool();
+    constexpr std::size_t Chunks = 32;
+    AffinityPartitioner affinity;
+    bool seeding = true;
+    auto run = [&](ChunkLog& log) {
+        ParallelFor(0, Chunks, 1, [&](std::size_t chunk, std::size_t) {
+            log.Record(chunk);
+            //Then slow on the workers only, so an eager caller would run out of its own chunks and take theirs.
+            if (seeding || ThreadPool::IsWorkerThread()) {
+                std::this_thread::sleep_for(std::chrono::microseconds(500));
+            }
+        }, affinity);
+    };
+    ChunkLog previous(Chunks);
+    //Long enough for the workers to wake and take their share.
+    run(previous);
+    seeding = false;
+    for (int replay = 0; replay < 4; replay++) {
+        ChunkLog current(Chunks);
+        run(current);
+        //The caller leaves a worker's chunks to it, and never takes them over: no chunk falls back to unowned.
+        for (std::size_t chunk = 0; chunk < Chunks; chunk++) {
+            CHECK(previous.Owners[chunk] < 0 || current.Owners[chunk] >= 0);
+            if (ThreadPool::GetThreadCount() == 1) {
+                CHECK(previous.Owners[chunk] < 0 || current.Owners[chunk] == previous.Owners[chunk]);
+            }
+        }
+        std::swap(previous.Owners, current.Owners);
+    }
+}
+
+STREAMLINE_TEST(AutoPartitionerMeasuresAndCoversTheRange){
+    Tests::StartPool();
+    AutoPartitioner partitioner;
+    CHECK(partitioner.GetIterationCost() == 0.0);
+    constexpr std::size_t Count = 200000;
+    std::vector<std::atomic<int>> hits(Count);
+    ParallelFor(0, Count, [&](std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; i++) {
+            hits[i]++;
+        }
+    }, partitioner);
+    bool once = true;
+    for (auto& hit : hits) {
+        once &= hit.load() == 1;
+    }
+    CHECK(once);
+    CHECK(partitioner.GetIterationCost() > 0.0);
+
+    //Far cheaper than one chunk's worth of scheduling: a single call on the caller.
+    std::vector<std::size_t> calls;
+    ParallelFor(0, 16, [&](std::size_t first, std::size_t last) {
+        CHECK(ThreadPool::GetWorkerIndex() < 0);
+        calls.push_back(last - first);
+    }, partitioner);
+    CHECK((calls == std::vector<std::size_t>{ 16 }));
+
+    partitioner.Reset();
+    CHECK(partitioner.GetIterationCost() == 0.0);
+}
+
+STREAMLINE_TEST(AutoPartitionerSplitsCostlyIterations){
+    Tests::StartPool();
+    AutoPartitioner partitioner;
+    std::atomic<std::size_t> calls{ 0 };
+    std::atomic<std::size_t> done{ 0 };
+    auto body = [&](std::size_t first, std::size_t last) {
+        calls++;
+        //About 50us an iteration, so every chunk is worth its scheduling.
+        std::this_thread::sleep_for(std::chrono::microseconds(50) * (last - first));
+        done += last - first;
+    };
+    ParallelFor(0, 200, body, partitioner);
+    CHECK(done.load() == 200);
+    CHECK(partitioner.GetIterationCost() > 10000.0);
+    calls = 0;
+    ParallelFor(0, 200, body, partitioner);
+    CHECK(done.load() == 400);
+    //At least 4 chunks per thread once the cost is known.
+    CHECK(calls.load() >= 4 * (ThreadPool::GetThreadCount() + 1));
+
+    done = 0;
+    for (int i = 0; i < 3; i++) {
+        //One partitioner learned for this call site.
+        ParallelFor(0, 1000, [&](std::size_t first, std::size_t last) { done += last - first; });
+    }
+    CHECK(done.load() == 3000);
+}
+
+namespace {
+    long InvokeSum(long first, long last) {
+        if (last - first <= 64) {
+            long total = 0;
+            for (long i = first; i < last; i++) {
+                total += i;
+            }
+            return total;
+        }
+        const long mid = first + (last - first) / 2;
+        long left = 0;
+        long right = 0;
+        ParallelInvoke([&]() { left = InvokeSum(first, mid); }, [&]() { right = InvokeSum(mid, last); });
+        return left + right;
+    }
+}
+
+STREAMLINE_TEST(ParallelInvokeRunsEveryFunctionOnce){
+    Tests::StartPool();
+    std::atomic<int> a{ 0 };
+    std::atomic<int> b{ 0 };
+    std::atomic<int> c{ 0 };
+    ParallelInvoke([&]() { a++; }, [&]() { b++; }, [&]() { c++; });
+    CHECK(a.load() == 1 && b.load() == 1 && c.load() == 1);
+    ParallelInvoke([&]() { a++; });
+    CHECK(a.load() == 2);
+    //Nested, the queued halves are mostly taken back by whoever queued them.
+    CHECK(InvokeSum(0, 100000) == 100000L * 99999 / 2);
+}
+
+STREAMLINE_TEST(ParallelInvokeRethrowsTheFirstFailureInArgumentOrder){
+    Tests::StartPool();
+    std::atomic<int> ran{ 0 };
+    std::string message;
+    try {
+        ParallelInvoke(
+            [&]() { ran++; },
+            [&]() { ran++; throw std::runtime_error("second"); },
+            [&]() { ran++; throw std::runtime_error("third"); });
+    }
+    catch (const std::runtime_error& e) {
+        message = e.what();
+    }
+    //Every function ran before anything was rethrown.
+    CHECK(ran.load() == 3);
+    CHECK(message == "second");
+}
@@ -0,0 +1,141 @@
+#include "Test.h"
+#include "Reactor.h"
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace StreamLine;
+using namespace StreamLine::IO;
+
+namespace {
+    /// @brief Runs body against a freshly initialized backend, reporting whether it was available.
+    template<class Body>
+    void WithBackend(ReactorBackend preferred, Body&& body) {
+        Tests::StartPool();
+        Reactor::Shutdown();
+        const ReactorBackend backend = Reactor::Initialize(preferred);
+        if (backend == ReactorBackend::None) {
+            std::printf("  reactor unavailable, skipped\n");
+            return;
+        }
+        if (preferred == ReactorBackend::Epoll) {
+            CHECK(backend == ReactorBackend::Epoll);
+        }
+        body();
+        Reactor::Shutdown();
+    }
+
+    void PipeRoundTrip() {
+        int fds[2];
+        CHECK(pipe2(fds, O_NONBLOCK | O_CLOEXEC) == 0);
+        char in[6] = {};
+        const char out[] = "hello";
+        std::atomic<int> readResult{ 1 << 30 };
+        std::atomic<int> writeResult{ 1 << 30 };
+        //The read is queued before there is anything to read, it must complete once the write lands.
+        Reactor::Read(fds[0], in, sizeof(in), -1, [&](int r) { readResult = r; });
+        Reactor::Write(fds[1], out, sizeof(out), -1, [&](int r) { writeResult = r; });
+        Reactor::Flush();
+        CHECK(Tests::WaitUntil([&]() { return readResult.load() != (1 << 30) && writeResult.load() != (1 << 30); }));
+        CHECK(writeResult.load() == static_cast<int>(sizeof(out)));
+        CHECK(readResult.load() == static_cast<int>(sizeof(out)));
+        CHECK(std::memcmp(in, out, sizeof(out)) == 0);
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    void TimeoutsFireInDeadlineOrder() {
+        std::atomic<int> order{ 0 };
+        std::atomic<int> late{ -1 };
+        std::atomic<int> early{ -1 };
+        std::atomic<int> result{ 0 };
+        std::atomic<int> done{ 0 };
+        const auto start = std::chrono::steady_clock::now();
+        Reactor::Timeout(std::chrono::milliseconds(40), [&](int r) { late = order++; result = r; done++; });
+        Reactor::Timeout(std::chrono::milliseconds(5), [&](int) { early = order++; done++; });
+        Reactor::Flush();
+        CHECK(Tests::WaitUntil([&]() { return done.load() == 2; }));
+        CHECK(early.load() == 0);
+        CHECK(late.load() == 1);
+        CHECK(result.load() == -ETIME);
+        CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(40));
+    }
+}
+
+STREAMLINE_TEST(ReactorCompletesPipeReadsAndWrites){
+    WithBackend(ReactorBackend::IoUring, PipeRoundTrip);
+}
+
+STREAMLINE_TEST(ReactorEpollCompletesPipeReadsAndWrites){
+    WithBackend(ReactorBackend::Epoll, PipeRoundTrip);
+}
+
+STREAMLINE_TEST(ReactorTimeoutsFireInDeadlineOrder){
+    WithBackend(ReactorBackend::IoUring, TimeoutsFireInDeadlineOrder);
+}
+
+STREAMLINE_TEST(ReactorEpollTimeoutsFireInDeadlineOrder){
+    WithBackend(ReactorBackend::Epoll, TimeoutsFireInDeadlineOrder);
+}
+
+STREAMLINE_TEST(ReactorReleasesInFlightOperationsOnShutdown){
+    for (ReactorBackend preferred : { ReactorBackend::IoUring, ReactorBackend::Epoll }) {
+        int fds[2];
+        CHECK(pipe2(fds, O_NONBLOCK | O_CLOEXEC) == 0);
+        char buffer[8];
+        std::atomic<int> completed{ 0 };
+        WithBackend(preferred, [&]() {
+            //Neither ever completes, shutting down must drop them without running them (and without leaking).
+            Reactor::Read(fds[0], buffer, sizeof(buffer), -1, [&](int) { completed++; });
+            Reactor::Timeout(std::chrono::hours(1), [&](int) { completed++; });
+            Reactor::Flush();
+        });
+        CHECK(completed.load() == 0);
+        CHECK(Reactor::GetBackend() == ReactorBackend::None);
+        close(fds[0]);
+        close(fds[1]);
+    }
+}
+
+STREAMLINE_TEST(ReactorRejectsOperationsWhenShutDown){
+    Reactor::Shutdown();
+    bool threw = false;
+    try {
+        Reactor::Timeout(std::chrono::milliseconds(1), [](int) {});
+    }
+    catch (const InvalidOperation&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+STREAMLINE_TEST(ReactorShutdownWaitsOutABlockedPoll){
+    for (ReactorBackend preferred : { ReactorBackend::IoUring, ReactorBackend::Epoll }) {
+        std::atomic<bool> polling{ false };
+        std::atomic<bool> threw{ false };
+        WithBackend(preferred, [&]() {
+            std::thread poller([&]() {
+                polling = true;
+                try {
+                    //Polls may return early when the workers reap first, keep at it until the reactor goes away.
+                    while (true) {
+                        Reactor::Poll(std::chrono::seconds(30));
+                    }
+                }
+                catch (const InvalidOperation&) {
+                    threw = true;
+                }
+            });
+            CHECK(Tests::WaitUntil([&]() { return polling.load(); }));
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            //Must wake the poller rather than free the backend under it.
+            const auto start = std::chrono::steady_clock::now();
+            Reactor::Shutdown();
+            CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+            poller.join();
+        });
+        CHECK(threw.load());
+    }
+}
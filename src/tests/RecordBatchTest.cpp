@@ -0,0 +1,132 @@
+#include "Test.h"
+#include "RecordBatch.h"
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace StreamLine;
+
+namespace {
+    RecordBatch MakeBatch(std::size_t rows, std::shared_ptr<Arena> arena = nullptr) {
+        RecordBatch batch({ { "id", ColumnType::Int64 }, { "score", ColumnType::Float64 } }, rows, std::move(arena));
+        std::int64_t* ids = batch.GetColumn(0).Data<std::int64_t>();
+        double* scores = batch.GetColumn("score").Data<double>();
+        for (std::size_t i = 0; i < rows; i++) {
+            ids[i] = static_cast<std::int64_t>(i);
+            scores[i] = static_cast<double>(i % 10);
+        }
+        batch.Resize(rows);
+        return batch;
+    }
+
+    std::vector<std::size_t> Rows(const RecordBatch& batch) {
+        std::vector<std::size_t> rows;
+        batch.ForEachRow([&](std::size_t row) { rows.push_back(row); });
+        return rows;
+    }
+}
+
+STREAMLINE_TEST(RecordBatchSelectsAndRefinesInPlace){
+    RecordBatch batch = MakeBatch(100);
+    CHECK(!batch.HasSelection());
+    CHECK(batch.ActiveRows() == 100);
+    batch.Select<double>(1, [](double v) { return v >= 7; });
+    CHECK(batch.ActiveRows() == 30);
+    const std::uint32_t* first = batch.Selection();
+    batch.Select<std::int64_t>(0, [](std::int64_t id) { return id < 40; });
+    //The second selection reuses the batch's buffer.
+    CHECK(batch.Selection() == first);
+    CHECK((Rows(batch) == std::vector<std::size_t>{ 7, 8, 9, 17, 18, 19, 27, 28, 29, 37, 38, 39 }));
+    batch.Compact();
+    CHECK(!batch.HasSelection());
+    CHECK(batch.Size() == 12);
+    CHECK(batch.GetColumn(0).Data<std::int64_t>()[3] == 17);
+    CHECK(batch.GetColumn(1).Data<double>()[11] == 9.0);
+}
+
+STREAMLINE_TEST(RecordBatchNullsAreSkippedAndCompacted){
+    RecordBatch batch = MakeBatch(70);
+    Column& scores = batch.GetColumn(1);
+    CHECK(scores.Validity() == nullptr);
+    scores.SetNull(5);
+    scores.SetNull(66);
+    scores.SetNull(67);
+    scores.SetValid(67);
+    CHECK(scores.Validity() != nullptr);
+    CHECK(!scores.IsValid(5));
+    CHECK(scores.IsValid(67));
+    batch.Select<double>(1, [](double v) { return v >= 5; });
+    std::vector<std::size_t> expected;
+    for (std::size_t i = 0; i < 70; i++) {
+        if (i % 10 >= 5 && i != 5 && i != 66) {
+            expected.push_back(i);
+        }
+    }
+    CHECK(Rows(batch) == expected);
+    //A selection keeping a null row carries its validity bit along.
+    batch.Resize(70);
+    batch.Select<std::int64_t>(0, [](std::int64_t id) { return id >= 60; });
+    batch.Compact();
+    CHECK(batch.Size() == 10);
+    CHECK(batch.GetColumn(1).IsValid(5));
+    CHECK(!batch.GetColumn(1).IsValid(6));
+    CHECK(batch.GetColumn(1).IsValid(7));
+}
+
+STREAMLINE_TEST(RecordBatchChecksTypesAndCapacity){
+    RecordBatch batch = MakeBatch(8);
+    bool mismatch = false;
+    try {
+        batch.GetColumn(0).Data<double>();
+    }
+    catch (const std::invalid_argument&) {
+        mismatch = true;
+    }
+    CHECK(mismatch);
+    bool overflow = false;
+    try {
+        batch.Resize(9);
+    }
+    catch (const std::length_error&) {
+        overflow = true;
+    }
+    CHECK(overflow);
+    bool missing = false;
+    try {
+        batch.ColumnIndex("nope");
+    }
+    catch (const std::out_of_range&) {
+        missing = true;
+    }
+    CHECK(missing);
+}
+
+STREAMLINE_TEST(RecordBatchesSharingAnArenaAreProcessedConcurrently){
+    constexpr std::size_t Count = 16;
+    auto arena = std::make_shared<Arena>();
+    std::vector<RecordBatch> batches;
+    for (std::size_t i = 0; i < Count; i++) {
+        batches.push_back(MakeBatch(1000, arena));
+    }
+    //Selections and null bitmaps must not come from the shared arena once the batches are spread over threads.
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < 4; t++) {
+        threads.emplace_back([&, t]() {
+            for (std::size_t i = t; i < Count; i += 4) {
+                RecordBatch& batch = batches[i];
+                batch.GetColumn(1).SetNull(i);
+                batch.Select<double>(1, [](double v) { return v < 3; });
+                batch.Select<std::int64_t>(0, [](std::int64_t id) { return id % 2 == 0; });
+                batch.Compact();
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (std::size_t i = 0; i < Count; i++) {
+        //Ids 0, 2 (mod 10) out of 1000, minus the null one when it would have been kept.
+        const bool nullKept = i % 10 < 3 && i % 2 == 0;
+        CHECK(batches[i].Size() == 200 - (nullKept ? 1 : 0));
+    }
+}
@@ -0,0 +1,112 @@
+#include "Test.h"
+#include "RunLoop.h"
+#include "CoTask.h"
+#include "TaskScheduler.h"
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace StreamLine;
+
+namespace {
+    CoTask<int> HopToOwner(RunLoop& loop, std::thread::id& resumedOn) {
+        co_await loop.Schedule();
+        resumedOn = std::this_thread::get_id();
+        co_return 7;
+    }
+}
+
+STREAMLINE_TEST(RunLoopRunsPostedWorkOnItsOwner){
+    RunLoop loop;
+    std::vector<std::thread::id> ranOn;
+    std::thread poster([&]() {
+        for (int i = 0; i < 3; i++) {
+            loop.Post([&]() { ranOn.push_back(std::this_thread::get_id()); });
+        }
+    });
+    poster.join();
+    CHECK(loop.RunPending(2) == 2);
+    CHECK(loop.RunPending() == 1);
+    CHECK(loop.RunPending() == 0);
+    CHECK(ranOn.size() == 3);
+    for (const std::thread::id& id : ranOn) {
+        CHECK(id == std::this_thread::get_id());
+    }
+    CHECK(loop.RunFor(std::chrono::milliseconds(1)) == 0);
+}
+
+STREAMLINE_TEST(RunLoopInvokeReturnsResultsAndExceptions){
+    RunLoop loop;
+    int result = 0;
+    bool threw = false;
+    std::thread caller([&]() {
+        result = loop.Invoke([]() { return 41; }) + 1;
+        try {
+            loop.Invoke([]() -> int { throw std::runtime_error("owner"); });
+        }
+        catch (const std::runtime_error&) {
+            threw = true;
+        }
+        loop.Stop();
+    });
+    loop.Run();
+    caller.join();
+    CHECK(result == 42);
+    CHECK(threw);
+    //Inline on the owner.
+    CHECK(loop.Invoke([]() { return 3; }) == 3);
+}
+
+STREAMLINE_TEST(RunLoopResumesCoroutinesOnItsOwner){
+    Tests::StartPool();
+    RunLoop loop;
+    std::thread::id resumedOn;
+    std::atomic<int> result{ 0 };
+    std::thread other([&]() {
+        result = SyncWait(HopToOwner(loop, resumedOn));
+    });
+    CHECK(Tests::WaitUntil([&]() { return loop.RunPending() == 1; }));
+    other.join();
+    CHECK(result.load() == 7);
+    CHECK(resumedOn == std::this_thread::get_id());
+}
+
+STREAMLINE_TEST(RunLoopRefusesToBePumpedElsewhere){
+    RunLoop loop;
+    bool threw = false;
+    std::thread([&]() {
+        try {
+            loop.RunPending();
+        }
+        catch (const InvalidOperation&) {
+            threw = true;
+        }
+    }).join();
+    CHECK(threw);
+    std::thread([&]() {
+        loop.Attach();
+        loop.Post([]() {});
+        CHECK(loop.RunPending() == 1);
+    }).join();
+    CHECK(!loop.IsCurrent());
+}
+
+STREAMLINE_TEST(PinnedTasksRunOnlyOnTheirWorker){
+    Tests::StartPool();
+    const unsigned int workers = ThreadPool::GetThreadCount();
+    std::vector<Ticket> tickets;
+    std::vector<std::atomic<int>> ranOn(workers * 4);
+    for (unsigned int i = 0; i < workers * 4; i++) {
+        tickets.push_back(TaskScheduler::AddTaskTo(i, [&ranOn, i]() { ranOn[i] = ThreadPool::GetWorkerIndex(); }));
+    }
+    for (Ticket ticket : tickets) {
+        //Waiting doesn't take a pinned task from its worker.
+        TaskScheduler::WaitForTask(ticket);
+        CHECK(TaskScheduler::GetTaskState(ticket) == TaskState::Complete);
+        TaskScheduler::ReleaseTask(ticket);
+    }
+    for (unsigned int i = 0; i < workers * 4; i++) {
+        CHECK(ranOn[i].load() == static_cast<int>(i % workers));
+    }
+}
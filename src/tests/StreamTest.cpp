@@ -0,0 +1,83 @@
+#include "Test.h"
+#include "Stream.h"
+#include <atomic>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+using namespace StreamLine;
+
+namespace {
+    std::vector<int> Iota(int count) {
+        std::vector<int> values(static_cast<std::size_t>(count));
+        std::iota(values.begin(), values.end(), 0);
+        return values;
+    }
+}
+
+STREAMLINE_TEST(StreamFusesSequentialOperators){
+    const std::vector<int> values = Iota(100);
+    const std::vector<int> result = Stream::From(values)
+        | Stream::Filter([](int v) { return v % 2 == 0; })
+        | Stream::Map([](int v) { return v * v; })
+        | Stream::Take(5)
+        | Stream::Collect();
+    CHECK((result == std::vector<int>{ 0, 4, 16, 36, 64 }));
+}
+
+STREAMLINE_TEST(StreamKeepsSourceOrderAcrossAParallelPoint){
+    Tests::StartPool();
+    const std::vector<int> values = Iota(10000);
+    std::atomic<int> seen{ 0 };
+    const std::vector<long> result = Stream::From(values)
+        | Stream::Filter([](int v) { return v % 3 != 0; })
+        | Stream::Parallel(128)
+        | Stream::Map([&](int v) { seen++; return static_cast<long>(v) * 2; })
+        | Stream::Collect();
+    std::vector<long> expected;
+    for (int v : values) {
+        if (v % 3 != 0) {
+            expected.push_back(static_cast<long>(v) * 2);
+        }
+    }
+    CHECK(result == expected);
+    CHECK(seen.load() == static_cast<int>(expected.size()));
+}
+
+STREAMLINE_TEST(StreamFlatMapsAndComposesChains){
+    const std::vector<int> values = Iota(4);
+    auto expand = Stream::FlatMap([](int v) { return std::vector<int>(static_cast<std::size_t>(v), v); })
+        | Stream::Map([](int v) { return v + 1; });
+    const std::vector<int> result = Stream::From(values) | std::move(expand) | Stream::Collect();
+    CHECK((result == std::vector<int>{ 2, 3, 3, 4, 4, 4 }));
+}
+
+STREAMLINE_TEST(StreamBatchesMoveOnlyElementsByReference){
+    Tests::StartPool();
+    std::vector<std::unique_ptr<int>> values;
+    for (int i = 0; i < 1000; i++) {
+        values.push_back(std::make_unique<int>(i));
+    }
+    std::atomic<long> sum{ 0 };
+    (Stream::From(values) | Stream::Parallel(64)).ForEach([&](const std::unique_ptr<int>& v) { sum += *v; });
+    CHECK(sum.load() == 999L * 1000 / 2);
+}
+
+STREAMLINE_TEST(StreamRethrowsFromParallelStages){
+    Tests::StartPool();
+    const std::vector<int> values = Iota(5000);
+    bool threw = false;
+    try {
+        (Stream::From(values) | Stream::Parallel(100) | Stream::Map([](int v) {
+            if (v == 4321) {
+                throw std::runtime_error("bad element");
+            }
+            return v;
+        })).ForEach([](int) {});
+    }
+    catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
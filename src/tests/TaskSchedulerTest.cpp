@@ -0,0 +1,479 @@
+#include "Test.h"
+#include "TaskScheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+using namespace StreamLine;
+
+namespace {
+    /// @brief Keeps every worker busy until released, so that what gets queued stays queued.
+    struct Occupy{
+        std::atomic<bool> release{ false };
+        std::atomic<unsigned int> started{ 0 };
+
+        Occupy() {
+            for (unsigned int i = 0; i < ThreadPool::GetThreadCount(); i++) {
+                ThreadPool::Submit([this]() {
+                    started++;
+                    while (!release.load()) {
+                        std::this_thread::sleep_for(std::chrono::microseconds(100));
+                    }
+                });
+            }
+            Tests::WaitUntil([this]() { return started.load() == ThreadPool::GetThreadCount(); });
+        }
+
+        ~Occupy() {
+            release = true;
+        }
+    };
+}
+
+STREAMLINE_TEST(TaskSchedulerRunsInlineWhenSaturated){
+    Tests::StartPool();
+    std::atomic<int> queuedRan{ 0 };
+    {
+        Occupy busy;
+        //A task queued behind every busy worker: nobody is hungry.
+        for (unsigned int i = 0; i < ThreadPool::GetThreadCount(); i++) {
+            ThreadPool::Submit([&]() { queuedRan++; });
+        }
+        CHECK(!ThreadPool::IsHungry());
+        std::thread::id ranOn;
+        const Ticket ticket = TaskScheduler::AddTask([&]() { ranOn = std::this_thread::get_id(); });
+        CHECK(ranOn == std::this_thread::get_id());
+        CHECK(TaskScheduler::GetTaskState(ticket) == TaskState::Complete);
+        const Ticket failed = TaskScheduler::AddTask([]() { throw std::runtime_error("inline"); });
+        CHECK(TaskScheduler::GetTaskState(failed) == TaskState::Failed);
+    }
+    CHECK(Tests::WaitUntil([&]() { return queuedRan.load() == static_cast<int>(ThreadPool::GetThreadCount()); }));
+}
+
+STREAMLINE_TEST(TaskSchedulerQueuesWhenWorkersAreHungry){
+    Tests::StartPool();
+    CHECK(Tests::WaitUntil([]() { return ThreadPool::IsHungry(); }));
+    std::atomic<bool> ran{ false };
+    const Ticket ticket = TaskScheduler::AddTask([&]() { ran = true; });
+    TaskScheduler::WaitForTask(ticket);
+    CHECK(ran.load());
+    CHECK(TaskScheduler::GetTaskState(ticket) == TaskState::Complete);
+    TaskScheduler::ReleaseTask(ticket);
+
+    const Ticket failed = TaskScheduler::AddTask([]() { throw std::runtime_error("queued"); });
+    TaskScheduler::WaitForTask(failed);
+    CHECK(TaskScheduler::GetTaskState(failed) == TaskState::Failed);
+    TaskScheduler::ReleaseTask(failed);
+}
+
+STREAMLINE_TEST(TaskSchedulerWaitRunsAQueuedTaskOnTheCaller){
+    Tests::StartPool();
+    std::thread::id ranOn;
+    Ticket ticket;
+    {
+        Occupy busy;
+        ticket = TaskScheduler::AddTask([&]() { ranOn = std::this_thread::get_id(); });
+        CHECK(TaskScheduler::GetTaskState(ticket) == TaskState::Waiting);
+        TaskScheduler::WaitForTask(ticket);
+        CHECK(ranOn == std::this_thread::get_id());
+    }
+    CHECK(TaskScheduler::GetTaskState(ticket) == TaskState::Complete);
+    TaskScheduler::ReleaseTask(ticket);
+}
+
+STREAMLINE_TEST(TaskSchedulerCancelsTasksThatDidNotStart){
+    Tests::StartPool();
+    std::atomic<bool> ran{ false };
+    Ticket ticket;
+    {
+        Occupy busy;
+        ticket = TaskScheduler::AddTask([&]() { ran = true; });
+        CHECK(TaskScheduler::CancelTask(ticket) == TaskState::Abandonned);
+        CHECK(TaskScheduler::CancelTask(ticket) == TaskState::Abandonned);
+    }
+    //The queued entry still reaches a worker, which skips it.
+    CHECK(Tests::WaitUntil([]() { return ThreadPool::IsHungry(); }));
+    CHECK(!ran.load());
+    CHECK(TaskScheduler::GetTaskState(ticket) == TaskState::Abandonned);
+    TaskScheduler::ReleaseTask(ticket);
+    CHECK(TaskScheduler::GetTaskState(ticket) == TaskState::Failed);
+}
+
+namespace {
+    /// @brief Spins until the calling thread used duration of CPU time, which is what a group's turn is measured in.
+    void Burn(std::chrono::microseconds duration) {
+        timespec start;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+        const std::int64_t until = start.tv_sec * 1000000000LL + start.tv_nsec + duration.count() * 1000;
+        timespec now = start;
+        while (now.tv_sec * 1000000000LL + now.tv_nsec < until) {
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+        }
+    }
+}
+
+STREAMLINE_TEST(TaskSchedulerSharesWorkersByGroupWeight){
+    Tests::StartPool();
+    constexpr GroupId Heavy = 7301;
+    constexpr GroupId Light = 7302;
+    constexpr int PerGroup = 120;
+    TaskScheduler::SetGroupWeight(Heavy, 3);
+    std::mutex mtx;
+    std::vector<GroupId> order;
+    {
+        Occupy busy;
+        //Light first, it would run first on a plain queue.
+        for (GroupId group : { Light, Heavy }) {
+            for (int i = 0; i < PerGroup; i++) {
+                TaskScheduler::AddTask(group, [&, group]() {
+                    Burn(std::chrono::microseconds(100));
+                    std::lock_guard<std::mutex> lock(mtx);
+                    order.push_back(group);
+                });
+            }
+        }
+        CHECK(TaskScheduler::GetGroupStats(Heavy).Queued == PerGroup);
+    }
+    CHECK(Tests::WaitUntil([&]() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return order.size() == 2 * PerGroup;
+    }, std::chrono::seconds(30)));
+    //While both groups have work, the heavy one gets about three turns' worth for each of the light one.
+    const long heavy = std::count(order.begin(), order.begin() + PerGroup, Heavy);
+    const long light = PerGroup - heavy;
+    CHECK(heavy >= 2 * light && heavy <= 4 * light);
+
+    //Counted once the task returned.
+    CHECK(Tests::WaitUntil([&]() { return TaskScheduler::GetGroupStats(Heavy).Completed == PerGroup; }));
+    const GroupStats stats = TaskScheduler::GetGroupStats(Heavy);
+    CHECK(stats.Weight == 3);
+    CHECK(stats.Queued == 0);
+    CHECK(stats.CpuTime >= std::chrono::microseconds(100) * PerGroup);
+    CHECK(TaskScheduler::GetGroupStats(7399).Completed == 0);
+}
+
+STREAMLINE_TEST(TaskSchedulerWaitKeepsGroupTasksInTurnAndAccounted){
+    Tests::StartPool();
+    constexpr GroupId Waited = 7303;
+    std::vector<int> order;
+    std::vector<Ticket> tickets;
+    {
+        Occupy busy;
+        tickets.push_back(TaskScheduler::AddTask(Waited, [&]() { Burn(std::chrono::microseconds(200)); order.push_back(0); }));
+        tickets.push_back(TaskScheduler::AddTask(Waited, [&]() { order.push_back(1); throw std::runtime_error("grouped"); }));
+        tickets.push_back(TaskScheduler::AddTask(Waited, [&]() { Burn(std::chrono::microseconds(200)); order.push_back(2); }));
+        //The worker is busy, the caller gets to the last task through the group's queue, in turn.
+        TaskScheduler::WaitForTask(tickets.back());
+        CHECK((order == std::vector<int>{ 0, 1, 2 }));
+        const GroupStats stats = TaskScheduler::GetGroupStats(Waited);
+        CHECK(stats.Completed == 2);
+        CHECK(stats.Failed == 1);
+        CHECK(stats.Queued == 0);
+        CHECK(stats.CpuTime >= std::chrono::microseconds(400));
+    }
+    CHECK(TaskScheduler::GetTaskState(tickets[1]) == TaskState::Failed);
+    for (Ticket ticket : tickets) {
+        TaskScheduler::ReleaseTask(ticket);
+    }
+}
+
+STREAMLINE_TEST(TaskSchedulerRunsEarliestDeadlineFirst){
+    Tests::StartPool();
+    const auto now = std::chrono::steady_clock::now();
+    std::mutex mtx;
+    std::vector<int> order;
+    {
+        Occupy busy;
+        for (int due : { 50, 10, 40, 20, 30 }) {
+            TaskScheduler::AddTask(now + std::chrono::seconds(due), [&, due]() {
+                std::lock_guard<std::mutex> lock(mtx);
+                order.push_back(due);
+            });
+        }
+    }
+    CHECK(Tests::WaitUntil([&]() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return order.size() == 5;
+    }));
+    CHECK((order == std::vector<int>{ 10, 20, 30, 40, 50 }));
+}
+
+STREAMLINE_TEST(TaskSchedulerHandlesExpiredDeadlinesByPolicy){
+    Tests::StartPool();
+    const std::uint64_t expiredBefore = TaskScheduler::GetExpiredCount();
+    std::atomic<int> dropped{ 0 };
+    std::atomic<int> demoted{ 0 };
+    std::atomic<int> late{ 0 };
+    Ticket drop;
+    Ticket demote;
+    Ticket run;
+    {
+        Occupy busy;
+        //Already due by the time a worker gets to them.
+        const auto past = std::chrono::steady_clock::now() - std::chrono::milliseconds(1);
+        drop = TaskScheduler::AddTask(past, [&]() { dropped++; });
+        demote = TaskScheduler::AddTask(past, [&]() { demoted++; }, DeadlinePolicy::Demote);
+        run = TaskScheduler::AddTask(past, [&]() { late++; }, DeadlinePolicy::Run);
+    }
+    CHECK(Tests::WaitUntil([&]() { return demoted.load() == 1 && late.load() == 1; }));
+    CHECK(Tests::WaitUntil([&]() { return TaskScheduler::GetTaskState(drop) == TaskState::Abandonned; }));
+    CHECK(dropped.load() == 0);
+    CHECK(TaskScheduler::GetTaskState(run) == TaskState::Complete);
+    CHECK(Tests::WaitUntil([&]() { return TaskScheduler::GetTaskState(demote) == TaskState::Complete; }));
+    CHECK(TaskScheduler::GetExpiredCount() - expiredBefore == 2);
+    for (Ticket ticket : { drop, demote, run }) {
+        TaskScheduler::ReleaseTask(ticket);
+    }
+}
+
+STREAMLINE_TEST(TaskSchedulerDoesNotExpireDeadlineTasksThatAlreadyRan){
+    Tests::StartPool();
+    const std::uint64_t expiredBefore = TaskScheduler::GetExpiredCount();
+    std::atomic<int> ran{ 0 };
+    Ticket waited;
+    Ticket cancelled;
+    Ticket last;
+    {
+        Occupy busy;
+        const auto soon = std::chrono::steady_clock::now() + std::chrono::milliseconds(1);
+        waited = TaskScheduler::AddTask(soon, [&]() { ran++; });
+        cancelled = TaskScheduler::AddTask(soon, [&]() { ran++; });
+        //Due last, so its entry is popped after theirs.
+        last = TaskScheduler::AddTask(soon + std::chrono::milliseconds(1), [&]() { ran++; }, DeadlinePolicy::Run);
+        TaskScheduler::WaitForTask(waited);
+        CHECK(TaskScheduler::CancelTask(cancelled) == TaskState::Abandonned);
+        //Their heap entries are only popped past the deadline.
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    CHECK(Tests::WaitUntil([&]() { return ran.load() == 2; }));
+    CHECK(TaskScheduler::GetExpiredCount() == expiredBefore);
+    for (Ticket ticket : { waited, cancelled, last }) {
+        TaskScheduler::ReleaseTask(ticket);
+    }
+}
+
+STREAMLINE_TEST(TaskSchedulerRunsDeadlineTasksFromEveryWorkerOfARestartedPool){
+    //Added before the pool exists, then from workers the first pool never had.
+    ThreadPool::Shutdown();
+    std::atomic<int> ran{ 0 };
+    const Ticket early = TaskScheduler::AddTask(std::chrono::steady_clock::now(), [&]() { ran++; }, DeadlinePolicy::Run);
+    ThreadPool::InitalizePool(8);
+    const unsigned int workers = ThreadPool::GetThreadCount();
+    for (unsigned int i = 0; i < workers; i++) {
+        ThreadPool::SubmitTo(i, [&]() {
+            TaskScheduler::ReleaseTask(TaskScheduler::AddTask(std::chrono::steady_clock::now() + std::chrono::seconds(1), [&]() { ran++; }));
+        });
+    }
+    CHECK(Tests::WaitUntil([&]() { return ran.load() == static_cast<int>(workers) + 1; }));
+    CHECK(TaskScheduler::GetTaskState(early) == TaskState::Complete);
+    TaskScheduler::ReleaseTask(early);
+    ThreadPool::Shutdown();
+    Tests::StartPool();
+}
+
+STREAMLINE_TEST(TaskSchedulerRefusesPastQueueBounds){
+    Tests::StartPool();
+    AdmissionOptions options;
+    options.MaxQueuedTasks = 1;
+    options.MaxQueuedGroupTasks = 2;
+    options.MaxQueuedDeadlineTasks = 1;
+    TaskScheduler::SetAdmission(options);
+    const std::uint64_t rejectedBefore = TaskScheduler::GetRejectedCount();
+    std::atomic<int> ran{ 0 };
+    std::vector<Ticket> tickets;
+    {
+        Occupy busy;
+        const auto later = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        for (int i = 0; i < 2; i++) {
+            Admission admission = TaskScheduler::TrySubmit(7501, [&]() { ran++; });
+            CHECK(admission.Status == AdmissionStatus::Accepted);
+            tickets.push_back(admission.Id);
+        }
+        CHECK(TaskScheduler::TrySubmit(7501, [&]() { ran++; }).Status == AdmissionStatus::QueueFull);
+        Admission deadline = TaskScheduler::TrySubmit(later, [&]() { ran++; });
+        CHECK(deadline);
+        tickets.push_back(deadline.Id);
+        bool threw = false;
+        try {
+            TaskScheduler::AddTask(later, [&]() { ran++; });
+        }
+        catch (const TaskRejected& e) {
+            threw = e.GetStatus() == AdmissionStatus::QueueFull;
+        }
+        CHECK(threw);
+        //Every worker busy with more queued: the ordinary task runs inline, which is never refused.
+        Admission inlined = TaskScheduler::TrySubmit([&]() { ran++; });
+        CHECK(inlined && TaskScheduler::GetTaskState(inlined.Id) == TaskState::Complete);
+    }
+    CHECK(Tests::WaitUntil([&]() { return ran.load() == 4; }));
+    CHECK(TaskScheduler::GetRejectedCount() - rejectedBefore == 2);
+    //Room again once the queues drained.
+    CHECK(Tests::WaitUntil([&]() {
+        Admission admission = TaskScheduler::TrySubmit(7501, [&]() { ran++; });
+        if (admission) {
+            tickets.push_back(admission.Id);
+        }
+        return static_cast<bool>(admission);
+    }));
+    TaskScheduler::SetAdmission(AdmissionOptions());
+    for (Ticket ticket : tickets) {
+        TaskScheduler::WaitForTask(ticket);
+        TaskScheduler::ReleaseTask(ticket);
+    }
+}
+
+STREAMLINE_TEST(TaskSchedulerRateLimitsGroups){
+    constexpr GroupId Limited = 7502;
+    TaskScheduler::SetGroupRateLimit(Limited, 0.001, 2);
+    std::vector<Ticket> tickets;
+    for (int i = 0; i < 2; i++) {
+        Admission admission = TaskScheduler::TrySubmit(Limited, []() {});
+        CHECK(admission);
+        tickets.push_back(admission.Id);
+    }
+    CHECK(TaskScheduler::TrySubmit(Limited, []() {}).Status == AdmissionStatus::RateLimited);
+    //Another group is unaffected, and lifting the limit lets the group through again.
+    Admission other = TaskScheduler::TrySubmit(7503, []() {});
+    CHECK(other);
+    tickets.push_back(other.Id);
+    TaskScheduler::SetGroupRateLimit(Limited, 0, 1);
+    Admission lifted = TaskScheduler::TrySubmit(Limited, []() {});
+    CHECK(lifted);
+    tickets.push_back(lifted.Id);
+    for (Ticket ticket : tickets) {
+        TaskScheduler::WaitForTask(ticket);
+        TaskScheduler::ReleaseTask(ticket);
+    }
+}
+
+STREAMLINE_TEST(TaskSchedulerShedsWhileQueueingDelayStaysHigh){
+    Tests::StartPool();
+    AdmissionOptions options;
+    options.TargetDelay = std::chrono::milliseconds(1);
+    options.Interval = std::chrono::milliseconds(1);
+    TaskScheduler::SetAdmission(options);
+    constexpr int Count = 4;
+    std::atomic<int> ran{ 0 };
+    std::atomic<int> overloaded{ 0 };
+    std::vector<Ticket> tickets;
+    {
+        Occupy busy;
+        for (int i = 0; i < Count; i++) {
+            tickets.push_back(TaskScheduler::AddTask(7504, [&]() {
+                //By the third task the delay has stayed above target for a whole interval.
+                if (ran.fetch_add(1) == 2 && TaskScheduler::TrySubmit(7504, []() {}).Status == AdmissionStatus::Overloaded) {
+                    overloaded++;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    CHECK(Tests::WaitUntil([&]() { return ran.load() == Count; }));
+    CHECK(overloaded.load() == 1);
+    //The queue drained, new work is admitted again.
+    CHECK(Tests::WaitUntil([&]() { return TaskScheduler::GetGroupStats(7504).Completed == Count; }));
+    Admission admission = TaskScheduler::TrySubmit(7504, []() {});
+    CHECK(admission);
+    tickets.push_back(admission.Id);
+    TaskScheduler::SetAdmission(AdmissionOptions());
+    for (Ticket ticket : tickets) {
+        TaskScheduler::WaitForTask(ticket);
+        TaskScheduler::ReleaseTask(ticket);
+    }
+}
+
+STREAMLINE_TEST(TaskSchedulerStopsSheddingWhenTheBacklogIsCancelled){
+    Tests::StartPool();
+    AdmissionOptions options;
+    options.TargetDelay = std::chrono::milliseconds(1);
+    options.Interval = std::chrono::milliseconds(1);
+    TaskScheduler::SetAdmission(options);
+    constexpr int Count = 4;
+    std::atomic<int> ran{ 0 };
+    std::atomic<bool> shedding{ false };
+    std::vector<Ticket> tickets;
+    {
+        Occupy busy;
+        for (int i = 0; i < Count; i++) {
+            tickets.push_back(TaskScheduler::AddTask(7505, [&]() {
+                if (ran.fetch_add(1) == 2) {
+                    shedding = TaskScheduler::TrySubmit(7505, []() {}).Status == AdmissionStatus::Overloaded;
+                    //The rest of the backlog is given up on instead of run.
+                    TaskScheduler::CancelTask(tickets.back());
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    CHECK(Tests::WaitUntil([&]() { return ran.load() == Count - 1; }));
+    //Started, so waiting doesn't run them out of turn.
+    for (int i = 0; i < Count - 1; i++) {
+        TaskScheduler::WaitForTask(tickets[i]);
+    }
+    CHECK(shedding.load());
+    CHECK(TaskScheduler::GetTaskState(tickets[Count - 1]) == TaskState::Abandonned);
+    //The cancelled task's entry is skipped, not counted as completed.
+    CHECK(Tests::WaitUntil([]() { return TaskScheduler::GetGroupStats(7505).Queued == 0; }));
+    CHECK(Tests::WaitUntil([]() { return ThreadPool::IsHungry(); }));
+    CHECK(TaskScheduler::GetGroupStats(7505).Completed == Count - 1);
+    Admission admission = TaskScheduler::TrySubmit(7505, []() {});
+    CHECK(admission);
+    tickets.push_back(admission.Id);
+    TaskScheduler::SetAdmission(AdmissionOptions());
+    for (Ticket ticket : tickets) {
+        TaskScheduler::WaitForTask(ticket);
+        TaskScheduler::ReleaseTask(ticket);
+    }
+}
+
+STREAMLINE_TEST(TaskSchedulerShedsEachClassOnItsOwnDelay){
+    Tests::StartPool();
+    AdmissionOptions options;
+    options.TargetDelay = std::chrono::milliseconds(1);
+    options.Interval = std::chrono::milliseconds(1);
+    TaskScheduler::SetAdmission(options);
+    constexpr int Count = 4;
+    std::atomic<int> ran{ 0 };
+    std::atomic<bool> groupShed{ false };
+    std::atomic<bool> deadlineAdmitted{ false };
+    std::atomic<bool> groupStillShed{ false };
+    std::vector<Ticket> tickets;
+    {
+        Occupy busy;
+        for (int i = 0; i < Count; i++) {
+            tickets.push_back(TaskScheduler::AddTask(7506, [&]() {
+                if (ran.fetch_add(1) != 2) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                    return;
+                }
+                groupShed = TaskScheduler::TrySubmit(7506, []() {}).Status == AdmissionStatus::Overloaded;
+                //The deadline queue is empty, the grouped backlog doesn't shed it.
+                Admission quick = TaskScheduler::TrySubmit(std::chrono::steady_clock::now() + std::chrono::seconds(1), []() {});
+                deadlineAdmitted = static_cast<bool>(quick);
+                if (quick) {
+                    //Runs it here, draining the deadline queue at once.
+                    TaskScheduler::WaitForTask(quick.Id);
+                    TaskScheduler::ReleaseTask(quick.Id);
+                }
+                //Which leaves the grouped backlog, still above target, shed.
+                groupStillShed = TaskScheduler::TrySubmit(7506, []() {}).Status == AdmissionStatus::Overloaded;
+            }));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    CHECK(Tests::WaitUntil([&]() { return ran.load() == Count; }));
+    CHECK(groupShed.load());
+    CHECK(deadlineAdmitted.load());
+    CHECK(groupStillShed.load());
+    TaskScheduler::SetAdmission(AdmissionOptions());
+    for (Ticket ticket : tickets) {
+        TaskScheduler::WaitForTask(ticket);
+        TaskScheduler::ReleaseTask(ticket);
+    }
+}
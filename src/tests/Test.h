@@ -0,0 +1,77 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "ThreadPool.h"
+
+namespace StreamLine::Tests{
+    struct Case{
+        const char* Name;
+        void (*Body)();
+    };
+
+    /// @brief Every test case of the binary, filled during static initialization.
+    inline std::vector<Case>& Registry() {
+        static std::vector<Case> cases;
+        return cases;
+    }
+
+    inline int& Failures() {
+        static int failures = 0;
+        return failures;
+    }
+
+    struct Registrar{
+        Registrar(const char* name, void (*body)()) {
+            Registry().push_back(Case{ name, body });
+        }
+    };
+
+    inline void Fail(const char* file, int line, const char* expression) {
+        std::printf("  %s:%d: CHECK(%s) failed\n", file, line, expression);
+        Failures()++;
+    }
+
+    /// @brief Starts the pool when a previous test shut it down, cases don't rely on running in any order.
+    inline void StartPool() {
+        ThreadPool::InitalizePool(4);
+    }
+
+    /// @brief A scratch file path unique to this process, removed when the guard goes out of scope.
+    struct TempFile{
+        std::string Path;
+
+        explicit TempFile(const char* name) : Path("/tmp/streamline-test-" + std::to_string(getpid()) + "-" + name) {}
+        ~TempFile() {
+            std::remove(Path.c_str());
+        }
+    };
+
+    /// @brief Polls until condition holds, false on timeout. Leaves the queued work to the pool.
+    template<class Condition>
+    bool WaitUntil(Condition&& condition, std::chrono::milliseconds timeout = std::chrono::seconds(10)) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!condition()) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        return true;
+    }
+}
+
+#define STREAMLINE_TEST(name) \
+    static void name(); \
+    static const StreamLine::Tests::Registrar name##Registrar(#name, &name); \
+    static void name()
+
+#define CHECK(expression) \
+    do { \
+        if (!(expression)) { \
+            StreamLine::Tests::Fail(__FILE__, __LINE__, #expression); \
+        } \
+    } while (false)
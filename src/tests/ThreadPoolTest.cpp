@@ -0,0 +1,60 @@
+#include "Test.h"
+#include <atomic>
+#include <poll.h>
+
+using namespace StreamLine;
+
+namespace {
+    bool Readable(int fd) {
+        pollfd entry{ fd, POLLIN, 0 };
+        return poll(&entry, 1, 0) == 1 && (entry.revents & POLLIN) != 0;
+    }
+}
+
+STREAMLINE_TEST(ThreadPoolRunPendingDrivesTheQueueWithoutWorkers){
+    ThreadPool::Shutdown();
+    std::atomic<int> ran{ 0 };
+    for (int i = 0; i < 5; i++) {
+        ThreadPool::Submit([&]() { ran++; });
+    }
+    CHECK(ThreadPool::RunPending(2) == 2);
+    CHECK(ran.load() == 2);
+    CHECK(ThreadPool::RunPending(100) == 3);
+    CHECK(ran.load() == 5);
+    CHECK(ThreadPool::RunPending(100) == 0);
+    Tests::StartPool();
+}
+
+STREAMLINE_TEST(ThreadPoolNotificationFdStaysSignaledUntilDrained){
+    ThreadPool::Shutdown();
+    const int fd = ThreadPool::GetNotificationFd();
+    if (fd < 0) {
+        std::printf("  eventfd unavailable, skipped\n");
+        Tests::StartPool();
+        return;
+    }
+    ThreadPool::RunPending(100);
+    CHECK(!Readable(fd));
+    std::atomic<int> ran{ 0 };
+    for (int i = 0; i < 3; i++) {
+        ThreadPool::Submit([&]() { ran++; });
+    }
+    CHECK(Readable(fd));
+    //A partial run leaves the fd signaled instead of clearing and rewriting it.
+    CHECK(ThreadPool::RunPending(1) == 1);
+    CHECK(Readable(fd));
+    CHECK(ThreadPool::RunPending(100) == 2);
+    CHECK(ran.load() == 3);
+    CHECK(!Readable(fd));
+    ThreadPool::Submit([&]() { ran++; });
+    CHECK(Readable(fd));
+    CHECK(ThreadPool::RunPending(100) == 1);
+    CHECK(!Readable(fd));
+    //Without running workers, pinned work is queued like any other and signals just the same.
+    ThreadPool::SubmitPinned(0, [&]() { ran++; });
+    CHECK(Readable(fd));
+    CHECK(ThreadPool::RunPending(100) == 1);
+    CHECK(ran.load() == 5);
+    CHECK(!Readable(fd));
+    Tests::StartPool();
+}
@@ -0,0 +1,141 @@
+#include "Test.h"
+#include "Window.h"
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+using namespace StreamLine;
+
+namespace {
+    using Emitted = std::tuple<std::string, EventTime, EventTime, int>;
+
+    struct Collector{
+        std::mutex mtx;
+        std::vector<Emitted> windows;
+
+        WindowedAggregator<std::string, int, int>::Emit Emit() {
+            return [this](const std::string& key, WindowBounds bounds, int&& sum) {
+                std::lock_guard<std::mutex> lock(mtx);
+                windows.emplace_back(key, bounds.Start, bounds.End, sum);
+            };
+        }
+
+        std::vector<Emitted> Sorted() {
+            std::lock_guard<std::mutex> lock(mtx);
+            std::vector<Emitted> sorted = windows;
+            std::sort(sorted.begin(), sorted.end());
+            return sorted;
+        }
+    };
+
+    void Sum(int& acc, const int& value) {
+        acc += value;
+    }
+
+    void Combine(int& acc, const int& other) {
+        acc += other;
+    }
+}
+
+STREAMLINE_TEST(WindowTumblingSumsPerKey){
+    Tests::StartPool();
+    Collector out;
+    WindowedAggregator<std::string, int, int> rollup(WindowSpec::Tumbling(10), 0, Sum, nullptr, out.Emit());
+    for (EventTime t = 0; t < 100; t++) {
+        rollup.Push("a", t, 1);
+        rollup.Push("b", t, 2);
+    }
+    rollup.AdvanceWatermark(50);
+    rollup.Wait();
+    CHECK(out.Sorted().size() == 10);
+    rollup.Close();
+    const auto windows = out.Sorted();
+    CHECK(windows.size() == 20);
+    for (std::size_t i = 0; i < windows.size(); i++) {
+        const bool a = i < 10;
+        const EventTime start = static_cast<EventTime>(i % 10) * 10;
+        CHECK(windows[i] == Emitted(a ? "a" : "b", start, start + 10, a ? 10 : 20));
+    }
+}
+
+STREAMLINE_TEST(WindowSlidingCountsOverlappingWindows){
+    Tests::StartPool();
+    Collector out;
+    WindowedAggregator<std::string, int, int> rollup(WindowSpec::Sliding(10, 5), 0, Sum, nullptr, out.Emit(), 2);
+    for (EventTime t = 0; t < 20; t++) {
+        rollup.Push("k", t, 1);
+    }
+    rollup.Close();
+    const std::vector<Emitted> expected = {
+        { "k", -5, 5, 5 }, { "k", 0, 10, 10 }, { "k", 5, 15, 10 }, { "k", 10, 20, 10 }, { "k", 15, 25, 5 }
+    };
+    CHECK(out.Sorted() == expected);
+}
+
+STREAMLINE_TEST(WindowSessionsMergeUntilAGap){
+    Tests::StartPool();
+    Collector out;
+    WindowedAggregator<std::string, int, int> rollup(WindowSpec::Session(5), 0, Sum, Combine, out.Emit());
+    //Out of order on purpose, 2 bridges the sessions opened by 0 and 4.
+    for (EventTime t : { 4, 0, 2, 10, 11, 30 }) {
+        rollup.Push("s", t, 1);
+    }
+    rollup.Close();
+    const std::vector<Emitted> expected = { { "s", 0, 9, 3 }, { "s", 10, 16, 2 }, { "s", 30, 35, 1 } };
+    CHECK(out.Sorted() == expected);
+}
+
+STREAMLINE_TEST(WindowDropsLateEvents){
+    Tests::StartPool();
+    Collector out;
+    WindowedAggregator<std::string, int, int> rollup(WindowSpec::Tumbling(10), 0, Sum, nullptr, out.Emit(), 1);
+    rollup.Push("k", 5, 1);
+    rollup.AdvanceWatermark(20);
+    rollup.Wait();
+    rollup.Push("k", 3, 1);
+    rollup.Push("k", 25, 1);
+    rollup.Close();
+    CHECK(rollup.GetLateCount() == 1);
+    const std::vector<Emitted> expected = { { "k", 0, 10, 1 }, { "k", 20, 30, 1 } };
+    CHECK(out.Sorted() == expected);
+}
+
+STREAMLINE_TEST(WindowCountsEachLateEventOnce){
+    Tests::StartPool();
+    Collector out;
+    WindowedAggregator<std::string, int, int> rollup(WindowSpec::Sliding(10, 5), 0, Sum, nullptr, out.Emit(), 1);
+    rollup.Push("k", 7, 1);
+    rollup.AdvanceWatermark(12);
+    rollup.Wait();
+    //Both of its windows were emitted, one late event.
+    rollup.Push("k", 3, 1);
+    //[0, 10) was emitted but [5, 15) is still open, so not late.
+    rollup.Push("k", 8, 1);
+    rollup.Push("k", 1, 1);
+    rollup.Close();
+    CHECK(rollup.GetLateCount() == 2);
+    const std::vector<Emitted> expected = { { "k", 0, 10, 1 }, { "k", 5, 15, 2 } };
+    CHECK(out.Sorted() == expected);
+}
+
+STREAMLINE_TEST(WindowRejectsInvalidSpecs){
+    Collector out;
+    bool sessionWithoutMerge = false;
+    try {
+        WindowedAggregator<std::string, int, int> rollup(WindowSpec::Session(5), 0, Sum, nullptr, out.Emit());
+    }
+    catch (const std::invalid_argument&) {
+        sessionWithoutMerge = true;
+    }
+    CHECK(sessionWithoutMerge);
+    bool emptyWindow = false;
+    try {
+        WindowedAggregator<std::string, int, int> rollup(WindowSpec::Tumbling(0), 0, Sum, nullptr, out.Emit());
+    }
+    catch (const std::invalid_argument&) {
+        emptyWindow = true;
+    }
+    CHECK(emptyWindow);
+}
@@ -0,0 +1,57 @@
+#include "Test.h"
+#include "WorkerLocal.h"
+#include "Parallel.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace StreamLine;
+
+STREAMLINE_TEST(WorkerLocalCombinesPerThreadCounts){
+    Tests::StartPool();
+    WorkerLocal<std::size_t> counts;
+    CHECK(counts.Size() == 0);
+    CHECK(counts.Combine([](std::size_t a, std::size_t b) { return a + b; }) == 0);
+    constexpr std::size_t Count = 100000;
+    ParallelFor(0, Count, 100, [&](std::size_t first, std::size_t last) {
+        counts.Local() += last - first;
+    });
+    //The caller and at most every worker.
+    CHECK(counts.Size() >= 1 && counts.Size() <= ThreadPool::GetThreadCount() + 1);
+    CHECK(counts.Combine([](std::size_t a, std::size_t b) { return a + b; }) == Count);
+    std::size_t total = 0;
+    counts.ForEach([&](std::size_t& count) { total += count; });
+    CHECK(total == Count);
+}
+
+STREAMLINE_TEST(WorkerLocalGivesOutsideThreadsTheirOwnSlots){
+    Tests::StartPool();
+    std::atomic<int> made{ 0 };
+    WorkerLocal<std::vector<int>> values([&]() {
+        made++;
+        return std::vector<int>{ -1 };
+    });
+    std::vector<int>& mine = values.Local();
+    CHECK(&values.Local() == &mine);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 3; i++) {
+        threads.emplace_back([&values, i]() { values.Local().push_back(i); });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    CHECK(made.load() == 4);
+    CHECK(values.Size() == 4);
+    //Every slot started from the factory's value and only saw its own thread's push.
+    std::size_t sizes = 0;
+    values.ForEach([&](std::vector<int>& slot) {
+        CHECK(slot.front() == -1);
+        sizes += slot.size();
+    });
+    CHECK(sizes == 1 + 3 * 2);
+
+    values.Clear();
+    CHECK(values.Size() == 0);
+    CHECK(values.Local().size() == 1);
+    CHECK(made.load() == 5);
+}